@@ -0,0 +1,487 @@
+#pragma once
+#include <WGraph.hpp>
+#include <queue>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <stdexcept>
+#include <cmath>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <unistd.h>
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+
+/**
+ * Landmark distance tables for ALT (A*, Landmarks, Triangle inequality)
+ * queries. For each landmark L we keep d(L,v) and d(v,L) for every v,
+ * stored vertex-major so one query touches one contiguous row per vertex.
+ */
+class ALTLandmarks {
+public:
+    using WGraph = graph_tools::WGraph;
+    using Ptr    = std::shared_ptr<const ALTLandmarks>;
+
+    enum class Selection { FARTHEST, DEGREE };
+
+    ALTLandmarks() : _nodes(0) {}
+
+    /* Builder functions */
+    static ALTLandmarks Build(const WGraph::Ptr &wg, int k,
+                              Selection sel = Selection::FARTHEST,
+                              int threads = std::thread::hardware_concurrency()) {
+        ALTLandmarks lm;
+        lm._nodes = wg->num_nodes();
+        k = std::min<int>(k, lm._nodes);
+        if (k < 1)
+            throw std::invalid_argument("ALTLandmarks: need at least one landmark on a non-empty graph");
+        threads = std::max(threads, 1);
+
+        // one table per landmark while building; interleaved at the end
+        std::vector<std::vector<float>> from(k), to(k);
+
+        if (sel == Selection::DEGREE) {
+            std::vector<int> by_degree(lm._nodes);
+            for (int v = 0; v < lm._nodes; v++) by_degree[v] = v;
+            std::partial_sort(by_degree.begin(), by_degree.begin()+k, by_degree.end(),
+                              [&](int lhs, int rhs) {
+                                  return wg->degree(lhs) > wg->degree(rhs);
+                              });
+            lm._landmarks.assign(by_degree.begin(), by_degree.begin()+k);
+            parallel_for(2*k, threads, [&](int i) {
+                    if (i < k) from[i]  = SSSP(*wg, lm._landmarks[i]);
+                    else       to[i-k]  = SSSP(*wg->transposed(), lm._landmarks[i-k]);
+                });
+        } else {
+            // each pick depends on the previous forward searches
+            std::vector<float> closest(lm._nodes, INFINITY);
+            int next = wg->node_with_max_degree();
+            for (int i = 0; i < k; i++) {
+                lm._landmarks.push_back(next);
+                from[i] = SSSP(*wg, next);
+                next = -1;
+                for (int v = 0; v < lm._nodes; v++) {
+                    closest[v] = std::min(closest[v], from[i][v]);
+                    if (!std::isinf(closest[v]) && (next == -1 || closest[v] > closest[next]))
+                        next = v;
+                }
+                if (next == -1 || closest[next] == 0.0) {
+                    // ran out of reachable vertices
+                    k = i+1;
+                    from.resize(k);
+                    to.resize(k);
+                    break;
+                }
+            }
+            parallel_for(k, threads, [&](int i) {
+                    to[i] = SSSP(*wg->transposed(), lm._landmarks[i]);
+                });
+        }
+
+        lm._from.resize(static_cast<size_t>(lm._nodes) * k);
+        lm._to.resize(static_cast<size_t>(lm._nodes) * k);
+        for (int v = 0; v < lm._nodes; v++) {
+            for (int i = 0; i < k; i++) {
+                lm._from[static_cast<size_t>(v)*k+i] = from[i][v];
+                lm._to  [static_cast<size_t>(v)*k+i] = to[i][v];
+            }
+        }
+
+        return lm;
+    }
+
+    /* Serialization */
+    void toFile(const std::string &file_name) const {
+        std::ofstream ofs(file_name, std::ios::binary);
+        if (!ofs)
+            throw std::runtime_error("Failed to open '" + file_name + "': " + strerror(errno));
+
+        int32_t header[3] = {MAGIC, _nodes, num_landmarks()};
+        ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(_landmarks.data()), sizeof(int) * _landmarks.size());
+        ofs.write(reinterpret_cast<const char*>(_from.data()), sizeof(float) * _from.size());
+        ofs.write(reinterpret_cast<const char*>(_to.data()), sizeof(float) * _to.size());
+    }
+
+    static ALTLandmarks FromFile(const std::string &file_name) {
+        std::ifstream ifs(file_name, std::ios::binary);
+        if (!ifs)
+            throw std::runtime_error("Failed to open '" + file_name + "': " + strerror(errno));
+
+        int32_t header[3];
+        ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!ifs || header[0] != MAGIC)
+            throw std::runtime_error("'" + file_name + "' is not a landmark table");
+
+        // the counts must describe exactly the bytes that follow
+        ifs.seekg(0, std::ios::end);
+        int64_t size = static_cast<int64_t>(ifs.tellg());
+        ifs.seekg(sizeof(header), std::ios::beg);
+        if (header[1] < 0 || header[2] < 1 || header[2] > header[1]
+            || size != static_cast<int64_t>(sizeof(header))
+                        + static_cast<int64_t>(sizeof(int)) * header[2]
+                        + 2 * static_cast<int64_t>(sizeof(float)) * header[1] * header[2])
+            throw std::runtime_error("'" + file_name + "' has a corrupt header");
+
+        ALTLandmarks lm;
+        lm._nodes = header[1];
+        size_t entries = static_cast<size_t>(header[1]) * header[2];
+        lm._landmarks.resize(header[2]);
+        lm._from.resize(entries);
+        lm._to.resize(entries);
+        ifs.read(reinterpret_cast<char*>(lm._landmarks.data()), sizeof(int) * lm._landmarks.size());
+        ifs.read(reinterpret_cast<char*>(lm._from.data()), sizeof(float) * entries);
+        ifs.read(reinterpret_cast<char*>(lm._to.data()), sizeof(float) * entries);
+        if (!ifs)
+            throw std::runtime_error("'" + file_name + "' is truncated");
+
+        return lm;
+    }
+
+    /**
+     * Lower bound on d(v,t) from the triangle inequality:
+     * max over L of d(L,t)-d(L,v) and d(v,L)-d(t,L).
+     */
+    float lower_bound(int v, int t) const {
+        int k = num_landmarks();
+        const float *fv = &_from[static_cast<size_t>(v)*k];
+        const float *ft = &_from[static_cast<size_t>(t)*k];
+        const float *tv = &_to[static_cast<size_t>(v)*k];
+        const float *tt = &_to[static_cast<size_t>(t)*k];
+        float h = 0.0;
+        for (int i = 0; i < k; i++) {
+            if (!std::isinf(fv[i]) && !std::isinf(ft[i]))
+                h = std::max(h, ft[i] - fv[i]);
+            if (!std::isinf(tv[i]) && !std::isinf(tt[i]))
+                h = std::max(h, tv[i] - tt[i]);
+        }
+        return h;
+    }
+
+    int num_nodes() const { return _nodes; }
+    int num_landmarks() const { return _landmarks.size(); }
+    const std::vector<int> & landmarks() const { return _landmarks; }
+
+    graph_tools::MemoryFootprint footprint() const {
+        graph_tools::MemoryFootprint f;
+        f.add("landmarks", graph_tools::MemoryFootprint::Bytes(_landmarks));
+        f.add("from", graph_tools::MemoryFootprint::Bytes(_from));
+        f.add("to", graph_tools::MemoryFootprint::Bytes(_to));
+        return f;
+    }
+
+    /* single-source distances from root over g */
+    static std::vector<float> SSSP(const WGraph &g, int root) {
+        using Entry = std::pair<float, int>;
+        std::vector<float> distance(g.num_nodes(), INFINITY);
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        auto &offs = g.get_offsets();
+        auto &degs = g.get_degrees();
+        auto &neib = g.get_neighbors();
+        auto &wgts = g.get_weights();
+
+        distance[root] = 0.0;
+        queue.push({0.0, root});
+        while (!queue.empty()) {
+            Entry top = queue.top();
+            queue.pop();
+            int src = top.second;
+            if (top.first > distance[src]) continue;
+            for (WGraph::NodeID dst_i = 0; dst_i < degs[src]; dst_i++) {
+                int dst = neib[offs[src]+dst_i];
+                float d = distance[src] + wgts[offs[src]+dst_i];
+                if (d < distance[dst]) {
+                    distance[dst] = d;
+                    queue.push({d, dst});
+                }
+            }
+        }
+        return distance;
+    }
+
+private:
+    static constexpr int32_t MAGIC = 0x414c5431; // "ALT1"
+
+    template <typename F>
+    static void parallel_for(int n, int threads, F f) {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < std::min(threads, n); t++) {
+            workers.emplace_back([=]() {
+                    for (int i = t; i < n; i += threads) f(i);
+                });
+        }
+        for (auto &w : workers) w.join();
+    }
+
+    int _nodes;
+    std::vector<int>   _landmarks;
+    std::vector<float> _from; // d(L,v) at [v*K+L]
+    std::vector<float> _to;   // d(v,L) at [v*K+L]
+};
+
+/**
+ * Point-to-point A* search guided by ALTLandmarks lower bounds.
+ * The distance and path arrays are allocated once and stamped with an
+ * epoch per query, as in BatchDijkstra, so query() only pays for the
+ * vertices it touches; run() and the whole-array accessors expand the
+ * last query to |V| entries.
+ */
+class ALTDijkstra {
+public:
+    using WGraph = graph_tools::WGraph;
+    ALTDijkstra(const WGraph::Ptr &wg, const ALTLandmarks::Ptr &lm, int root, int goal) :
+        _wg(wg),
+        _lm(lm),
+        _root(root),
+        _goal(goal),
+        _traversed_edges(0),
+        _fp_compares(0),
+        _fp_adds(0),
+        _distance(wg->num_nodes()),
+        _path(wg->num_nodes()),
+        _stamp(wg->num_nodes(), 0),
+        _epoch(1) {
+        if (lm->num_nodes() != static_cast<int>(wg->num_nodes()))
+            throw std::invalid_argument("ALTDijkstra: landmark table has " + std::to_string(lm->num_nodes())
+                                        + " nodes but the graph has " + std::to_string(wg->num_nodes()));
+    }
+
+    std::pair<std::vector<int>, std::vector<float>>
+    run() {
+        query(_root, _goal);
+        return {path(), distance()};
+    }
+
+    /* distance from root to goal, reusing this search's arrays */
+    float query(int root, int goal) {
+        using Entry = std::pair<float, int>;
+        std::greater<Entry> cmp;
+        _root = root;
+        _goal = goal;
+        reset();
+        set(_root, 0.0, _root);
+        _heap.push_back({_lm->lower_bound(_root, _goal), _root});
+
+        auto &offs = _wg->get_offsets();
+        auto &degs = _wg->get_degrees();
+        auto &neib = _wg->get_neighbors();
+        auto &wgts = _wg->get_weights();
+
+        while (!_heap.empty()) {
+            // approx. deletion with O(logN)
+            _fp_compares += ceil(log2(_heap.size()));
+            std::pop_heap(_heap.begin(), _heap.end(), cmp);
+            Entry top = _heap.back();
+            _heap.pop_back();
+            int src = top.second;
+            if (src == _goal)
+                break;
+
+            // skip stale entries
+            _fp_compares += 1;
+            float d_src = distance(src);
+            if (top.first > d_src + _lm->lower_bound(src, _goal))
+                continue;
+
+            for (WGraph::NodeID dst_i = 0; dst_i < degs[src]; dst_i++) {
+                int dst = neib[offs[src]+dst_i];
+                float w = wgts[offs[src]+dst_i];
+                if (d_src+w < distance(dst)) {
+                    set(dst, d_src+w, src);
+                    // approx. insertion with O(logN)
+                    _fp_compares += _heap.size() == 0 ? 0 : ceil(log2(_heap.size()));
+                    _heap.push_back({d_src + w + _lm->lower_bound(dst, _goal), dst});
+                    std::push_heap(_heap.begin(), _heap.end(), cmp);
+                }
+
+                _fp_adds += 1;
+                _fp_compares += 1;
+                _traversed_edges += 1;
+            }
+        }
+
+        return distance(_goal);
+    }
+
+    int goal() const { return _goal; }
+    float distance(int v) const { return _stamp[v] == _epoch ? _distance[v] : INFINITY; }
+    int   path(int v) const { return _stamp[v] == _epoch ? _path[v] : -1; }
+
+    std::vector<float> distance() const {
+        std::vector<float> d(_distance.size());
+        for (size_t v = 0; v < d.size(); v++) d[v] = distance(v);
+        return d;
+    }
+
+    std::vector<int> path() const {
+        std::vector<int> p(_path.size());
+        for (size_t v = 0; v < p.size(); v++) p[v] = path(v);
+        return p;
+    }
+
+    /* bytes this search owns; the graph and landmarks are shared */
+    graph_tools::MemoryFootprint footprint() const {
+        graph_tools::MemoryFootprint f;
+        f.add("distance", graph_tools::MemoryFootprint::Bytes(_distance));
+        f.add("path", graph_tools::MemoryFootprint::Bytes(_path));
+        f.add("stamp", graph_tools::MemoryFootprint::Bytes(_stamp));
+        f.add_transient("heap", graph_tools::MemoryFootprint::Bytes(_heap));
+        return f;
+    }
+
+    void stats(const std::string &fname) const {
+        std::ofstream of(fname);
+        of << stats_str();
+    }
+
+    std::string stats_str() const {
+        std::stringstream ss;
+        ss << "nodes:                 " << _wg->num_nodes() << "\n";
+        ss << "edges:                 " << _wg->num_edges() << "\n";
+        ss << "landmarks:             " << _lm->num_landmarks() << "\n";
+        ss << "root:                  " << _root << "\n";
+        ss << "goal:                  " << _goal << "\n";
+        ss << "traversed edges:       " << _traversed_edges << "\n";
+        ss << "fp compares:           " << _fp_compares << "\n";
+        ss << "fp adds:               " << _fp_adds << "\n";
+        ss << "fp total:              " << _fp_compares+_fp_adds << "\n";
+        ss << "fp total analytical:   " << 2 * (_wg->num_nodes()-1) * _wg->num_edges() << "\n";
+        ss << "distance (root->goal): " << distance(_goal) << "\n";
+        return ss.str();
+    }
+
+
+    static int Test(int argc, char *argv[]) {
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+        Dijkstra dijkstra(wg, 0);
+        dijkstra.run();
+        dijkstra.goal(5.0);
+        int goal = dijkstra.goal();
+
+        for (auto sel : {ALTLandmarks::Selection::FARTHEST, ALTLandmarks::Selection::DEGREE}) {
+            auto lm = std::make_shared<const ALTLandmarks>(ALTLandmarks::Build(wg, 8, sel));
+
+            FastDijkstra fdijkstra(wg, 0, goal);
+            fdijkstra.run();
+
+            ALTDijkstra adijkstra(wg, lm, 0, goal);
+            adijkstra.run();
+
+            std::cout << "fast stats:" << std::endl;
+            std::cout << fdijkstra.stats_str() << std::endl;
+            std::cout << "alt stats:" << std::endl;
+            std::cout << adijkstra.stats_str() << std::endl;
+
+            assert(std::fabs(adijkstra.distance()[goal] - dijkstra.distance()[goal]) < 1e-3);
+        }
+
+        // Repeated queries reuse one search
+        {
+            auto lm = std::make_shared<const ALTLandmarks>(ALTLandmarks::Build(wg, 8));
+            ALTDijkstra adijkstra(wg, lm, 0, goal);
+            for (int q = 0; q < 64; q++) {
+                int root = (q * 7919) % wg->num_nodes(), to = (q * 104729) % wg->num_nodes();
+                float d = adijkstra.query(root, to);
+                FastDijkstra fdijkstra(wg, root, to);
+                fdijkstra.run();
+                float expect = fdijkstra.distance()[to];
+                assert(std::isinf(expect) == std::isinf(d));
+                assert(std::isinf(expect) || std::fabs(expect - d) < 1e-3);
+                assert(adijkstra.path(root) == root);
+            }
+        }
+
+        // Serialization
+        {
+            char file_name[] = "/tmp/landmarksXXXXXX";
+            int fd = mkstemp(file_name);
+            assert(fd != -1);
+            close(fd);
+            ALTLandmarks lm = ALTLandmarks::Build(wg, 4);
+            lm.toFile(file_name);
+            auto ld = std::make_shared<const ALTLandmarks>(ALTLandmarks::FromFile(file_name));
+            assert(ld->landmarks() == lm.landmarks());
+            for (WGraph::NodeID v = 0; v < wg->num_nodes(); v += 97)
+                assert(ld->lower_bound(v, goal) == lm.lower_bound(v, goal));
+
+            ALTDijkstra adijkstra(wg, ld, 0, goal);
+            adijkstra.run();
+            assert(std::fabs(adijkstra.distance()[goal] - dijkstra.distance()[goal]) < 1e-3);
+
+            // counts that don't match the file are rejected before allocating
+            for (int32_t nodes : {-1, 1 << 30}) {
+                std::fstream fs(file_name, std::ios::binary | std::ios::in | std::ios::out);
+                fs.seekp(sizeof(int32_t));
+                fs.write(reinterpret_cast<const char*>(&nodes), sizeof(nodes));
+                fs.close();
+                bool threw = false;
+                try { ALTLandmarks::FromFile(file_name); } catch (std::runtime_error &) { threw = true; }
+                assert(threw);
+            }
+            // as is a table with no landmarks
+            {
+                int32_t header[3];
+                std::ifstream(file_name, std::ios::binary).read(reinterpret_cast<char*>(header), sizeof(header));
+                header[1] = wg->num_nodes();
+                header[2] = 0;
+                std::ofstream(file_name, std::ios::binary).write(reinterpret_cast<const char*>(header), sizeof(header));
+                bool threw = false;
+                try { ALTLandmarks::FromFile(file_name); } catch (std::runtime_error &) { threw = true; }
+                assert(threw);
+            }
+            unlink(file_name);
+        }
+
+        // No landmarks is refused
+        for (int k : {0, -1}) {
+            bool threw = false;
+            try { ALTLandmarks::Build(wg, k); } catch (std::invalid_argument &) { threw = true; }
+            assert(threw);
+        }
+
+        // A table built for another graph is refused
+        {
+            auto other = std::make_shared<const WGraph>(WGraph::Uniform(1000, 3200));
+            auto lm = std::make_shared<const ALTLandmarks>(ALTLandmarks::Build(other, 2));
+            bool threw = false;
+            try { ALTDijkstra adijkstra(wg, lm, 0, goal); } catch (std::invalid_argument &) { threw = true; }
+            assert(threw);
+        }
+
+        return 0;
+    }
+
+private:
+    WGraph::Ptr _wg;
+    ALTLandmarks::Ptr _lm;
+    int  _root;
+    int  _goal;
+    int64_t _traversed_edges;
+    int64_t _fp_compares;
+    int64_t _fp_adds;
+    std::vector<float>    _distance;
+    std::vector<int>      _path;
+    std::vector<uint32_t> _stamp; // _distance and _path are valid where _stamp == _epoch
+    uint32_t _epoch;
+    std::vector<std::pair<float, int>> _heap;
+
+    void reset() {
+        _heap.clear();
+        if (++_epoch == std::numeric_limits<uint32_t>::max()) {
+            std::fill(_stamp.begin(), _stamp.end(), 0);
+            _epoch = 1;
+        }
+    }
+
+    void set(int v, float d, int from) {
+        _stamp[v] = _epoch;
+        _distance[v] = d;
+        _path[v] = from;
+    }
+};
@@ -1,24 +1,37 @@
 #pragma once
+#include <Graph.hpp>
+#include <Instrumentation.hpp>
+#include <PerfCounters.hpp>
+#include <MemoryFootprint.hpp>
 #include <set>
 #include <memory>
 
 namespace graph_tools {
-    class BFS {
+    /**
+     * G is Graph or any graph with the same Ptr, neighbors() and transposed()
+     * views (e.g. InstrumentedGraph). I is the instrumentation policy,
+     * with one round per level; each level is also a "bfs level[i]"
+     * PerfScope.
+     */
+    template <typename G, typename I = Counters>
+    class BasicBFS {
     public:
-        BFS(Graph* g = nullptr) :
+        using NodeID = typename G::NodeID;
+        BasicBFS(const typename G::Ptr &g = nullptr) :
             _g(g),
-            _traversed(0)
+            _transient(0)
             {}
 
-        Graph*& graph() { return _g; }
+        typename G::Ptr & graph() { return _g; }
 
-        void run(Graph::NodeID root, int iter, bool forward = true) {
+        void run(NodeID root, int iter, bool forward = true) {
             _visited.clear();
             _active.clear();
 
             _visited.insert(root);
             _active.insert(root);
-            _traversed = 0;
+            _instr.reset();
+            _transient = 0;
 
             if (forward) {
                 run_forward(root, iter);
@@ -27,14 +40,15 @@ namespace graph_tools {
             }
         }
 
-        void run_forward(Graph::NodeID root, int iter) {
+        void run_forward(NodeID root, int iter) {
             int i = 0;
             while (!_active.empty() && i++ < iter) {
-                std::set<Graph::NodeID> _next;
+                PerfScope scope("bfs level", i - 1);
+                std::set<NodeID> _next;
                 for (auto src : _active) {
                     for (auto dst : _g->neighbors(src)) {
                         // skip visited
-                        _traversed += 1;
+                        _instr.add(Stat::TRAVERSED_EDGES);
                         if (_visited.find(dst) != _visited.end())
                             continue;
                         // update
@@ -42,20 +56,23 @@ namespace graph_tools {
                         _next.insert(dst);
                     }
                 }
+                _transient = std::max(_transient, MemoryFootprint::Bytes(_next));
                 _active = _next;
+                _instr.next_round();
             }
         }
 
-        void run_back(Graph::NodeID root, int iter) {
+        void run_back(NodeID root, int iter) {
             int i = 0;
-            Graph _r = _g->transpose();
+            typename G::Ptr _r = _g->transposed();
             while (!_active.empty() && i++ < iter) {
-                std::set<Graph::NodeID> _next;
-                for (Graph::NodeID dst = 0; dst < _g->num_nodes(); dst++) {
+                PerfScope scope("bfs level", i - 1);
+                std::set<NodeID> _next;
+                for (NodeID dst = 0; dst < _g->num_nodes(); dst++) {
                     // skip visited
                     if (_visited.find(dst) != _visited.end()) continue;
-                    for (auto src : _r.neighbors(dst)) {
-                        _traversed += 1;
+                    for (auto src : _r->neighbors(dst)) {
+                        _instr.add(Stat::TRAVERSED_EDGES);
                         // skip inactive
                         if (_active.find(src) == _active.end()) continue;
                         // update
@@ -64,19 +81,34 @@ namespace graph_tools {
                         break;
                     }
                 }
+                _transient = std::max(_transient, MemoryFootprint::Bytes(_next));
                 _active = _next;
+                _instr.next_round();
             }
         }
 
     public:
-        std::set<Graph::NodeID> & visited() { return _visited; }
-        std::set<Graph::NodeID> & active()  { return _active; }
-        Graph::NodeID traversed() const { return _traversed; }
+        std::set<NodeID> & visited() { return _visited; }
+        std::set<NodeID> & active()  { return _active; }
+        int64_t traversed() const { return _instr.get(Stat::TRAVERSED_EDGES); }
+        const I & instrumentation() const { return _instr; }
+
+        /* bytes this search owns; the graph reports its own */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("visited", MemoryFootprint::Bytes(_visited));
+            f.add("active", MemoryFootprint::Bytes(_active));
+            f.add_transient("next", _transient);
+            return f;
+        }
 
     private:
-        Graph*  _g;
-        std::set<Graph::NodeID> _visited;
-        std::set<Graph::NodeID> _active;
-        Graph::NodeID _traversed;
+        typename G::Ptr _g;
+        std::set<NodeID> _visited;
+        std::set<NodeID> _active;
+        int64_t _transient; // largest next frontier
+        I _instr;
     };
+
+    using BFS = BasicBFS<Graph>;
 }
@@ -0,0 +1,233 @@
+#pragma once
+#include <Cache.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <functional>
+#include <stdexcept>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * Maps a block to (bank, block within the bank).
+         * INTERLEAVED stripes consecutive blocks across banks.
+         * XOR folds every log2(banks)-bit chunk of the block id into the
+         * bank index, so power-of-two strides still spread across banks;
+         * it needs a power-of-two bank count.
+         */
+        class BankHash {
+        public:
+            using Addr = Cache::Addr;
+            enum class Kind { INTERLEAVED, XOR };
+
+            BankHash(size_t banks = 1, Kind kind = Kind::INTERLEAVED) :
+                _banks(banks),
+                _kind(kind),
+                _bits(-1) {
+                if (banks == 0)
+                    throw std::invalid_argument("BankHash: need at least one bank");
+                if ((banks & (banks-1)) == 0) {
+                    _bits = 0;
+                    while ((size_t(1) << _bits) < banks) _bits++;
+                }
+                if (kind == Kind::XOR && _bits < 0)
+                    throw std::invalid_argument("BankHash: xor hashing needs a power-of-two bank count");
+            }
+
+            size_t bank(Addr block) const {
+                if (_bits < 0) return block % _banks;
+                if (_kind == Kind::INTERLEAVED || _bits == 0) return block & (_banks-1);
+                Addr h = 0;
+                for (Addr x = block; x != 0; x >>= _bits) h ^= x;
+                return h & (_banks-1);
+            }
+
+            /* block id within its bank; (bank, local) is unique per block */
+            Addr local(Addr block) const {
+                return _bits < 0 ? block / _banks : block >> _bits;
+            }
+
+            size_t banks() const { return _banks; }
+            Kind kind() const { return _kind; }
+
+        private:
+            size_t _banks;
+            Kind _kind;
+            int _bits;
+        };
+
+        /**
+         * A group of independent caches behind a bank hash, such as the
+         * per-column vcaches of a manycore. Each bank is addressed with its
+         * local block id, so all of its sets are usable.
+         */
+        class BankedCache {
+        public:
+            using Addr = Cache::Addr;
+            using Ptr  = std::shared_ptr<BankedCache>;
+
+            BankedCache(size_t banks, const std::function<Cache::Ptr()> &make,
+                        BankHash::Kind kind = BankHash::Kind::INTERLEAVED) :
+                _hash(banks, kind) {
+                for (size_t b = 0; b < banks; b++)
+                    _banks.push_back(make());
+                _block_size = _banks[0]->block_size();
+                for (auto &c : _banks)
+                    if (c->block_size() != _block_size)
+                        throw std::invalid_argument("BankedCache: banks must share a block size");
+            }
+
+            /* primary api, same as Cache */
+            void load(Addr addr) { access(addr, false); }
+            void load_multi(Addr addr, Addr sz) {
+                for_each_block(addr, sz, [this](Addr a) { access(a, false); });
+            }
+
+            void store(Addr addr) { access(addr, true); }
+            void store_multi(Addr addr, Addr sz) {
+                for_each_block(addr, sz, [this](Addr a) { access(a, true); });
+            }
+
+            /* routing, shared with ShardedCache */
+            size_t bank_of(Addr addr) const { return _hash.bank(addr / _block_size); }
+
+            /* addr as its bank sees it */
+            Addr local_addr(Addr addr) const { return _hash.local(addr / _block_size) * _block_size; }
+
+            void access_bank(size_t bank, Addr local, bool store) {
+                if (store) _banks[bank]->store(local);
+                else       _banks[bank]->load(local);
+            }
+
+            template <typename F>
+            void for_each_block(Addr addr, Addr sz, F f) const {
+                while (sz > 0) {
+                    f(addr);
+                    Addr step = _block_size - addr % _block_size;
+                    addr += step;
+                    sz   -= step;
+                }
+            }
+
+            size_t banks() const { return _banks.size(); }
+            Cache::CPtr bank(size_t b) const { return _banks.at(b); }
+            const BankHash & hash() const { return _hash; }
+            Addr block_size() const { return _block_size; }
+            Addr size() const { return _banks.size() * _banks[0]->size(); }
+
+            /* stats api, summed over banks */
+            int64_t sum_hits() const { return sum(&Cache::sum_hits); }
+            int64_t sum_misses() const { return sum(&Cache::sum_misses); }
+            int64_t sum_flushes() const { return sum(&Cache::sum_flushes); }
+            int64_t compulsory_misses() const { return sum(&Cache::compulsory_misses); }
+
+            std::string stats_csv_header() const {
+                return _banks[0]->stats_csv_header();
+            }
+
+            std::string stats_csv() const {
+                std::stringstream ss;
+                ss << sum_hits() << ",";
+                ss << sum_misses() << ",";
+                ss << compulsory_misses() << ",";
+                ss << sum_flushes() << ",";
+                return ss.str();
+            }
+
+            /* one row per bank, for spotting imbalance */
+            std::string bank_stats_csv() const {
+                std::stringstream ss;
+                ss << "bank," << stats_csv_header() << "\n";
+                for (size_t b = 0; b < _banks.size(); b++)
+                    ss << b << "," << _banks[b]->stats_csv() << "\n";
+                return ss.str();
+            }
+
+            static int Test(int argc, char *argv[]);
+
+        private:
+            void access(Addr addr, bool store) {
+                access_bank(bank_of(addr), local_addr(addr), store);
+            }
+
+            int64_t sum(int64_t (Cache::*stat)() const) const {
+                int64_t total = 0;
+                for (auto &c : _banks) total += ((*c).*stat)();
+                return total;
+            }
+
+            BankHash _hash;
+            std::vector<Cache::Ptr> _banks;
+            Addr _block_size;
+        };
+
+        /**
+         * HammerBlade's vcaches as separate banks: one per column on the
+         * top and bottom edges, 64 sets x 8 ways of 8-word blocks each.
+         * Blocks are striped across the vcaches with the stripe index
+         * XOR-hashed, so strided arrays don't pile onto one vcache.
+         * HammerBladeCache() approximates this as one big LRUCache, which
+         * matches the INTERLEAVED kind exactly.
+         */
+        static BankedCache::Ptr HammerBladeBankedCache(BankHash::Kind kind = BankHash::Kind::XOR) {
+            int x = 16;
+            int caches = x * 2; // top n bottom
+            int sets = 64;
+            int ways = 8;
+            int block_size = 8*4; // 8 4-byte words
+            return std::make_shared<BankedCache>(caches, [=]() {
+                    return std::make_shared<LRUCache>(sets * ways * block_size, block_size, ways);
+                }, kind);
+        }
+
+        inline int BankedCache::Test(int argc, char *argv[]) {
+            // Interleaved banks are the single-cache approximation
+            {
+                auto single = HammerBladeCache();
+                auto banked = HammerBladeBankedCache(BankHash::Kind::INTERLEAVED);
+                assert(single->size() == banked->size());
+                for (Addr i = 0; i < 200000; i++) {
+                    Addr addr = (i % 3 == 0) ? i * 4 : (i * 2654435761u) % (4 << 20);
+                    if (i % 5 == 0) { single->store(addr); banked->store(addr); }
+                    else            { single->load(addr);  banked->load(addr);  }
+                }
+                assert(single->stats_csv() == banked->stats_csv());
+            }
+            // A bank-sized stride lands on one interleaved bank; xor spreads it
+            {
+                auto interleaved = HammerBladeBankedCache(BankHash::Kind::INTERLEAVED);
+                auto hashed      = HammerBladeBankedCache(BankHash::Kind::XOR);
+                Addr stride = 32 * 32; // banks * block_size
+                for (int pass = 0; pass < 4; pass++) {
+                    for (Addr i = 0; i < 4096; i++) {
+                        interleaved->load(i * stride);
+                        hashed->load(i * stride);
+                    }
+                }
+                int used = 0;
+                for (size_t b = 0; b < hashed->banks(); b++)
+                    used += hashed->bank(b)->sum_misses() > 0;
+                assert(used == 32);
+                assert(interleaved->bank(0)->sum_misses() == interleaved->sum_misses());
+                assert(hashed->sum_hits() > interleaved->sum_hits());
+                std::cout << "xor banks:\n" << hashed->bank_stats_csv() << std::endl;
+            }
+            // Every block has a unique (bank, local) pair
+            {
+                BankHash h(8, BankHash::Kind::XOR);
+                std::vector<std::vector<int>> seen(8, std::vector<int>(1 << 10, 0));
+                for (Addr block = 0; block < 8 << 10; block++)
+                    assert(seen[h.bank(block)][h.local(block)]++ == 0);
+
+                bool thrown = false;
+                try { BankHash bad(6, BankHash::Kind::XOR); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+            }
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <WGraph.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cassert>
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+
+/**
+ * Answers batches of (root, goal) queries on a pool of worker threads,
+ * started with the object and parked between batches, so a batch of
+ * short queries does not pay for thread start-up.
+ * Each worker owns a Workspace that survives across queries and batches;
+ * resetting it bumps an epoch instead of clearing |V| entries, so short
+ * queries only pay for the vertices they touch.
+ */
+class BatchDijkstra {
+public:
+    using WGraph = graph_tools::WGraph;
+    using Query  = std::pair<int,int>; // (root, goal)
+
+    BatchDijkstra(const WGraph::Ptr &wg,
+                  int threads = std::thread::hardware_concurrency()) :
+        _wg(wg),
+        _workspaces(std::max(threads, 1), Workspace(wg->num_nodes())),
+        _queries(0),
+        _traversed_edges(0) {
+        for (size_t t = 1; t < _workspaces.size(); t++)
+            _workers.emplace_back(&BatchDijkstra::work, this, t);
+    }
+
+    ~BatchDijkstra() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (auto &w : _workers) w.join();
+    }
+
+    BatchDijkstra(const BatchDijkstra &) = delete;
+    BatchDijkstra & operator=(const BatchDijkstra &) = delete;
+
+    /**
+     * Distance from root to goal for each query, in query order
+     * (INFINITY when goal is unreachable).
+     */
+    std::vector<float> run(const std::vector<Query> &queries) {
+        std::vector<float> out(queries.size());
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _batch = &queries;
+            _out = &out;
+            _next = 0;
+            _traversed = 0;
+            _pending = _workers.size();
+            _generation++;
+        }
+        _start.notify_all();
+        drain(_workspaces[0]);
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [&]() { return _pending == 0; });
+        }
+
+        _queries += queries.size();
+        _traversed_edges += _traversed;
+        return out;
+    }
+
+    int threads() const { return _workspaces.size(); }
+
+    /* per-worker workspaces, which persist between batches; the graph is shared */
+    graph_tools::MemoryFootprint footprint() const {
+        graph_tools::MemoryFootprint f;
+        int64_t distance = 0, stamp = 0, heap = 0;
+        for (const Workspace &ws : _workspaces) {
+            distance += graph_tools::MemoryFootprint::Bytes(ws.distance);
+            stamp += graph_tools::MemoryFootprint::Bytes(ws.stamp);
+            heap += graph_tools::MemoryFootprint::Bytes(ws.heap);
+        }
+        f.add("workspace distance", distance);
+        f.add("workspace stamp", stamp);
+        f.add("workspace heap", heap);
+        return f;
+    }
+
+    void stats(const std::string &fname) const {
+        std::ofstream of(fname);
+        of << stats_str();
+    }
+
+    std::string stats_str() const {
+        std::stringstream ss;
+        ss << "nodes:                 " << _wg->num_nodes() << "\n";
+        ss << "edges:                 " << _wg->num_edges() << "\n";
+        ss << "threads:               " << threads() << "\n";
+        ss << "queries:               " << _queries << "\n";
+        ss << "traversed edges:       " << _traversed_edges << "\n";
+        return ss.str();
+    }
+
+    static int Test(int argc, char *argv[]) {
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+
+        std::vector<Query> queries;
+        std::default_random_engine gen;
+        std::uniform_int_distribution<int> idist(0, wg->num_nodes()-1);
+        for (int i = 0; i < 256; i++)
+            queries.push_back({idist(gen), idist(gen)});
+        queries.push_back({7, 7});
+
+        BatchDijkstra batch(wg, 4);
+        std::vector<float> distances = batch.run(queries);
+        // run again so every workspace is reused at least once
+        std::vector<float> again = batch.run(queries);
+        assert(distances == again);
+        // and batches smaller than the pool, on the same workers
+        for (size_t q = 0; q < queries.size(); q += 8)
+            assert(batch.run({queries[q]}) == std::vector<float>{distances[q]});
+        assert(batch.run({}).empty());
+
+        for (size_t q = 0; q < queries.size(); q += 16) {
+            FastDijkstra fdijkstra(wg, queries[q].first, queries[q].second);
+            fdijkstra.run();
+            float expect = fdijkstra.distance()[queries[q].second];
+            assert(std::isinf(expect) == std::isinf(distances[q]));
+            assert(std::isinf(expect) || std::fabs(expect - distances[q]) < 1e-3);
+        }
+        assert(distances.back() == 0.0);
+
+        std::cout << "stats:" << std::endl;
+        std::cout << batch.stats_str() << std::endl;
+        return 0;
+    }
+
+private:
+    using Epoch = uint32_t;
+    using Entry = std::pair<float, int>;
+
+    /* per-worker state, valid only where stamp[v] == epoch */
+    struct Workspace {
+        Workspace(int nodes = 0) :
+            distance(nodes), stamp(nodes, 0), epoch(0) {}
+
+        void reset() {
+            heap.clear();
+            if (++epoch == std::numeric_limits<Epoch>::max()) {
+                std::fill(stamp.begin(), stamp.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        float get(int v) const {
+            return stamp[v] == epoch ? distance[v] : INFINITY;
+        }
+
+        void set(int v, float d) {
+            stamp[v] = epoch;
+            distance[v] = d;
+        }
+
+        std::vector<float> distance;
+        std::vector<Epoch> stamp;
+        std::vector<Entry> heap;
+        Epoch epoch;
+    };
+
+    /* worker t answers its share of each batch until destruction */
+    void work(size_t t) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&]() { return _stop || _generation != seen; });
+                if (_stop) return;
+                seen = _generation;
+            }
+            drain(_workspaces[t]);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_pending == 0) _done.notify_one();
+            }
+        }
+    }
+
+    /* take queries from the current batch until none are left */
+    void drain(Workspace &ws) {
+        const std::vector<Query> &queries = *_batch;
+        int64_t local = 0;
+        for (size_t q = _next++; q < queries.size(); q = _next++)
+            (*_out)[q] = query(ws, queries[q].first, queries[q].second, local);
+        _traversed += local;
+    }
+
+    float query(Workspace &ws, int root, int goal, int64_t &traversed) const {
+        auto &offs = _wg->get_offsets();
+        auto &degs = _wg->get_degrees();
+        auto &neib = _wg->get_neighbors();
+        auto &wgts = _wg->get_weights();
+        std::greater<Entry> cmp;
+
+        ws.reset();
+        ws.set(root, 0.0);
+        ws.heap.push_back({0.0, root});
+
+        while (!ws.heap.empty()) {
+            std::pop_heap(ws.heap.begin(), ws.heap.end(), cmp);
+            Entry top = ws.heap.back();
+            ws.heap.pop_back();
+
+            int src = top.second;
+            if (src == goal)
+                return top.first;
+            if (top.first > ws.get(src))
+                continue; // stale entry
+
+            for (WGraph::NodeID dst_i = 0; dst_i < degs[src]; dst_i++) {
+                int dst = neib[offs[src]+dst_i];
+                float d = top.first + wgts[offs[src]+dst_i];
+                if (d < ws.get(dst)) {
+                    ws.set(dst, d);
+                    ws.heap.push_back({d, dst});
+                    std::push_heap(ws.heap.begin(), ws.heap.end(), cmp);
+                }
+                traversed++;
+            }
+        }
+
+        return INFINITY;
+    }
+
+    WGraph::Ptr _wg;
+    std::vector<Workspace> _workspaces;
+    int64_t _queries;
+    int64_t _traversed_edges;
+
+    // hand-off between run() and the workers, guarded by _mutex
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    uint64_t _generation = 0;
+    size_t _pending = 0;
+    bool _stop = false;
+    const std::vector<Query> *_batch = nullptr;
+    std::vector<float> *_out = nullptr;
+    std::atomic<size_t> _next{0};
+    std::atomic<int64_t> _traversed{0};
+    std::vector<std::thread> _workers;
+};
@@ -0,0 +1,367 @@
+#pragma once
+#include <Graph500Data.hpp>
+#include <vector>
+#include <string>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#include <cmath>
+#include <cassert>
+#include <stdint.h>
+
+namespace graph_tools {
+
+    /**
+     * Timing harness for the bench targets. Each case runs warmup
+     * untimed repetitions, then reps timed ones, with an optional untimed
+     * setup before each. Results are reported as min/median/p90/max over
+     * the timed repetitions and written as CSV and JSON, keyed by
+     * (case, graph), so that runs from two commits can be diffed; a run
+     * given a baseline CSV flags cases whose median got slower.
+     */
+    class Benchmark {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /* names of the graph presets, smallest first, as Graph500Data defines them */
+        static const std::vector<std::string> & Presets() {
+            static const std::vector<std::string> presets = [] {
+                std::vector<std::string> names;
+                for (const Graph500Data::Preset &p : Graph500Data::Presets())
+                    names.push_back(p.name);
+                return names;
+            }();
+            return presets;
+        }
+
+        struct Options {
+            Options() :
+                warmup(1),
+                reps(5),
+                max_preset("Mega"),
+                threshold(0.10) {}
+
+            int warmup;
+            int reps;
+            std::string max_preset;
+            std::string filter;    // run cases whose name contains this
+            std::string label;     // e.g. the commit, copied into the output
+            std::string csv;       // output files; empty for none
+            std::string json;
+            std::string baseline;  // csv from an earlier run to compare against
+            double threshold;      // median slowdown that counts as a regression
+
+            /* --flag value pairs; throws std::invalid_argument on bad input */
+            static Options Parse(int argc, char *argv[]) {
+                Options o;
+                for (int i = 1; i < argc; i++) {
+                    std::string flag = argv[i];
+                    if (i + 1 >= argc)
+                        throw std::invalid_argument("Benchmark: " + flag + " needs a value");
+                    std::string value = argv[++i];
+                    if      (flag == "--warmup")     o.warmup = std::stoi(value);
+                    else if (flag == "--reps")       o.reps = std::stoi(value);
+                    else if (flag == "--max-preset") o.max_preset = value;
+                    else if (flag == "--filter")     o.filter = value;
+                    else if (flag == "--label")      o.label = value;
+                    else if (flag == "--csv")        o.csv = value;
+                    else if (flag == "--json")       o.json = value;
+                    else if (flag == "--baseline")   o.baseline = value;
+                    else if (flag == "--threshold")  o.threshold = std::stod(value);
+                    else throw std::invalid_argument("Benchmark: unknown flag " + flag);
+                }
+                if (o.warmup < 0 || o.reps < 1)
+                    throw std::invalid_argument("Benchmark: need warmup >= 0 and reps >= 1");
+                PresetIndex(o.max_preset);
+                return o;
+            }
+        };
+
+        struct Result {
+            std::string name;
+            std::string graph;
+            int64_t nodes;
+            int64_t edges;
+            std::vector<double> seconds; // per timed repetition, in run order
+            double min;
+            double median;
+            double p90;
+            double max;
+
+            /* edges per second at the median, in millions */
+            double medges_per_s() const { return median > 0 ? edges / median / 1e6 : 0.0; }
+        };
+
+        Benchmark(const Options &options = Options()) : _options(options) {}
+
+        const Options & options() const { return _options; }
+
+        /* should presets up to max_preset (and this one) run? */
+        bool runs_preset(const std::string &preset) const {
+            return PresetIndex(preset) <= PresetIndex(_options.max_preset);
+        }
+
+        bool runs_case(const std::string &name) const {
+            return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+        }
+
+        /**
+         * Time body on a graph with nodes and edges. Cases that don't match
+         * the filter are skipped and return false.
+         */
+        bool run(const std::string &name, const std::string &graph, int64_t nodes, int64_t edges,
+                 const std::function<void()> &body,
+                 const std::function<void()> &setup = std::function<void()>()) {
+            if (!runs_case(name)) return false;
+            for (int i = 0; i < _options.warmup; i++) {
+                if (setup) setup();
+                body();
+            }
+            std::vector<double> seconds;
+            for (int i = 0; i < _options.reps; i++) {
+                if (setup) setup();
+                auto t0 = clock::now();
+                body();
+                auto t1 = clock::now();
+                seconds.push_back(std::chrono::duration<double>(t1 - t0).count());
+            }
+            record(name, graph, nodes, edges, seconds);
+            return true;
+        }
+
+        /* add a case timed elsewhere; seconds must not be empty */
+        void record(const std::string &name, const std::string &graph, int64_t nodes, int64_t edges,
+                    const std::vector<double> &seconds) {
+            Result r;
+            r.name = name;
+            r.graph = graph;
+            r.nodes = nodes;
+            r.edges = edges;
+            r.seconds = seconds;
+            std::vector<double> sorted = r.seconds;
+            std::sort(sorted.begin(), sorted.end());
+            r.min = sorted.front();
+            r.median = Percentile(sorted, 0.5);
+            r.p90 = Percentile(sorted, 0.9);
+            r.max = sorted.back();
+            _results.push_back(r);
+
+            std::cout << std::left << std::setw(32) << name << std::setw(16) << graph << std::right
+                      << " median " << std::setw(12) << r.median << "s"
+                      << " p90 " << std::setw(12) << r.p90 << "s"
+                      << " " << std::setw(10) << r.medges_per_s() << " Medges/s" << std::endl;
+        }
+
+        const std::vector<Result> & results() const { return _results; }
+
+        /* linear interpolation between closest ranks; sorted must not be empty */
+        static double Percentile(const std::vector<double> &sorted, double p) {
+            double pos = p * (sorted.size() - 1);
+            size_t lo = static_cast<size_t>(pos);
+            if (lo + 1 >= sorted.size()) return sorted.back();
+            double frac = pos - lo;
+            return sorted[lo] * (1.0 - frac) + sorted[lo + 1] * frac;
+        }
+
+        /* stats api */
+        std::string stats_csv_header() const {
+            return "label,name,graph,nodes,edges,reps,min_s,median_s,p90_s,max_s,medges_per_s,";
+        }
+
+        std::string stats_csv() const {
+            std::stringstream ss;
+            ss << std::setprecision(9);
+            for (const Result &r : _results) {
+                ss << _options.label << ",";
+                ss << r.name << ",";
+                ss << r.graph << ",";
+                ss << r.nodes << ",";
+                ss << r.edges << ",";
+                ss << r.seconds.size() << ",";
+                ss << r.min << ",";
+                ss << r.median << ",";
+                ss << r.p90 << ",";
+                ss << r.max << ",";
+                ss << r.medges_per_s() << ",\n";
+            }
+            return ss.str();
+        }
+
+        std::string stats_json() const {
+            std::stringstream ss;
+            ss << std::setprecision(9);
+            ss << "{\n  \"label\": \"" << _options.label << "\",\n";
+            ss << "  \"warmup\": " << _options.warmup << ",\n";
+            ss << "  \"reps\": " << _options.reps << ",\n";
+            ss << "  \"results\": [";
+            for (size_t i = 0; i < _results.size(); i++) {
+                const Result &r = _results[i];
+                ss << (i ? ",\n" : "\n");
+                ss << "    {\"name\": \"" << r.name << "\", \"graph\": \"" << r.graph << "\", "
+                   << "\"nodes\": " << r.nodes << ", \"edges\": " << r.edges << ", "
+                   << "\"min_s\": " << r.min << ", \"median_s\": " << r.median << ", "
+                   << "\"p90_s\": " << r.p90 << ", \"max_s\": " << r.max << ", "
+                   << "\"medges_per_s\": " << r.medges_per_s() << ", \"seconds\": [";
+                for (size_t k = 0; k < r.seconds.size(); k++)
+                    ss << (k ? ", " : "") << r.seconds[k];
+                ss << "]}";
+            }
+            ss << "\n  ]\n}\n";
+            return ss.str();
+        }
+
+        /**
+         * Writes the requested output files and compares against the
+         * baseline. Returns the number of regressions, so a bench main can
+         * return it as its exit status.
+         */
+        int finish() const {
+            if (!_options.csv.empty()) {
+                std::ofstream f(_options.csv);
+                f << stats_csv_header() << "\n" << stats_csv();
+            }
+            if (!_options.json.empty()) {
+                std::ofstream f(_options.json);
+                f << stats_json();
+            }
+            if (_options.baseline.empty()) return 0;
+
+            std::ifstream f(_options.baseline);
+            if (!f)
+                throw std::runtime_error("Benchmark: can't open baseline " + _options.baseline);
+            return compare(f, std::cout);
+        }
+
+        /**
+         * Median ratios against a baseline csv. Cases missing from either
+         * side (among those this run's filter and max preset allow) are
+         * listed but aren't regressions.
+         */
+        int compare(std::istream &baseline, std::ostream &os) const {
+            std::map<std::pair<std::string, std::string>, double> base;
+            std::string line;
+            std::vector<std::string> header;
+            if (std::getline(baseline, line)) header = Split(line);
+            auto column = [&header](const std::string &name) {
+                auto it = std::find(header.begin(), header.end(), name);
+                if (it == header.end())
+                    throw std::runtime_error("Benchmark: baseline has no " + name + " column");
+                return static_cast<size_t>(it - header.begin());
+            };
+            size_t name_c = column("name"), graph_c = column("graph"), median_c = column("median_s");
+            while (std::getline(baseline, line)) {
+                std::vector<std::string> row = Split(line);
+                if (row.size() <= std::max(name_c, std::max(graph_c, median_c))) continue;
+                base[{row[name_c], row[graph_c]}] = std::stod(row[median_c]);
+            }
+
+            int regressions = 0;
+            for (const Result &r : _results) {
+                auto it = base.find({r.name, r.graph});
+                os << std::left << std::setw(32) << r.name << std::setw(16) << r.graph << std::right;
+                if (it == base.end()) {
+                    os << " new\n";
+                    continue;
+                }
+                double ratio = it->second > 0 ? r.median / it->second : 1.0;
+                bool slower = ratio > 1.0 + _options.threshold;
+                regressions += slower;
+                os << " " << std::setw(8) << std::fixed << std::setprecision(3) << ratio
+                   << std::defaultfloat << "x" << (slower ? "  REGRESSION" : "") << "\n";
+                base.erase(it);
+            }
+            for (auto &kv : base) {
+                // only what this run would have timed
+                std::string preset = kv.first.second.substr(0, kv.first.second.find(' '));
+                bool known = std::find(Presets().begin(), Presets().end(), preset) != Presets().end();
+                if (!runs_case(kv.first.first) || (known && !runs_preset(preset))) continue;
+                os << std::left << std::setw(32) << kv.first.first << std::setw(16) << kv.first.second
+                   << std::right << " missing\n";
+            }
+            os << regressions << " regressions over " << _options.threshold * 100 << "%" << std::endl;
+            return regressions;
+        }
+
+        static int Test(int argc, char *argv[]) {
+            // Percentiles interpolate between ranks
+            assert(Percentile({1.0}, 0.9) == 1.0);
+            assert(Percentile({1.0, 2.0, 3.0}, 0.5) == 2.0);
+            assert(Percentile({1.0, 2.0, 3.0, 4.0}, 0.5) == 2.5);
+            assert(std::abs(Percentile({0.0, 10.0}, 0.9) - 9.0) < 1e-9);
+
+            // Flags parse, and bad ones throw
+            {
+                const char *args[] = {"bench", "--reps", "3", "--max-preset", "Small", "--filter", "dijkstra"};
+                Options o = Options::Parse(7, const_cast<char**>(args));
+                assert(o.reps == 3 && o.warmup == 1 && o.max_preset == "Small" && o.filter == "dijkstra");
+                Benchmark b(o);
+                assert(b.runs_preset("Tiny") && b.runs_preset("Small") && !b.runs_preset("Kila"));
+                assert(b.runs_case("fast dijkstra") && !b.runs_case("bfs forward"));
+                for (auto bad : {std::vector<const char*>{"bench", "--reps"},
+                                 std::vector<const char*>{"bench", "--reps", "0"},
+                                 std::vector<const char*>{"bench", "--max-preset", "Huge"},
+                                 std::vector<const char*>{"bench", "--bogus", "1"}}) {
+                    bool thrown = false;
+                    try { Options::Parse(bad.size(), const_cast<char**>(bad.data())); }
+                    catch (std::invalid_argument &) { thrown = true; }
+                    assert(thrown);
+                }
+            }
+
+            // Warmups and setups run untimed; each rep is timed
+            Options o;
+            o.warmup = 2;
+            o.reps = 4;
+            o.label = "test";
+            Benchmark b(o);
+            int setups = 0, bodies = 0;
+            volatile double sink = 0;
+            assert(b.run("spin", "Tiny", 10, 100,
+                         [&]() { bodies++; for (int i = 0; i < 100000; i++) sink = sink + i; },
+                         [&]() { setups++; }));
+            assert(setups == 6 && bodies == 6);
+            const Result &r = b.results().at(0);
+            assert(r.seconds.size() == 4);
+            assert(r.min <= r.median && r.median <= r.p90 && r.p90 <= r.max);
+            std::cout << b.stats_csv_header() << "\n" << b.stats_csv() << b.stats_json();
+
+            // A baseline with half the median is a regression; one with twice isn't
+            for (double scale : {0.5, 2.0}) {
+                std::stringstream base;
+                base << "name,graph,median_s,\nspin,Tiny," << r.median * scale << ",\ngone,Tiny,1.0,\n";
+                std::stringstream out;
+                int regressions = b.compare(base, out);
+                std::cout << out.str();
+                assert(regressions == (scale < 1 ? 1 : 0));
+                assert(out.str().find("gone") != std::string::npos);
+            }
+            return 0;
+        }
+
+    private:
+        static size_t PresetIndex(const std::string &preset) {
+            auto it = std::find(Presets().begin(), Presets().end(), preset);
+            if (it == Presets().end())
+                throw std::invalid_argument("Benchmark: unknown preset " + preset);
+            return it - Presets().begin();
+        }
+
+        static std::vector<std::string> Split(const std::string &line) {
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, ',')) fields.push_back(field);
+            return fields;
+        }
+
+        Options _options;
+        std::vector<Result> _results;
+    };
+}
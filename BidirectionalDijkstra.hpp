@@ -0,0 +1,214 @@
+#pragma once
+#include <WGraph.hpp>
+#include <queue>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+
+/**
+ * Point-to-point Dijkstra that searches forward from the root over the
+ * graph and backward from the goal over its cached transpose, stopping
+ * once top(forward) + top(backward) >= mu, the best root->goal distance
+ * seen so far.
+ */
+class BidirectionalDijkstra {
+public:
+    using WGraph = graph_tools::WGraph;
+    BidirectionalDijkstra(const WGraph &wg, int root, int goal) :
+        BidirectionalDijkstra(std::make_shared<const WGraph>(wg), root, goal) {}
+
+    BidirectionalDijkstra(const WGraph::Ptr &wg, int root, int goal) :
+        _wg(wg),
+        _rg(wg->transposed()),
+        _root(root),
+        _goal(goal),
+        _meet(-1),
+        _traversed_edges(0),
+        _fp_compares(0),
+        _fp_adds(0) {}
+
+
+    std::pair<std::vector<int>, std::vector<float>>
+    run() {
+        _distance.clear();
+        _path.clear();
+        _rdistance.clear();
+        _rpath.clear();
+
+        _distance.resize(_wg->num_nodes(), INFINITY);
+        _path.resize(_wg->num_nodes(),-1);
+        _rdistance.resize(_wg->num_nodes(), INFINITY);
+        _rpath.resize(_wg->num_nodes(),-1);
+
+        _distance[_root] = 0.0;
+        _path[_root] = _root;
+        _rdistance[_goal] = 0.0;
+        _rpath[_goal] = _goal;
+
+        Queue fqueue, rqueue;
+        fqueue.push({0.0, _root});
+        rqueue.push({0.0, _goal});
+
+        float mu = _root == _goal ? 0.0 : INFINITY;
+        _meet = _root == _goal ? _root : -1;
+
+        bool forward = true;
+        while (!fqueue.empty() && !rqueue.empty()) {
+            // stopping criterion
+            _fp_adds += 1;
+            _fp_compares += 1;
+            if (fqueue.top().first + rqueue.top().first >= mu)
+                break;
+
+            if (forward) {
+                step(*_wg, fqueue, _distance, _path, _rdistance, mu);
+            } else {
+                step(*_rg, rqueue, _rdistance, _rpath, _distance, mu);
+            }
+            forward = !forward;
+        }
+
+        if (_meet == -1)
+            return {_path, _distance};
+
+        // splice the backward half of the path onto the forward half
+        _distance[_goal] = mu;
+        for (int v = _meet; v != _goal; v = _rpath[v]) {
+            int nxt = _rpath[v];
+            _path[nxt] = v;
+            _distance[nxt] = mu - _rdistance[nxt];
+        }
+
+        return {_path, _distance};
+    }
+
+    int goal() const { return _goal; }
+    int meet() const { return _meet; }
+    std::vector<float> & distance() { return _distance; }
+    std::vector<int>   & path() { return _path; }
+    std::vector<float> distance() const { return _distance; }
+    std::vector<int>   path() const { return _path; }
+
+    /* bytes this search owns; the graph and its transpose are shared */
+    graph_tools::MemoryFootprint footprint() const {
+        graph_tools::MemoryFootprint f;
+        f.add("distance", graph_tools::MemoryFootprint::Bytes(_distance));
+        f.add("path", graph_tools::MemoryFootprint::Bytes(_path));
+        f.add("reverse distance", graph_tools::MemoryFootprint::Bytes(_rdistance));
+        f.add("reverse path", graph_tools::MemoryFootprint::Bytes(_rpath));
+        return f;
+    }
+
+    void stats(const std::string &fname) const {
+        std::ofstream of(fname);
+        of << stats_str();
+    }
+
+    std::string stats_str() const {
+        std::stringstream ss;
+        ss << "nodes:                 " << _wg->num_nodes() << "\n";
+        ss << "edges:                 " << _wg->num_edges() << "\n";
+        ss << "root:                  " << _root << "\n";
+        ss << "goal:                  " << _goal << "\n";
+        ss << "traversed edges:       " << _traversed_edges << "\n";
+        ss << "fp compares:           " << _fp_compares << "\n";
+        ss << "fp adds:               " << _fp_adds << "\n";
+        ss << "fp total:              " << _fp_compares+_fp_adds << "\n";
+        ss << "fp total analytical:   " << 2 * (_wg->num_nodes()-1) * _wg->num_edges() << "\n";
+        ss << "distance (root->goal): " << _distance[_goal] << "\n";
+        return ss.str();
+    }
+
+
+    static int Test(int argc, char *argv[]) {
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+        Dijkstra dijkstra(wg, 0);
+        dijkstra.run();
+        dijkstra.goal(5.0);
+
+        FastDijkstra fdijkstra(wg, 0, dijkstra.goal());
+        fdijkstra.run();
+
+        BidirectionalDijkstra bdijkstra(wg, 0, dijkstra.goal());
+        bdijkstra.run();
+
+        std::cout << "fast stats:" << std::endl;
+        std::cout << fdijkstra.stats_str() << std::endl;
+        std::cout << "bidirectional stats:" << std::endl;
+        std::cout << bdijkstra.stats_str() << std::endl;
+
+        int goal = dijkstra.goal();
+        assert(std::fabs(bdijkstra.distance()[goal] - dijkstra.distance()[goal]) < 1e-3);
+
+        // walk the spliced path back to the root
+        int v = goal;
+        WGraph::NodeID hops = 0;
+        while (v != 0 && hops++ < wg->num_nodes())
+            v = bdijkstra.path()[v];
+        assert(v == 0);
+
+        return 0;
+    }
+
+private:
+    using Entry = std::pair<float, int>;
+    using Queue = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+
+    /* settle one vertex from queue and relax its edges in g */
+    void step(const WGraph &g, Queue &queue,
+              std::vector<float> &distance, std::vector<int> &path,
+              const std::vector<float> &other_distance, float &mu) {
+        // approx. deletion with O(logN)
+        _fp_compares += ceil(log2(queue.size()));
+        Entry top = queue.top();
+        queue.pop();
+
+        int src = top.second;
+        _fp_compares += 1;
+        if (top.first > distance[src])
+            return; // stale entry
+
+        auto &offs = g.get_offsets();
+        auto &degs = g.get_degrees();
+        auto &neib = g.get_neighbors();
+        auto &wgts = g.get_weights();
+        for (WGraph::NodeID dst_i = 0; dst_i < degs[src]; dst_i++) {
+            int dst = neib[offs[src]+dst_i];
+            float w = wgts[offs[src]+dst_i];
+            if (distance[src]+w < distance[dst]) {
+                path[dst] = src;
+                distance[dst] = distance[src]+w;
+                // approx. insertion with O(logN)
+                _fp_compares += queue.size() == 0 ? 0 : ceil(log2(queue.size()));
+                queue.push({distance[dst], dst});
+            }
+
+            // update the best meeting point
+            if (distance[dst] + other_distance[dst] < mu) {
+                mu = distance[dst] + other_distance[dst];
+                _meet = dst;
+            }
+
+            _fp_adds += 2;
+            _fp_compares += 2;
+            _traversed_edges += 1;
+        }
+    }
+
+    WGraph::Ptr _wg;
+    WGraph::Ptr _rg;
+    int  _root;
+    int  _goal;
+    int  _meet;
+    int64_t _traversed_edges;
+    int64_t _fp_compares;
+    int64_t _fp_adds;
+    std::vector<float> _distance;
+    std::vector<int>   _path;
+    std::vector<float> _rdistance;
+    std::vector<int>   _rpath;
+};
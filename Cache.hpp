@@ -4,9 +4,12 @@
 #include <string>
 #include <sstream>
 #include <stdint.h>
-#include <list>
-#include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <memory>
+#include <stdexcept>
+#include <cassert>
+#include <MemoryPort.hpp>
 
 namespace graph_tools {
     namespace memory_modeling {
@@ -32,6 +35,81 @@ namespace graph_tools {
             Addr assoc() const { return _assoc; }
         };
 
+        /**
+         * Set of block ids; tracks which blocks have ever been touched so a
+         * cold-miss check costs one probe and one bit test. Blocks are
+         * grouped in pages of 512 (one cache line of bits), found through
+         * an open-addressing table keyed by page id, so the dense arrays of
+         * a kernel take about one bit per block and stay cache resident.
+         */
+        class BlockSet {
+        public:
+            using Addr = intptr_t;
+
+            BlockSet() : _size(0), _pages(0), _table(64) {}
+
+            /* insert block; returns true if it was not present */
+            bool insert(Addr block) {
+                if (2 * (_pages + 1) > _table.size()) grow();
+                Page &p = _table[probe(block >> PAGE_SHIFT)];
+                if (p.id == EMPTY) {
+                    p.id = block >> PAGE_SHIFT;
+                    _pages++;
+                }
+                uint64_t &word = p.bits[(block >> 6) & (WORDS-1)];
+                uint64_t bit = uint64_t(1) << (block & 63);
+                if (word & bit) return false;
+                word |= bit;
+                _size++;
+                return true;
+            }
+
+            bool contains(Addr block) const {
+                const Page &p = _table[probe(block >> PAGE_SHIFT)];
+                return p.id != EMPTY && (p.bits[(block >> 6) & (WORDS-1)] >> (block & 63)) & 1;
+            }
+
+            size_t size() const { return _size; }
+
+        private:
+            enum : Addr { EMPTY = -1, PAGE_SHIFT = 9, WORDS = (Addr(1) << PAGE_SHIFT) / 64 };
+
+            struct Page {
+                Page() : id(EMPTY), bits() {}
+                Addr id;
+                uint64_t bits[WORDS];
+            };
+
+            /* slot holding page id, or the empty slot where it belongs */
+            size_t probe(Addr id) const {
+                size_t mask = _table.size() - 1;
+                // fibonacci hashing spreads strided page ids
+                uint64_t h = static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull;
+                size_t i = (h ^ (h >> 32)) & mask;
+                while (_table[i].id != EMPTY && _table[i].id != id)
+                    i = (i + 1) & mask;
+                return i;
+            }
+
+            void grow() {
+                std::vector<Page> old(_table.size() * 2);
+                old.swap(_table);
+                for (const Page &p : old)
+                    if (p.id != EMPTY) _table[probe(p.id)] = p;
+            }
+
+            size_t _size;
+            size_t _pages;
+            std::vector<Page> _table;
+        };
+
+        /**
+         * Type-erased cache: geometry, tag state and stats. Concrete
+         * caches are PolicyCache<Policy>, which implement access() with
+         * the replacement policy inlined. Loads and stores through a
+         * Cache (or Cache::Ptr) cost one virtual call; through a
+         * PolicyCache they cost none.
+         */
         class Cache {
         public:
             static constexpr bool MISS = true;
@@ -43,16 +121,40 @@ namespace graph_tools {
             using Addr      = intptr_t;
             using Tag       = intptr_t;
 
+            struct Stats {
+                Stats(int64_t hits = 0, int64_t misses = 0, int64_t flushes = 0) :
+                    hits(hits), misses(misses), flushes(flushes) {}
+                int64_t hits;
+                int64_t misses;
+                int64_t flushes;
+            };
+
+            /**
+             * Result of one reference, for chaining caches: whether it hit
+             * and the block evicted to make room (victim == NONE if none).
+             */
+            struct Outcome {
+                bool hit;
+                Addr victim;
+                bool dirty;
+            };
+            enum : Addr { NONE = -1 };
+
             virtual ~Cache() {};
 
             Cache(Addr size, Addr block_size, Addr assoc = 2) :
                 _assoc(assoc),
                 _block_size(block_size),
-                _cold_misses(0) {
-
-                Addr sets = size/(_block_size * _assoc);
-                for (Addr i = 0; i < sets; i++)
-                    _sets.push_back(SetInternal(_assoc));
+                _sets(size/(block_size * assoc)),
+                _tags(_sets * _assoc, INVALID),
+                _dirty(_sets * _assoc, 0),
+                _block_shift(log2_exact(block_size)),
+                _set_shift(log2_exact(_sets)),
+                _hits(0),
+                _misses(0),
+                _flushes(0),
+                _cold_misses(0),
+                _track_blocks(false) {
             }
 
             Cache(const CacheBuilder & builder) :
@@ -60,28 +162,54 @@ namespace graph_tools {
             }
 
             /* primary api */
-            void load(Addr addr) { access(addr, false); }
+            void load(Addr addr) { access(addr, false, true); }
             void load_multi(Addr addr, Addr sz) {
-                while (sz > 0) {
-                    load(addr);
-                    auto ldsz = block_remainder_from_addr(addr);
-                    addr += ldsz;
-                    sz   -= ldsz;
-                }
+                for_each_block(addr, sz, [this](Addr a) { load(a); });
             }
 
-            void store(Addr addr) { access(addr, true); }
+            void store(Addr addr) { access(addr, true, true); }
             void store_multi(Addr addr, Addr sz) {
-                while (sz > 0) {
-                    store(addr);
-                    auto stsz = block_remainder_from_addr(addr);
-                    addr += stsz;
-                    sz   -= stsz;
-                }
+                for_each_block(addr, sz, [this](Addr a) { store(a); });
+            }
+
+            /**
+             * n back-to-back references to the block holding addr: one counted
+             * lookup, one uncounted re-hit, and the other n-1 counted as hits.
+             * The re-hit matters when the lookup missed: RRIP promotes a block
+             * only on a hit. Further hits to the block just touched leave
+             * every policy here unchanged, so one stands in for all n-1.
+             */
+            void load_repeat(Addr addr, int64_t n) { repeat(addr, false, n); }
+            void store_repeat(Addr addr, int64_t n) { repeat(addr, true, n); }
+
+            /* hierarchy api */
+            Outcome reference(Addr addr, bool store) { return access(addr, store, true); }
+
+            /* place a block without counting a hit or miss (writebacks, victim fills) */
+            Outcome install(Addr addr, bool dirty) { return access(addr, dirty, false); }
+
+            /* true if the block holding addr is cached; no stats or replacement update */
+            bool contains(Addr addr) const { return find(addr) >= 0; }
+
+            /* count a hit or miss without filling or updating replacement state */
+            bool probe(Addr addr) {
+                bool hit = find(addr) >= 0;
+                if (hit) record_hit(addr);
+                else     record_miss(addr);
+                return hit;
+            }
+
+            /* drop the block holding addr; -1 if absent, else its dirty bit */
+            int invalidate(Addr addr) {
+                intptr_t slot = find(addr);
+                if (slot < 0) return -1;
+                int dirty = _dirty[slot];
+                fill(slot, INVALID, false);
+                return dirty;
             }
 
             Addr size() const  { return sets() * assoc() * block_size(); }
-            Addr sets() const  { return _sets.size(); }
+            Addr sets() const  { return _sets; }
             Addr assoc() const { return _assoc; }
             Addr block_size() const { return _block_size; }
 
@@ -111,69 +239,51 @@ namespace graph_tools {
                 return ss.str();
             }
 
-        protected:
-
-            struct TagInfo {
-                TagInfo(Tag tag = 0, bool valid = false, bool dirty = false) :
-                    tag(tag), valid(valid), dirty(dirty) {}
-
-                Tag  tag;
-                bool valid;
-                bool dirty;
-            };
-
-            using SetInternal = std::vector<TagInfo>;
+            static int Test(int argc, char *argv[]);
 
-            /* policy subclassing api */
-            virtual Way  eject_one(Set set) = 0;
-            virtual void use(Set set, Way way) = 0;
+        protected:
+            /* implemented by PolicyCache; count is false for install() */
+            virtual Outcome access(Addr addr, bool store, bool count) = 0;
 
-            std::vector< SetInternal > _sets;
+            void repeat(Addr addr, bool store, int64_t n) {
+                if (n <= 0) return;
+                access(addr, store, true);
+                if (n == 1) return;
+                access(addr, store, false);
+                record_hit(addr, n-1);
+            }
 
-        private:
-            void access(Addr addr, bool store) {
+            /* slot holding addr, or -1 */
+            intptr_t find(Addr addr) const {
                 Tag tag = tag_from_addr(addr);
-                Set set_id = set_from_addr(addr);
+                size_t base = set_from_addr(addr) * _assoc;
+                for (Way way = 0; way < _assoc; way++)
+                    if (_tags[base+way] == tag) return base+way;
+                return -1;
+            }
 
-                // search for a hit
-                auto &set = _sets[set_id];
-                for (auto way = 0; way < assoc(); way++) {
-                    auto & tag_info = set[way];
-                    // hit
-                    if (tag == tag_info.tag &&
-                        tag_info.valid) {
-                        tag_info.dirty |= store;
-                        record_hit(addr);
-                        use(set_id, way);
-                        return;
-                    }
-                }
-                // miss
-                record_miss(addr);
-
-                // search for an invalid way
-                for (auto way = 0; way < assoc(); way++) {
-                    auto &tag_info = set[way];
-                    if (!tag_info.valid) {
-                        tag_info.valid = true;
-                        tag_info.tag = tag;
-                        tag_info.dirty = store;
-                        use(set_id, way);
-                        return;
-                    }
+            /* call f once per block overlapped by [addr, addr+sz) */
+            template <typename F>
+            void for_each_block(Addr addr, Addr sz, F f) const {
+                while (sz > 0) {
+                    f(addr);
+                    auto blksz = block_remainder_from_addr(addr);
+                    addr += blksz;
+                    sz   -= blksz;
                 }
+            }
 
-                // conflict miss; eject one
-                auto way = eject_one(set_id);
-                auto &tag_info = set[way];
-
-                if (tag_info.dirty) record_flush(addr_from_set_and_tag(set_id, tag_info.tag));
+            void fill(size_t slot, Tag tag, bool store) {
+                _tags[slot]  = tag;
+                _dirty[slot] = store;
+            }
 
-                tag_info.valid = true;
-                tag_info.tag = tag;
-                tag_info.dirty = store;
-                use(set_id, way);
-                return;
+            /* log2 of x if x is a power of two, else -1 */
+            static int log2_exact(Addr x) {
+                if (x <= 0 || (x & (x-1)) != 0) return -1;
+                int n = 0;
+                while ((Addr(1) << n) < x) n++;
+                return n;
             }
 
             /* compute the remaining bytes in block from address */
@@ -183,7 +293,7 @@ namespace graph_tools {
 
             /* compute offset in block from address */
             Addr block_offset_from_addr(Addr addr) const {
-                return addr % block_size();
+                return _block_shift >= 0 ? addr & (_block_size-1) : addr % block_size();
             }
 
             /* compute block address without block offset */
@@ -193,17 +303,19 @@ namespace graph_tools {
 
             /* compute tag data from addr */
             Tag tag_from_addr(Addr addr) const {
-                return (addr/block_size()) / sets();
+                Addr block = block_from_addr(addr);
+                return _set_shift >= 0 ? block >> _set_shift : block / sets();
             }
 
             /* compute set index from addr */
             Set set_from_addr(Addr addr) const {
-                return (addr/block_size()) % sets();
+                Addr block = block_from_addr(addr);
+                return _set_shift >= 0 ? block & (_sets-1) : block % sets();
             }
 
             /* compute the block id from the address */
             Addr block_from_addr(Addr addr) const {
-                return addr / block_size();
+                return _block_shift >= 0 ? addr >> _block_shift : addr / block_size();
             }
 
             /* compute the block id from the set and tag */
@@ -216,53 +328,92 @@ namespace graph_tools {
                 return block_from_set_and_tag(set, tag) * block_size();
             }
 
-        private:
             Addr _assoc;
             Addr _block_size;
+            Addr _sets;
 
-            struct Stats {
-                Stats(int64_t hits = 0, int64_t misses = 0, int64_t flushes = 0) :
-                    hits(hits), misses(misses), flushes(flushes) {}
-                int64_t hits;
-                int64_t misses;
-                int64_t flushes;
-            };
-
-            std::map<Addr, Stats> _stats;
-            int64_t _cold_misses;
+            // [set * assoc + way]; tags are never negative so INVALID marks an empty way
+            enum : Tag { INVALID = -1 };
+            std::vector<Tag>     _tags;
+            std::vector<uint8_t> _dirty;
 
-            Stats & find_stat(Addr addr) {
-                auto p = _stats.find(addr);
-                if (p != _stats.end()) {
-                    return p->second;
-                } else {
-                    _stats[addr] = Stats();
-                    return _stats[addr];
-                }
+            int _block_shift;
+            int _set_shift;
 
+            void record_hit(Addr addr, int64_t n = 1) {
+                _hits += n;
+                if (_track_blocks && n) _block_stats[block_from_addr(addr)].hits += n;
+                if (!_ranges.empty()) _regions[region_of(addr, addr)].hits += n;
             }
 
-            bool is_cold_miss(Addr addr) const {
-                auto p = _stats.find(block_from_addr(addr));
-                return p == _stats.end();
+            void record_miss(Addr addr) {
+                Addr block = block_from_addr(addr);
+                bool cold = _touched.insert(block);
+                _cold_misses += cold;
+                _misses++;
+                if (_track_blocks) _block_stats[block].misses++;
+                if (!_ranges.empty()) {
+                    RegionStats &r = _regions[region_of(addr, addr)];
+                    r.misses++;
+                    r.cold_misses += cold;
+                }
             }
 
-            void record_hit(Addr addr) {
-                auto &stat = find_stat(block_from_addr(addr));
-                stat.hits++;
+            /* victim is a block address */
+            void record_flush(Addr victim) {
+                _flushes++;
+                if (_track_blocks) _block_stats[block_from_addr(victim)].flushes++;
+                if (!_ranges.empty()) _regions[region_of(victim, victim + _block_size - 1)].flushes++;
             }
 
-            void record_miss(Addr addr) {
-                if (is_cold_miss(addr)) _cold_misses++;
-                auto &stat = find_stat(block_from_addr(addr));
-                stat.misses++;
+            /* a fill for addr evicted the block at victim */
+            void record_eviction(Addr victim, Addr addr) {
+                if (_ranges.empty()) return;
+                _regions[region_of(victim, victim + _block_size - 1)].evicted_by[region_of(addr, addr)]++;
             }
 
-            void record_flush(Addr addr) {
-                auto &stat = find_stat(block_from_addr(addr));
-                stat.flushes++;
+        private:
+            int64_t _hits;
+            int64_t _misses;
+            int64_t _flushes;
+            int64_t _cold_misses;
+            BlockSet _touched;
+
+            bool _track_blocks;
+            std::unordered_map<Addr, Stats> _block_stats;
+
+        public:
+            /* per-region stats; region 0 collects addresses outside every region */
+            struct RegionStats {
+                std::string name;
+                Addr begin;
+                Addr end;
+                int64_t hits;
+                int64_t misses;
+                int64_t cold_misses;
+                int64_t flushes;
+                std::vector<int64_t> evicted_by; // [region] evictions of this region's blocks by its fills
+            };
+
+        private:
+            struct Range {
+                Addr begin;
+                Addr end;
+                size_t region;
+                bool operator<(const Range &other) const { return begin < other.begin; }
+            };
+
+            /* region overlapping [lo, hi], or 0 */
+            size_t region_of(Addr lo, Addr hi) const {
+                auto it = std::upper_bound(_ranges.begin(), _ranges.end(), Range{hi, hi, 0});
+                if (it == _ranges.begin()) return 0;
+                --it;
+                return it->end > lo ? it->region : 0;
             }
 
+            std::vector<RegionStats> _regions;
+            std::vector<Range> _ranges; // sorted, disjoint
+
         public:
             /* stats api */
             int64_t compulsory_misses() const {
@@ -270,89 +421,387 @@ namespace graph_tools {
             }
 
             int64_t sum_hits(void) const {
-                int64_t sum = 0;
-                for (auto &p : _stats)
-                    sum += p.second.hits;
-
-                return sum;
+                return _hits;
             }
 
             int64_t sum_misses(void) const {
-                int64_t sum = 0;
-                for (auto &p : _stats)
-                    sum += p.second.misses;
-                return sum;
+                return _misses;
             }
 
             int64_t sum_flushes(void) const {
-                int64_t sum = 0;
-                for (auto &p : _stats)
-                    sum += p.second.flushes;
-                return sum;
+                return _flushes;
+            }
+
+            /* per-block stats; off by default since they cost a hash lookup per access */
+            void track_blocks(bool on = true) { _track_blocks = on; }
+            bool tracking_blocks() const { return _track_blocks; }
+
+            Stats block_stats(Addr addr) const {
+                auto p = _block_stats.find(block_from_addr(addr));
+                return p == _block_stats.end() ? Stats() : p->second;
+            }
+
+            /**
+             * Attribute hits, misses, cold misses, flushes and evictions in
+             * [begin, end) to name, e.g. one array of a graph. Setting a name
+             * again moves its range (after a reallocation) and keeps its
+             * stats; a range replaces any other range it overlaps.
+             */
+            void set_region(const std::string &name, Addr begin, Addr end) {
+                if (end < begin)
+                    throw std::invalid_argument("Cache: region '" + name + "' ends before it begins");
+                if (_regions.empty()) new_region("other");
+                size_t id = 0;
+                for (size_t r = 1; r < _regions.size(); r++)
+                    if (_regions[r].name == name) id = r;
+                if (id == 0) id = new_region(name);
+
+                _ranges.erase(std::remove_if(_ranges.begin(), _ranges.end(), [=](const Range &g) {
+                            return g.region == id || (g.begin < end && begin < g.end);
+                        }), _ranges.end());
+                if (begin < end) {
+                    _ranges.push_back({begin, end, id});
+                    std::sort(_ranges.begin(), _ranges.end());
+                }
+                _regions[id].begin = begin;
+                _regions[id].end = end;
+            }
+
+            const std::vector<RegionStats> & region_stats() const { return _regions; }
+
+            std::string region_stats_csv_header() const {
+                return "region,begin,end,hits,misses,cold_misses,flushes,evictions";
+            }
+
+            std::string region_stats_csv() const {
+                std::stringstream ss;
+                for (const RegionStats &r : _regions) {
+                    int64_t evictions = 0;
+                    for (int64_t e : r.evicted_by) evictions += e;
+                    ss << r.name << "," << r.begin << "," << r.end << ",";
+                    ss << r.hits << "," << r.misses << "," << r.cold_misses << ",";
+                    ss << r.flushes << "," << evictions << "\n";
+                }
+                return ss.str();
+            }
+
+            /* one row per (victim region, evicting region) pair that occurred */
+            std::string region_evictions_csv() const {
+                std::stringstream ss;
+                ss << "victim,cause,evictions\n";
+                for (const RegionStats &r : _regions)
+                    for (size_t c = 0; c < r.evicted_by.size(); c++)
+                        if (r.evicted_by[c])
+                            ss << r.name << "," << _regions[c].name << "," << r.evicted_by[c] << "\n";
+                return ss.str();
+            }
+
+            std::string region_stats_json() const {
+                std::stringstream ss;
+                ss << "[";
+                for (size_t i = 0; i < _regions.size(); i++) {
+                    const RegionStats &r = _regions[i];
+                    ss << (i ? ",\n " : "\n ") << "{\"region\": \"" << r.name << "\", ";
+                    ss << "\"begin\": " << r.begin << ", \"end\": " << r.end << ", ";
+                    ss << "\"hits\": " << r.hits << ", \"misses\": " << r.misses << ", ";
+                    ss << "\"cold_misses\": " << r.cold_misses << ", \"flushes\": " << r.flushes << ", ";
+                    ss << "\"evicted_by\": {";
+                    bool first = true;
+                    for (size_t c = 0; c < r.evicted_by.size(); c++) {
+                        if (!r.evicted_by[c]) continue;
+                        ss << (first ? "" : ", ") << "\"" << _regions[c].name << "\": " << r.evicted_by[c];
+                        first = false;
+                    }
+                    ss << "}}";
+                }
+                ss << "\n]\n";
+                return ss.str();
             }
 
+        private:
+            size_t new_region(const std::string &name) {
+                _regions.push_back({name, 0, 0, 0, 0, 0, 0, {}});
+                for (RegionStats &r : _regions) r.evicted_by.resize(_regions.size(), 0);
+                return _regions.size() - 1;
+            }
         };
 
-        class LMRUCacheBase : public Cache {
+        /**
+         * Cache with its replacement policy fixed at compile time.
+         * A Policy is constructed with (sets, assoc) and provides
+         *   void hit(Set, Way)     - way was hit
+         *   void insert(Set, Way)  - way was filled on a miss
+         *   Way  victim(Set)       - way to evict from a full set
+         */
+        template <typename Policy>
+        class PolicyCache final : public Cache {
         public:
-            LMRUCacheBase(Addr size, Addr block_size, Addr assoc = 2) :
+            PolicyCache() : PolicyCache(1,1,1) {}
+            PolicyCache(Addr size, Addr block_size, Addr assoc = 2) :
                 Cache(size, block_size, assoc),
-                _used(sets()) {
+                _policy(sets(), assoc) {}
+            PolicyCache(const CacheBuilder & builder) :
+                PolicyCache(builder.size(), builder.block_size(), builder.assoc()) {
             }
 
-            LMRUCacheBase(const CacheBuilder & builder) :
-                LMRUCacheBase(builder.size(), builder.block_size(), builder.assoc()) {
+            /* primary api; hides Cache's so direct users skip the virtual call */
+            void load(Addr addr) { lookup(addr, false, true); }
+            void load_multi(Addr addr, Addr sz) {
+                for_each_block(addr, sz, [this](Addr a) { lookup(a, false, true); });
             }
 
-            void use(Set set, Way way) override {
-                auto & tgt_set = _used[set];
-                tgt_set.remove(way);
-                // mru -> lru
-                tgt_set.push_front(way);
-            };
+            void store(Addr addr) { lookup(addr, true, true); }
+            void store_multi(Addr addr, Addr sz) {
+                for_each_block(addr, sz, [this](Addr a) { lookup(a, true, true); });
+            }
+
+            void load_repeat(Addr addr, int64_t n) { repeat(addr, false, n); }
+            void store_repeat(Addr addr, int64_t n) { repeat(addr, true, n); }
+
+            Policy & policy() { return _policy; }
 
         protected:
-            using UsedInternal = std::list<Way>;
-            std::vector<UsedInternal> _used;
+            Outcome access(Addr addr, bool store, bool count) override {
+                return lookup(addr, store, count);
+            }
+
+        private:
+            void repeat(Addr addr, bool store, int64_t n) {
+                if (n <= 0) return;
+                lookup(addr, store, true);
+                if (n == 1) return;
+                lookup(addr, store, false);
+                record_hit(addr, n-1);
+            }
+
+            inline Outcome lookup(Addr addr, bool store, bool count) {
+                Tag tag = tag_from_addr(addr);
+                Set set_id = set_from_addr(addr);
+                size_t base = set_id * _assoc;
+
+                // search for a hit, noting the first invalid way
+                const Tag *tags = &_tags[base];
+                Way empty = -1;
+                for (Way way = 0; way < _assoc; way++) {
+                    if (tags[way] == tag) {
+                        _dirty[base+way] |= store;
+                        if (count) record_hit(addr);
+                        _policy.hit(set_id, way);
+                        return {true, NONE, false};
+                    }
+                    if (tags[way] == INVALID && empty < 0) empty = way;
+                }
+                // miss
+                if (count) record_miss(addr);
+
+                if (empty >= 0) {
+                    fill(base+empty, tag, store);
+                    _policy.insert(set_id, empty);
+                    return {false, NONE, false};
+                }
+
+                // conflict miss; eject one
+                Way way = _policy.victim(set_id);
+                Outcome out = {false, addr_from_set_and_tag(set_id, _tags[base+way]), _dirty[base+way] != 0};
+                if (out.dirty) record_flush(out.victim);
+                record_eviction(out.victim, addr);
+
+                fill(base+way, tag, store);
+                _policy.insert(set_id, way);
+                return out;
+            }
+
+            Policy _policy;
         };
 
-        class MRUCache final : public LMRUCacheBase {
+        /* Replacement policies */
+
+        /* per-way timestamps; base for the recency and insertion-order policies */
+        class StampPolicyBase {
         public:
-            MRUCache() : MRUCache(1,1,1) {}
-            MRUCache(Addr size, Addr block_size, Addr assoc = 2) :
-                LMRUCacheBase(size, block_size, assoc) {}
-            MRUCache(const CacheBuilder & builder) :
-                MRUCache(builder.size(), builder.block_size(), builder.assoc()) {
-            }
+            using Set = Cache::Set;
+            using Way = Cache::Way;
+
+            StampPolicyBase(Set sets, Way assoc) :
+                _assoc(assoc), _clock(0), _stamp(sets * assoc, 0) {}
 
         protected:
-            Way eject_one(Set set) override {
-                auto & tgt_set = _used[set];
-                // mru is in the front
-                auto r = tgt_set.front();
-                tgt_set.pop_front();
+            void stamp(Set set, Way way) { _stamp[set * _assoc + way] = ++_clock; }
+
+            /* way with the smallest (oldest) stamp */
+            Way oldest(Set set) const {
+                const uint64_t *stamp = &_stamp[set * _assoc];
+                Way r = 0;
+                for (Way way = 1; way < _assoc; way++)
+                    if (stamp[way] < stamp[r]) r = way;
+                return r;
+            }
+
+            /* way with the largest (newest) stamp */
+            Way newest(Set set) const {
+                const uint64_t *stamp = &_stamp[set * _assoc];
+                Way r = 0;
+                for (Way way = 1; way < _assoc; way++)
+                    if (stamp[way] > stamp[r]) r = way;
                 return r;
             }
+
+            Way _assoc;
+            uint64_t _clock;
+            std::vector<uint64_t> _stamp;
+        };
+
+        /* evict the least recently used way */
+        class LRUPolicy : public StampPolicyBase {
+        public:
+            using StampPolicyBase::StampPolicyBase;
+            void hit(Set set, Way way)    { stamp(set, way); }
+            void insert(Set set, Way way) { stamp(set, way); }
+            Way  victim(Set set) const    { return oldest(set); }
+        };
+
+        /* evict the most recently used way */
+        class MRUPolicy : public StampPolicyBase {
+        public:
+            using StampPolicyBase::StampPolicyBase;
+            void hit(Set set, Way way)    { stamp(set, way); }
+            void insert(Set set, Way way) { stamp(set, way); }
+            Way  victim(Set set) const    { return newest(set); }
+        };
+
+        /* evict the way filled longest ago; hits don't matter */
+        class FIFOPolicy : public StampPolicyBase {
+        public:
+            using StampPolicyBase::StampPolicyBase;
+            void hit(Set set, Way way)    {}
+            void insert(Set set, Way way) { stamp(set, way); }
+            Way  victim(Set set) const    { return oldest(set); }
+        };
+
+        /**
+         * Tree pseudo-LRU: assoc-1 direction bits per set (assoc must be
+         * a power of two no larger than 64); each bit points toward the
+         * half that was used less recently.
+         */
+        class TreePLRUPolicy {
+        public:
+            using Set = Cache::Set;
+            using Way = Cache::Way;
+
+            TreePLRUPolicy(Set sets, Way assoc) :
+                _assoc(assoc), _bits(sets, 0) {
+                if (assoc <= 0 || assoc > 64 || (assoc & (assoc-1)) != 0)
+                    throw std::invalid_argument("TreePLRUPolicy: assoc must be a power of two <= 64");
+            }
+
+            void hit(Set set, Way way)    { touch(set, way); }
+            void insert(Set set, Way way) { touch(set, way); }
+
+            Way victim(Set set) const {
+                uint64_t bits = _bits[set];
+                Way node = 0, lo = 0, span = _assoc;
+                while (span > 1) {
+                    span /= 2;
+                    bool right = (bits >> node) & 1;
+                    if (right) lo += span;
+                    node = 2*node + 1 + right;
+                }
+                return lo;
+            }
+
+        private:
+            void touch(Set set, Way way) {
+                uint64_t &bits = _bits[set];
+                Way node = 0, lo = 0, span = _assoc;
+                while (span > 1) {
+                    span /= 2;
+                    bool right = way >= lo + span;
+                    // point away from the half just used
+                    if (right) bits &= ~(uint64_t(1) << node);
+                    else       bits |=  (uint64_t(1) << node);
+                    if (right) lo += span;
+                    node = 2*node + 1 + right;
+                }
+            }
+
+            Way _assoc;
+            std::vector<uint64_t> _bits;
         };
 
-        class LRUCache final : public LMRUCacheBase {
+        /**
+         * Re-reference interval prediction with 2-bit RRPVs (Jaleel et al.).
+         * Static RRIP inserts at "long"; bimodal RRIP inserts at "distant"
+         * except for one fill in every 32.
+         */
+        template <bool Bimodal>
+        class RRIPPolicy {
         public:
-            LRUCache() : LRUCache(1,1,1) {}
-            LRUCache(Addr size, Addr block_size, Addr assoc = 2) :
-                LMRUCacheBase(size, block_size, assoc) {}
-            LRUCache(const CacheBuilder & builder) :
-                LRUCache(builder.size(), builder.block_size(), builder.assoc()) {
+            using Set = Cache::Set;
+            using Way = Cache::Way;
+            enum : uint8_t { LONG = 2, DISTANT = 3 };
+
+            RRIPPolicy(Set sets, Way assoc) :
+                _assoc(assoc), _fills(0), _rrpv(sets * assoc, uint8_t(DISTANT)) {}
+
+            void hit(Set set, Way way) { _rrpv[set * _assoc + way] = 0; }
+
+            void insert(Set set, Way way) {
+                bool distant = Bimodal && (++_fills % 32 != 0);
+                _rrpv[set * _assoc + way] = distant ? DISTANT : LONG;
             }
-        protected:
-            Way eject_one(Set set) override {
-                auto & tgt_set = _used[set];
-                // lru is in the back
-                auto r = tgt_set.back();
-                tgt_set.pop_back();
-                return r;
+
+            Way victim(Set set) {
+                uint8_t *rrpv = &_rrpv[set * _assoc];
+                for (;;) {
+                    for (Way way = 0; way < _assoc; way++)
+                        if (rrpv[way] == DISTANT) return way;
+                    for (Way way = 0; way < _assoc; way++)
+                        rrpv[way]++;
+                }
+            }
+
+        private:
+            Way _assoc;
+            uint64_t _fills;
+            std::vector<uint8_t> _rrpv;
+        };
+
+        using SRRIPPolicy = RRIPPolicy<false>;
+        using BRRIPPolicy = RRIPPolicy<true>;
+
+        /* evict a pseudo-random way; seeded so runs are repeatable */
+        class RandomPolicy {
+        public:
+            using Set = Cache::Set;
+            using Way = Cache::Way;
+
+            RandomPolicy(Set sets, Way assoc, uint64_t seed = 0x2545F4914F6CDD1Dull) :
+                _assoc(assoc), _state(seed) {}
+
+            void hit(Set set, Way way)    {}
+            void insert(Set set, Way way) {}
+
+            Way victim(Set set) {
+                // xorshift64
+                _state ^= _state << 13;
+                _state ^= _state >> 7;
+                _state ^= _state << 17;
+                return _state % _assoc;
             }
+
+        private:
+            Way _assoc;
+            uint64_t _state;
         };
 
+        using LRUCache       = PolicyCache<LRUPolicy>;
+        using MRUCache       = PolicyCache<MRUPolicy>;
+        using FIFOCache      = PolicyCache<FIFOPolicy>;
+        using TreePLRUCache  = PolicyCache<TreePLRUPolicy>;
+        using SRRIPCache     = PolicyCache<SRRIPPolicy>;
+        using BRRIPCache     = PolicyCache<BRRIPPolicy>;
+        using RandomCache    = PolicyCache<RandomPolicy>;
+
         static Cache::Ptr HammerBladeCache() {
             int x = 16;
             int y = 8;
@@ -376,5 +825,141 @@ namespace graph_tools {
                                               block_size,
                                               ways);
         }
+    
+        /* a Cache as a MemoryPort, for sinks that take any model */
+        class CachePort final : public MemoryPort {
+        public:
+            CachePort(const Cache::Ptr &cache) : _cache(cache) {}
+            void load_multi(Addr addr, Addr sz) override { _cache->load_multi(addr, sz); }
+            void store_multi(Addr addr, Addr sz) override { _cache->store_multi(addr, sz); }
+            void load_repeat(Addr addr, Addr n) override { _cache->load_repeat(addr, n); }
+            void store_repeat(Addr addr, Addr n) override { _cache->store_repeat(addr, n); }
+            Addr block_size() const override { return _cache->block_size(); }
+            void set_region(const std::string &name, Addr begin, Addr end) override {
+                _cache->set_region(name, begin, end);
+            }
+            Cache::Ptr cache() const { return _cache; }
+        private:
+            Cache::Ptr _cache;
+        };
+
+        /* run blocks (in units of block_size) through cache in order */
+        template <typename C>
+        static C & Replay(C &cache, const std::vector<Cache::Addr> &blocks, bool store = false) {
+            for (Cache::Addr b : blocks) {
+                if (store) cache.store(b * cache.block_size());
+                else       cache.load (b * cache.block_size());
+            }
+            return cache;
+        }
+
+        inline int Cache::Test(int argc, char *argv[]) {
+            // A single 4-way set
+            Addr size = 4*32, block = 32, ways = 4;
+
+            // Cycling over assoc+1 blocks
+            {
+                std::vector<Addr> cycle;
+                for (int i = 0; i < 10; i++)
+                    for (Addr b = 0; b < 5; b++) cycle.push_back(b);
+
+                LRUCache lru(size, block, ways);
+                MRUCache mru(size, block, ways);
+                FIFOCache fifo(size, block, ways);
+                TreePLRUCache plru(size, block, ways);
+                Replay(lru, cycle); Replay(mru, cycle); Replay(fifo, cycle); Replay(plru, cycle);
+
+                // lru and fifo thrash, mru keeps most of the loop resident
+                assert(lru.sum_hits() == 0);
+                assert(fifo.sum_hits() == 0);
+                assert(mru.sum_hits() > 0);
+                assert(plru.sum_hits() + plru.sum_misses() == 50);
+                assert(lru.compulsory_misses() == 5 && mru.compulsory_misses() == 5);
+            }
+            // A hot pair survives a scan under rrip but not lru
+            {
+                std::vector<Addr> pattern;
+                for (int i = 0; i < 4; i++) { pattern.push_back(100); pattern.push_back(101); }
+                for (Addr b = 0; b < 4; b++) pattern.push_back(b);
+                pattern.push_back(100); pattern.push_back(101);
+
+                LRUCache lru(size, block, ways);
+                SRRIPCache srrip(size, block, ways);
+                BRRIPCache brrip(size, block, ways);
+                Replay(lru, pattern); Replay(srrip, pattern); Replay(brrip, pattern);
+
+                assert(lru.sum_hits() == 6);
+                assert(srrip.sum_hits() == 8);
+                assert(brrip.sum_hits() == 8);
+            }
+            // Repeated references promote like element-wise ones under rrip,
+            // both direct and behind the type-erased pointer
+            {
+                // the twice-referenced block 0 must outlive 1 when 2 comes in
+                std::vector<std::pair<Addr, int64_t>> cycle = {{0, 2}, {1, 1}, {2, 1}, {0, 1}, {3, 3}}, runs;
+                for (int i = 0; i < 4; i++) runs.insert(runs.end(), cycle.begin(), cycle.end());
+                SRRIPCache element(2*block, block, 2), bulk(2*block, block, 2);
+                Cache::Ptr erased = std::make_shared<SRRIPCache>(2*block, block, 2);
+                for (auto &r : runs) {
+                    for (int64_t k = 0; k < r.second; k++) element.load(r.first * block);
+                    bulk.load_repeat(r.first * block, r.second);
+                    erased->load_repeat(r.first * block, r.second);
+                }
+                assert(element.stats_csv() == bulk.stats_csv());
+                assert(element.stats_csv() == erased->stats_csv());
+            }
+            // Random replacement is repeatable
+            {
+                std::vector<Addr> blocks;
+                for (Addr i = 0; i < 1000; i++) blocks.push_back((i * 7919) % 13);
+                RandomCache a(size, block, ways), b(size, block, ways);
+                Replay(a, blocks, true); Replay(b, blocks, true);
+                assert(a.stats_csv() == b.stats_csv());
+                assert(a.sum_flushes() > 0);
+            }
+            // Policies behind the type-erased pointer
+            {
+                Cache::Ptr p = std::make_shared<TreePLRUCache>(size, block, ways);
+                p->load_multi(0, 3*block);
+                p->load(0);
+                assert(p->sum_misses() == 3 && p->sum_hits() == 1);
+            }
+            // Tree plru needs a power-of-two associativity
+            {
+                bool thrown = false;
+                try { TreePLRUCache bad(3*32, 32, 3); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+            }
+            // Misses, flushes and evictions are attributed to regions
+            {
+                LRUCache lru(size, block, ways);
+                lru.set_region("hot", 0, 2*block);
+                lru.set_region("stream", 1024, 1024 + 8*block);
+                lru.load(0); lru.load(block);
+                for (Addr b = 0; b < 8; b++) lru.store(1024 + b*block); // evicts hot, then itself
+                lru.load(0); lru.load(block);                           // evict stream 4, 5
+                lru.load(4096);                                         // outside every region
+
+                auto &r = lru.region_stats();
+                assert(r.size() == 3 && r[0].name == "other" && r[1].name == "hot" && r[2].name == "stream");
+                assert(r[1].misses == 4 && r[1].cold_misses == 2 && r[1].flushes == 0);
+                assert(r[1].evicted_by[2] == 2);
+                assert(r[2].misses == 8 && r[2].cold_misses == 8 && r[2].flushes == 7);
+                assert(r[2].evicted_by[2] == 4 && r[2].evicted_by[1] == 2 && r[2].evicted_by[0] == 1);
+                assert(r[0].misses == 1);
+                int64_t hits = 0, misses = 0, flushes = 0;
+                for (auto &g : r) { hits += g.hits; misses += g.misses; flushes += g.flushes; }
+                assert(hits == lru.sum_hits() && misses == lru.sum_misses() && flushes == lru.sum_flushes());
+
+                // moving a region keeps its stats
+                lru.set_region("hot", 8192, 8192 + 2*block);
+                lru.load(0);    // still cached, now outside every region
+                lru.load(8192);
+                assert(r[0].hits == 1 && r[1].hits == 0 && r[1].misses == 5);
+                std::cout << lru.region_stats_csv_header() << "\n" << lru.region_stats_csv()
+                          << lru.region_evictions_csv() << lru.region_stats_json();
+            }
+            return 0;
+        }
     }
 }
@@ -1,41 +1,60 @@
 #pragma once
 #include <WGraph.hpp>
+#include <PullRelaxation.hpp>
+#include <VertexArray.hpp>
+#include <Instrumentation.hpp>
+#include <PerfCounters.hpp>
 #include <queue>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <limits.h>
+#include <cassert>
+#include <thread>
+#include <chrono>
+#include <type_traits>
 
-class Dijkstra {
+/**
+ * G is the weighted graph type, WGraph or any graph with the same
+ * wedges() view (e.g. InterleavedWGraph, InstrumentedWGraph).
+ * Per-vertex state lives in VertexArray<G, T> storage; I is the
+ * instrumentation policy, with one round per sweep; each sweep is
+ * also a "dijkstra sweep[i]" PerfScope.
+ */
+template <typename G, typename I = graph_tools::Counters>
+class BasicDijkstra {
 public:
     using WGraph = graph_tools::WGraph;
-    Dijkstra(const WGraph &wg, int root) :
-        _wg(wg.transpose()),
+    using Stat = graph_tools::Stat;
+    template <typename T>
+    using Array = typename graph_tools::VertexArray<G, T>::type;
+
+    BasicDijkstra(const typename G::Ptr &wg, int root) :
+        BasicDijkstra(*wg, root) {}
+
+    BasicDijkstra(const G &wg, int root) :
+        _wg(wg.transposed()),
         _root(root),
         _goal(-1),
-        _traversed_edges(0),
-        _fp_compares(0),
-        _fp_adds(0) {}
+        _transient(0) {}
 
 
     std::pair<std::vector<int>, std::vector<float>>
     run() {
-        _distance.clear();
-        _path.clear();
-        
-        _distance.resize(_wg.num_nodes(), INFINITY);
-        _path.resize(_wg.num_nodes(),-1);       
+        _distance = make_array<float>(INFINITY);
+        _path = make_array<int>(-1);
         
         _distance[_root] = 0.0;
         _path[_root] = _root;
 
         bool converged = false;
-        while (!converged) {
+        for (int sweep = 0; !converged; sweep++) {
+            graph_tools::PerfScope scope("dijkstra sweep", sweep);
             converged = true;
-            for (int dst = 0; dst < _wg.num_nodes(); dst++) {
-                for (auto warc : _wg.wneighbors(dst)) {
-                    int src = warc.first;
-                    float w = warc.second;
+            for (int dst = 0; dst < _wg->num_nodes(); dst++) {
+                for (graph_tools::WEdge e : _wg->wedges(dst)) {
+                    int src = e.dst;
+                    float w = e.weight;
 #ifdef DEBUG_DIJKSTRA_HOST
                     printf("walking src=%d,dst=%d,w=%f\n",src,dst,w);
                     printf("distance[%d](%f)+%f < distance[%d](%f) ? %d\n",
@@ -49,23 +68,60 @@ public:
                         converged = false;
                     }
                     // increment count
-                    _fp_compares++;
-                    _fp_adds++;
-                    _traversed_edges++;
+                    _instr.add(Stat::FP_COMPARES);
+                    _instr.add(Stat::FP_ADDS);
+                    _instr.add(Stat::TRAVERSED_EDGES);
                 }
             }
+            _instr.next_round();
         }
         
         return {_path, _distance};
     }
 
+    /**
+     * Same fixed point as run(), but each sweep reads the previous sweep's
+     * distances so destinations can be relaxed in parallel and with SIMD.
+     * The kernels read WGraph's CSR arrays directly, so this is only
+     * available for G = WGraph; its threads are started once per call.
+     */
+    std::pair<std::vector<int>, std::vector<float>>
+    run_parallel(int threads = std::thread::hardware_concurrency(),
+                 graph_tools::PullRelaxation::ISA isa = graph_tools::PullRelaxation::Detect()) {
+        static_assert(std::is_same<G, WGraph>::value,
+                      "run_parallel relaxes WGraph's CSR arrays; use run() for other graph types");
+        _distance = make_array<float>(INFINITY);
+        _path = make_array<int>(-1);
+
+        _distance[_root] = 0.0;
+        _path[_root] = _root;
+
+        graph_tools::PullRelaxation kernel(*_wg, threads, isa);
+        std::vector<float> next(_distance);
+        _transient = graph_tools::MemoryFootprint::Bytes(next);
+
+        bool converged = false;
+        for (int sweep = 0; !converged; sweep++) {
+            graph_tools::PerfScope scope("dijkstra parallel sweep", sweep);
+            converged = !kernel.sweep(_distance, next, _path);
+            std::swap(_distance, next);
+            // increment count
+            _instr.add(Stat::FP_COMPARES, _wg->num_edges());
+            _instr.add(Stat::FP_ADDS, _wg->num_edges());
+            _instr.add(Stat::TRAVERSED_EDGES, _wg->num_edges());
+            _instr.next_round();
+        }
+
+        return {_path, _distance};
+    }
+
     int goal(float max_distance = INFINITY) {
         if (_goal != -1) {
             return _goal;
         } else {
             // find the maximum distance under threshold
             int maxv = _root;
-            for (int v = 0; v < _wg.num_nodes(); v++) {
+            for (int v = 0; v < _wg->num_nodes(); v++) {
                 if ((_distance[v] > _distance[maxv])
                     && !std::isinf(_distance[v])
                     && _distance[v] <= max_distance) {
@@ -80,10 +136,20 @@ public:
             return _goal;
         }
     }
-    std::vector<float> & distance() { return _distance; }
-    std::vector<int>   & path() { return _path; }
+    Array<float> & distance() { return _distance; }
+    Array<int>   & path() { return _path; }
     std::vector<float> distance() const { return _distance; }
     std::vector<int>   path() const { return _path; }
+    const I & instrumentation() const { return _instr; }
+
+    /* bytes this search owns; the graph is shared and reports its own */
+    graph_tools::MemoryFootprint footprint() const {
+        graph_tools::MemoryFootprint f;
+        f.add("distance", graph_tools::VertexArray<G, float>::Bytes(_distance));
+        f.add("path", graph_tools::VertexArray<G, int>::Bytes(_path));
+        f.add_transient("next distance", _transient);
+        return f;
+    }
         
     void stats(const std::string &fname) const {
         std::ofstream of(fname);
@@ -92,35 +158,106 @@ public:
 
     std::string stats_str() const {
         std::stringstream ss;
-        ss << "nodes:                 " << _wg.num_nodes() << "\n";
-        ss << "edges:                 " << _wg.num_edges() << "\n";
+        ss << "nodes:                 " << _wg->num_nodes() << "\n";
+        ss << "edges:                 " << _wg->num_edges() << "\n";
         ss << "root:                  " << _root << "\n";
         ss << "goal:                  " << _goal << "\n";
-        ss << "traversed edges:       " << _traversed_edges << "\n";
-        ss << "fp compares:           " << _fp_compares << "\n";
-        ss << "fp adds:               " << _fp_adds << "\n";
-        ss << "fp total:              " << _fp_compares+_fp_adds << "\n";
-        ss << "fp total analytical:   " << 2 * (_wg.num_nodes()-1) * _wg.num_edges() << "\n";
+        ss << _instr.stats_str({Stat::TRAVERSED_EDGES, Stat::FP_COMPARES, Stat::FP_ADDS});
+        if (I::ENABLED)
+            ss << "fp total:              " << _instr.get(Stat::FP_COMPARES) + _instr.get(Stat::FP_ADDS) << "\n";
+        ss << "fp total analytical:   " << 2 * (_wg->num_nodes()-1) * _wg->num_edges() << "\n";
         ss << "distance (root->goal): " << _distance[_goal] << "\n";
         return ss.str();
     }
 
     static int Test(int argc, char *argv[]) {
-        auto wg = WGraph::Uniform(10*1000, 32*1000);
-        Dijkstra dijkstra(wg, 0);
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+        BasicDijkstra<WGraph> dijkstra(wg, 0);
         dijkstra.run();
         dijkstra.goal(3.0);
         std::cout << "stats:" << std::endl;
         std::cout << dijkstra.stats_str() << std::endl;
+
+        using ISA = graph_tools::PullRelaxation::ISA;
+        std::vector<ISA> isas = {ISA::SCALAR};
+        if (graph_tools::PullRelaxation::Detect() != ISA::SCALAR) isas.push_back(ISA::AVX2);
+        if (graph_tools::PullRelaxation::Detect() == ISA::AVX512) isas.push_back(ISA::AVX512);
+
+        std::vector<float> reference;
+        for (ISA isa : isas) {
+            BasicDijkstra<WGraph> pdijkstra(wg, 0);
+            pdijkstra.run_parallel(4, isa);
+            std::cout << "parallel " << graph_tools::PullRelaxation::ISAName(isa) << " stats:" << std::endl;
+            pdijkstra.goal(3.0);
+            std::cout << pdijkstra.stats_str() << std::endl;
+            for (WGraph::NodeID v = 0; v < wg->num_nodes(); v++) {
+                float d = dijkstra.distance()[v], p = pdijkstra.distance()[v];
+                assert(std::isinf(d) == std::isinf(p));
+                assert(std::isinf(d) || std::fabs(d - p) < 1e-4);
+            }
+            // every kernel computes the same sweeps bit-for-bit
+            if (reference.empty()) reference = pdijkstra.distance();
+            assert(reference == pdijkstra.distance());
+        }
+        // one thread sweeps alone, with no workers to hand off to
+        BasicDijkstra<WGraph> sdijkstra(wg, 0);
+        sdijkstra.run_parallel(1);
+        assert(sdijkstra.distance() == reference);
+
+        // Instrumentation policies change what is counted, not what is computed
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+        BasicDijkstra<WGraph, graph_tools::NoInstrumentation> ndijkstra(wg, 0);
+        ndijkstra.run();
+        auto t1 = clock::now();
+        BasicDijkstra<WGraph, graph_tools::PerIteration> idijkstra(wg, 0);
+        idijkstra.run();
+        auto t2 = clock::now();
+        assert(ndijkstra.distance() == dijkstra.distance());
+        assert(idijkstra.distance() == dijkstra.distance());
+        assert(ndijkstra.instrumentation().get(Stat::TRAVERSED_EDGES) == 0);
+
+        const graph_tools::PerIteration &rounds = idijkstra.instrumentation();
+        int64_t sum = 0;
+        for (size_t r = 0; r < rounds.rounds(); r++) {
+            assert(rounds.get(Stat::TRAVERSED_EDGES, r) == wg->num_edges());
+            sum += rounds.get(Stat::TRAVERSED_EDGES, r);
+        }
+        assert(sum == rounds.get(Stat::TRAVERSED_EDGES));
+        for (Stat s : {Stat::TRAVERSED_EDGES, Stat::FP_COMPARES, Stat::FP_ADDS})
+            assert(rounds.get(s) == dijkstra.instrumentation().get(s));
+        std::cout << "uninstrumented: " << std::chrono::duration<double>(t1 - t0).count() << "s, "
+                  << "per iteration: " << std::chrono::duration<double>(t2 - t1).count() << "s, "
+                  << rounds.rounds() << " sweeps" << std::endl;
+
+        // Counts past 2^31 don't wrap
+        graph_tools::Counters big;
+        big.add(Stat::FP_ADDS, 3000000000LL);
+        big.merge(big);
+        assert(big.get(Stat::FP_ADDS) == 6000000000LL);
+
+        // A roll-up of the graph and the search over it
+        graph_tools::MemoryFootprint footprint;
+        footprint.add("graph", wg->footprint());
+        footprint.add("dijkstra", dijkstra.footprint());
+        assert(footprint.owned() == wg->footprint().owned() + dijkstra.footprint().owned());
+        assert(dijkstra.footprint().owned() >= wg->num_nodes() * static_cast<int64_t>(sizeof(float) + sizeof(int)));
+        std::cout << footprint.stats_str();
         return 0;
     }
 private:
-    WGraph _wg;
+    template <typename T>
+    Array<T> make_array(T init) const {
+        return graph_tools::VertexArray<G, T>::Make(*_wg, _wg->num_nodes(), init);
+    }
+
+    typename G::Ptr _wg; // transpose of the input graph
     int    _root;
     int    _goal;
-    int    _traversed_edges;
-    float  _fp_compares;
-    float  _fp_adds;
-    std::vector<float> _distance;
-    std::vector<int>   _path;
+    int64_t _transient; // run_parallel's second distance array
+    I      _instr;
+    Array<float> _distance;
+    Array<int>   _path;
 };
+
+using Dijkstra = BasicDijkstra<graph_tools::WGraph>;
@@ -5,37 +5,42 @@
 #include <string>
 #include <iostream>
 #include <Dijkstra.hpp>
+#include <Instrumentation.hpp>
 
-class FullWorldDijkstra {
+template <typename G, typename I = graph_tools::Counters>
+class BasicFullWorldDijkstra {
 public:
     using WGraph = graph_tools::WGraph;
-    FullWorldDijkstra(const WGraph &wg, int root, int goal) :
+    using Stat = graph_tools::Stat;
+    template <typename T>
+    using Array = typename graph_tools::VertexArray<G, T>::type;
+
+    BasicFullWorldDijkstra(const G &wg, int root, int goal) :
+        BasicFullWorldDijkstra(std::make_shared<const G>(wg), root, goal) {}
+
+    BasicFullWorldDijkstra(const typename G::Ptr &wg, int root, int goal) :
         _wg(wg),
         _root(root),
         _goal(goal),
-        _traversed_edges(0),
-        _fp_compares(0),
-        _fp_adds(0) {}
+        _transient(0) {}
 
 
     std::pair<std::vector<int>, std::vector<float>>
     run() {
-        _distance.clear();
-        _path.clear();
-        _teps_to_find.clear();
-
-        _distance.resize(_wg.num_nodes(), INFINITY);
-        _path.resize(_wg.num_nodes(),-1);
-        _teps_to_find.resize(_wg.num_nodes(),-1);
+        _distance = make_array<float>(INFINITY);
+        _path = make_array<int>(-1);
+        // discovery times only feed the stats
+        if (I::ENABLED) _teps_to_find = make_array<int64_t>(-1);
 
         _distance[_root] = 0.0;
         _path[_root] = _root;
-        _teps_to_find[_root] = 0;
+        if (I::ENABLED) _teps_to_find[_root] = 0;
 
 
         std::set<int> unvisited;
-        for (int v = 0; v < _wg.num_nodes(); v++)
+        for (int v = 0; v < _wg->num_nodes(); v++)
             unvisited.insert(v);
+        _transient = graph_tools::MemoryFootprint::Bytes(unvisited);
 
         while (!unvisited.empty()) {
             // approx. deletion with O(logN)
@@ -46,41 +51,52 @@ public:
                     minsrc = src;
                     mindst = _distance[src];
                 }
-                _fp_compares += 1;
+                _instr.add(Stat::FP_COMPARES);
             }
 
             int src = minsrc;
             if (src == _goal)
                 break;
 
-            auto wneib = _wg.wneighbors(src);
-            for (auto &pair : wneib) {
-                int dst = pair.first;
-                float w = pair.second;
+            for (graph_tools::WEdge e : _wg->wedges(src)) {
+                int dst = e.dst;
+                float w = e.weight;
                 if (_distance[src]+w < _distance[dst]) {
                     _path[dst] = src;
                     _distance[dst] = _distance[src]+w;
                 }
 
-                if (_teps_to_find[dst] == -1) {
-                    _teps_to_find[dst] = _traversed_edges;
+                if (I::ENABLED && _teps_to_find[dst] == -1) {
+                    _teps_to_find[dst] = _instr.get(Stat::TRAVERSED_EDGES);
                 }
 
-                _fp_adds += 1;
-                _fp_compares += 1;
-                _traversed_edges += 1;
+                _instr.add(Stat::FP_ADDS);
+                _instr.add(Stat::FP_COMPARES);
+                _instr.add(Stat::TRAVERSED_EDGES);
             }
             unvisited.erase(src);
+            _instr.next_round();
         }
 
         return {_path, _distance};
     }
 
     int goal() const { return _goal; }
-    std::vector<float> & distance() { return _distance; }
-    std::vector<int>   & path() { return _path; }
+    Array<float> & distance() { return _distance; }
+    Array<int>   & path() { return _path; }
     std::vector<float> distance() const { return _distance; }
     std::vector<int>   path() const { return _path; }
+    const I & instrumentation() const { return _instr; }
+
+    /* bytes this search owns; the graph is shared and reports its own */
+    graph_tools::MemoryFootprint footprint() const {
+        graph_tools::MemoryFootprint f;
+        f.add("distance", graph_tools::VertexArray<G, float>::Bytes(_distance));
+        f.add("path", graph_tools::VertexArray<G, int>::Bytes(_path));
+        if (I::ENABLED) f.add("teps to find", graph_tools::VertexArray<G, int64_t>::Bytes(_teps_to_find));
+        f.add_transient("unvisited", _transient);
+        return f;
+    }
 
     void stats(const std::string &fname) const {
         std::ofstream of(fname);
@@ -89,15 +105,14 @@ public:
 
     std::string stats_str() const {
         std::stringstream ss;
-        ss << "nodes:                 " << _wg.num_nodes() << "\n";
-        ss << "edges:                 " << _wg.num_edges() << "\n";
+        ss << "nodes:                 " << _wg->num_nodes() << "\n";
+        ss << "edges:                 " << _wg->num_edges() << "\n";
         ss << "root:                  " << _root << "\n";
         ss << "goal:                  " << _goal << "\n";
-        ss << "traversed edges:       " << _traversed_edges << "\n";
-        ss << "fp compares:           " << _fp_compares << "\n";
-        ss << "fp adds:               " << _fp_adds << "\n";
-        ss << "fp total:              " << _fp_compares+_fp_adds << "\n";
-        ss << "fp total analytical:   " << 2 * (_wg.num_nodes()-1) * _wg.num_edges() << "\n";
+        ss << _instr.stats_str({Stat::TRAVERSED_EDGES, Stat::FP_COMPARES, Stat::FP_ADDS});
+        if (I::ENABLED)
+            ss << "fp total:              " << _instr.get(Stat::FP_COMPARES) + _instr.get(Stat::FP_ADDS) << "\n";
+        ss << "fp total analytical:   " << 2 * (_wg->num_nodes()-1) * _wg->num_edges() << "\n";
         ss << "distance (root->goal): " << _distance[_goal] << "\n";
         return ss.str();
     }
@@ -123,9 +138,9 @@ public:
             //861
             ;
 
-        auto wg = WGraph::Uniform(graph.first, graph.second);
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(graph.first, graph.second));
 
-        FullWorldDijkstra fdijkstra(wg, 0, goal);
+        BasicFullWorldDijkstra<WGraph> fdijkstra(wg, 0, goal);
         fdijkstra.run();
         std::cout << "stats:" << std::endl;
         std::cout << fdijkstra.stats_str() << std::endl;
@@ -135,13 +150,19 @@ public:
     }
 
 private:
-    WGraph _wg;
+    template <typename T>
+    Array<T> make_array(T init) const {
+        return graph_tools::VertexArray<G, T>::Make(*_wg, _wg->num_nodes(), init);
+    }
+
+    typename G::Ptr _wg;
     int  _root;
     int  _goal;
-    int  _traversed_edges;
-    int  _fp_compares;
-    int  _fp_adds;
-    std::vector<float> _distance;
-    std::vector<int>   _path;
-    std::vector<int>   _teps_to_find;
+    int64_t _transient; // the unvisited set
+    I      _instr;
+    Array<float> _distance;
+    Array<int>   _path;
+    Array<int64_t> _teps_to_find;
 };
+
+using FullWorldDijkstra = BasicFullWorldDijkstra<graph_tools::WGraph>;
@@ -1,5 +1,7 @@
 #pragma once
 #include <Graph500Data.hpp>
+#include <PerfCounters.hpp>
+#include <MemoryFootprint.hpp>
 #include <cstdint>
 #include <string>
 #include <map>
@@ -25,6 +27,7 @@ namespace graph_tools {
     class Graph {
     public:
         using NodeID = uint32_t;
+        using Ptr    = std::shared_ptr<const Graph>;
         class Neighborhood {
         public:
             Neighborhood(const NodeID *begin = nullptr, const NodeID *end = nullptr) :
@@ -39,7 +42,7 @@ namespace graph_tools {
             const NodeID *_end;
         };
 
-        Graph() {}
+        Graph() : _build_peak(0) {}
         Neighborhood neighbors(NodeID v) const {
             return Neighborhood(&_neighbors[_offsets[v]], &_neighbors[_offsets[v]]+_degrees[v]);
         }
@@ -76,7 +79,10 @@ namespace graph_tools {
         }
 
         Graph transpose() const {
-            std::vector<std::list<NodeID>> adjl(num_nodes());
+            PerfScope scope("graph transpose");
+            using List = std::list<NodeID, TrackingAllocator<NodeID>>;
+            AllocationTracker tracker;
+            std::vector<List, TrackingAllocator<List>> adjl(num_nodes(), List(&tracker), &tracker);
             Graph t;
             for (NodeID src = 0; src < num_nodes(); src++) {
                 for (NodeID dst : neighbors(src)) {
@@ -87,23 +93,89 @@ namespace graph_tools {
             // sort each list
             for (auto & l : adjl) l.sort();
 
+            t._offsets.reserve(num_nodes());
+            t._degrees.reserve(num_nodes());
+            t._neighbors.reserve(num_edges());
+
             for (NodeID dst = 0; dst < num_nodes(); dst++) {
                 t._offsets.push_back(t._neighbors.size());
                 t._degrees.push_back(adjl[dst].size());
                 t._neighbors.insert(t._neighbors.end(), adjl[dst].begin(), adjl[dst].end());
             }
 
+            t._build_peak = tracker.peak();
             return t;
         }
 
+        /**
+         * Transpose of this graph, built on first use and shared thereafter
+         */
+        Ptr transposed() const {
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) return t;
+            Ptr built = std::make_shared<const Graph>(transpose());
+            // another thread may have built it first; keep theirs
+            if (std::atomic_compare_exchange_strong(&_transposed, &t, built))
+                return built;
+            return t;
+        }
+
+        /**
+         * Bytes held by this graph, and by its cached transpose if built;
+         * the build peak is the transient adjacency lists of whichever
+         * builder (or transpose) made it.
+         */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("offsets", MemoryFootprint::Bytes(_offsets));
+            f.add("neighbors", MemoryFootprint::Bytes(_neighbors));
+            f.add("degrees", MemoryFootprint::Bytes(_degrees));
+            f.add_transient("build", _build_peak);
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) f.add("transposed", t->footprint());
+            return f;
+        }
+
+        /**
+         * What footprint() will report for a graph of this size built by
+         * FromGraph500Buffer (and transposed, if asked), without building
+         * it. The build peak is an upper bound: every vertex a source.
+         */
+        static MemoryFootprint EstimateFootprint(int64_t nodes, int64_t edges, bool transposed = false) {
+            using List = std::list<NodeID, TrackingAllocator<NodeID>>;
+            const int64_t list_node = MemoryFootprint::ListNode(sizeof(NodeID));
+            const int64_t map_node = 4 * sizeof(void*) + sizeof(std::pair<const NodeID, List>);
+            MemoryFootprint f;
+            f.add("offsets", nodes * sizeof(NodeID));
+            f.add("neighbors", edges * sizeof(NodeID));
+            f.add("degrees", nodes * sizeof(NodeID));
+            f.add_transient("build", nodes * map_node + edges * list_node);
+            if (transposed) {
+                MemoryFootprint t;
+                t.add("offsets", nodes * sizeof(NodeID));
+                t.add("neighbors", edges * sizeof(NodeID));
+                t.add("degrees", nodes * sizeof(NodeID));
+                t.add_transient("build", nodes * static_cast<int64_t>(sizeof(List)) + edges * list_node);
+                f.add("transposed", t);
+            }
+            return f;
+        }
+
     private:
         std::vector<NodeID> _offsets;
         std::vector<NodeID> _neighbors;
         std::vector<NodeID> _degrees;
+        mutable Ptr _transposed;
+        int64_t _build_peak;
     public:
-        std::vector<NodeID>& get_offsets()   { return _offsets; }
-        std::vector<NodeID>& get_neighbors() { return _neighbors; }
-        std::vector<NodeID>& get_degrees()   { return _degrees; }
+        // non-const access may modify the graph; drop the cached transpose
+        std::vector<NodeID>& get_offsets()   { _transposed.reset(); return _offsets; }
+        std::vector<NodeID>& get_neighbors() { _transposed.reset(); return _neighbors; }
+        std::vector<NodeID>& get_degrees()   { _transposed.reset(); return _degrees; }
+
+        const std::vector<NodeID>& get_offsets()   const { return _offsets; }
+        const std::vector<NodeID>& get_neighbors() const { return _neighbors; }
+        const std::vector<NodeID>& get_degrees()   const { return _degrees; }
 
     public:
 #if 0
@@ -145,8 +217,12 @@ namespace graph_tools {
 
         /* Builder functions */
         static Graph FromGraph500Buffer(packed_edge *edges, int64_t nedges, bool transpose = false) {
+            PerfScope scope("graph build");
             // build an adjacency list
-            std::map<NodeID, std::list<NodeID>> neighbors;
+            using List = std::list<NodeID, TrackingAllocator<NodeID>>;
+            AllocationTracker tracker;
+            std::map<NodeID, List, std::less<NodeID>, TrackingAllocator<std::pair<const NodeID, List>>>
+                neighbors(std::less<NodeID>(), &tracker);
 
             std::for_each(edges, edges+nedges,
                           [&](packed_edge & e){
@@ -161,7 +237,7 @@ namespace graph_tools {
 
                               auto rslt = neighbors.find(src);
                               if (rslt == neighbors.end()) {
-                                  neighbors.insert({src, {dst}});
+                                  neighbors.insert({src, List({dst}, &tracker)});
                               } else {
                                   auto & adjl = rslt->second;
                                   adjl.push_back(dst);
@@ -172,9 +248,10 @@ namespace graph_tools {
             std::vector<NodeID> degree;
             std::vector<NodeID> offsets;
             std::vector<NodeID> arcs;
+            arcs.reserve(nedges);
             NodeID maxv = 0;
 
-            for (auto pair : neighbors) {
+            for (auto &pair : neighbors) {
                 NodeID src = pair.first;
                 auto & adjl = pair.second;
 
@@ -209,9 +286,12 @@ namespace graph_tools {
 
             Graph g;
 
+            offsets.shrink_to_fit();
+            degree.shrink_to_fit();
             g._neighbors = std::move(arcs);
             g._offsets   = std::move(offsets);
             g._degrees   = std::move(degree);
+            g._build_peak = tracker.peak();
 
             return g;
         }
@@ -241,20 +321,26 @@ namespace graph_tools {
             return Graph::FromGraph500Data(Graph500Data::Generate(scale, nedges, seed1, seed2), transpose);
         }
 
+        /* one of Graph500Data::Presets() */
+        static Graph FromPreset(const std::string &name, bool transpose = false) {
+            const Graph500Data::Preset &p = Graph500Data::FindPreset(name);
+            return Generate(p.scale, p.edges, transpose);
+        }
+
         static Graph Tiny(bool transpose = false) {
-            return Generate(6, 1<<6, transpose);
+            return FromPreset("Tiny", transpose);
         }
 
         static Graph Small(bool transpose = false) {
-            return Generate(10, 10<<10, transpose);
+            return FromPreset("Small", transpose);
         }
 
         static Graph Kila(bool transpose = false) {
-            return Generate(16, 16<<16, transpose);
+            return FromPreset("Kila", transpose);
         }
 
         static Graph Mega(bool transpose = false) {
-            return Generate(20, 16<<20, transpose);
+            return FromPreset("Mega", transpose);
         }
 
         static Graph Giga(bool transpose = false) {
@@ -315,6 +401,26 @@ namespace graph_tools {
                     }
                 }
             }
+            // Transpose is cached and shared between handles
+            {
+                Graph::Ptr fwd = std::make_shared<const Graph>(Graph::Tiny());
+                Graph::Ptr bck = fwd->transposed();
+                assert(bck == fwd->transposed());
+                assert(bck->num_edges() == fwd->num_edges());
+            }
+            // Builds and transposes are profiled scopes
+            {
+                PerfProfile &profile = PerfProfile::Global();
+                bool was_enabled = profile.enabled();
+                profile.enable();
+                Graph fwd = Graph::Tiny();
+                Graph bck = fwd.transpose();
+                auto entries = profile.entries();
+                assert(entries["graph build"].calls >= 1);
+                assert(entries["graph transpose"].calls >= 1);
+                std::cout << profile.stats_str();
+                profile.enable(was_enabled);
+            }
 
             return 0;
         }
@@ -1,6 +1,7 @@
 #pragma once
 #include <graph_generator.h>
 #include <make_graph.h>
+#include <PerfCounters.hpp>
 #include <cstdint>
 #include <cstring>
 #include <cstdlib>
@@ -143,7 +144,29 @@ namespace graph_tools {
             return Graph500Data(edge, nedges);
         }
 
+        /* a named Generate() size */
+        struct Preset {
+            std::string name;
+            int scale;
+            int64_t edges;
+        };
+
+        /* the sizes behind Graph::Tiny..Mega and the benchmarks, smallest first */
+        static const std::vector<Preset> & Presets() {
+            static const std::vector<Preset> presets = {
+                {"Tiny", 6, 1<<6}, {"Small", 10, 10<<10}, {"Kila", 16, 16<<16}, {"Mega", 20, 16<<20}
+            };
+            return presets;
+        }
+
+        static const Preset & FindPreset(const std::string &name) {
+            for (const Preset &p : Presets())
+                if (p.name == name) return p;
+            throw std::invalid_argument("Graph500Data: unknown preset " + name);
+        }
+
         static Graph500Data Generate(int scale, int64_t nedges, uint64_t seed1 = 2, uint64_t seed2 = 3) {
+            PerfScope scope("graph500 generate");
             packed_edge *result; // the edge list
             int64_t rnedges; // number of edges
 
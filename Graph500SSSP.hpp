@@ -0,0 +1,477 @@
+#pragma once
+#include <Benchmark.hpp>
+#include <Graph500Data.hpp>
+#include <WGraph.hpp>
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+#include <FullWorldDijkstra.hpp>
+#include <Instrumentation.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+namespace graph_tools {
+
+    /**
+     * Graph500 kernel 3 (single-source shortest paths), run with each of
+     * the Dijkstra engines on the same input: an undirected Kronecker
+     * graph of 2^scale vertices and edgefactor * 2^scale edges, stored
+     * with both directions, with weights uniform in [0, 1), searched from
+     * the same random roots of nonzero degree. Every search is validated
+     * and its TEPS reported with the Graph500 statistics.
+     */
+    class Graph500SSSP {
+    public:
+        enum class Engine { DIJKSTRA, DIJKSTRA_PARALLEL, FAST_DIJKSTRA, FULL_WORLD_DIJKSTRA };
+
+        static const char * EngineName(Engine e) {
+            switch (e) {
+            case Engine::DIJKSTRA:            return "dijkstra";
+            case Engine::DIJKSTRA_PARALLEL:   return "dijkstra parallel";
+            case Engine::FAST_DIJKSTRA:       return "fast dijkstra";
+            case Engine::FULL_WORLD_DIJKSTRA: return "full world dijkstra";
+            default:                          return "unknown";
+            }
+        }
+
+        static std::vector<Engine> Engines() {
+            return {Engine::DIJKSTRA, Engine::DIJKSTRA_PARALLEL, Engine::FAST_DIJKSTRA, Engine::FULL_WORLD_DIJKSTRA};
+        }
+
+        /* one search */
+        struct Search {
+            int root;
+            double seconds;
+            int64_t edges; // input edges in the root's component
+            double teps;
+            std::string error; // empty if the result validated
+        };
+
+        /* the Graph500 statistics of a set of TEPS (or times) */
+        struct Statistics {
+            double min, first_quartile, median, third_quartile, max;
+            double mean, stddev; // harmonic for TEPS, arithmetic for times
+        };
+
+        Graph500SSSP(int scale, int edgefactor = 16, int nroots = 64,
+                     uint64_t seed1 = 2, uint64_t seed2 = 3) :
+            _scale(scale),
+            _edgefactor(edgefactor) {
+            if (scale < 1 || edgefactor < 1 || nroots < 1)
+                throw std::invalid_argument("Graph500SSSP: scale, edgefactor and roots must be positive");
+            _wg = std::make_shared<const WGraph>(Generate(scale, edgefactor, seed1, seed2));
+            _wg->transposed();
+            _roots = Roots(*_wg, nroots, seed1 ^ seed2);
+        }
+
+        const WGraph::Ptr & graph() const { return _wg; }
+        const std::vector<int> & roots() const { return _roots; }
+        int scale() const { return _scale; }
+        int edgefactor() const { return _edgefactor; }
+
+        /* search from every root with engine, validating each result */
+        std::vector<Search> run(Engine engine, int threads = std::thread::hardware_concurrency()) const {
+            std::vector<Search> searches;
+            for (int root : _roots) {
+                Search s;
+                s.root = root;
+                std::pair<std::vector<int>, std::vector<float>> result;
+                s.seconds = Time(engine, root, threads, result);
+                s.error = Validate(*_wg, root, result.second, result.first, threads);
+                s.edges = ComponentEdges(*_wg, result.first);
+                s.teps = s.seconds > 0 ? s.edges / s.seconds : 0.0;
+                searches.push_back(s);
+            }
+            return searches;
+        }
+
+        /**
+         * Checks a search result the way the Graph500 validator does.
+         * Returns an empty string if it passes, or the first problem found:
+         *
+         *  - the root is its own parent, at distance 0
+         *  - a vertex has a parent iff it has a finite distance
+         *  - every tree edge (parent[v], v) is an edge of the graph, with
+         *    dist[v] = dist[parent[v]] + its weight
+         *  - parents lead back to the root without cycles
+         *  - no edge (u, v) can shorten a path: dist[v] <= dist[u] + w,
+         *    and v is reached whenever u is
+         *
+         * Edge checks are split across threads. Distances are compared
+         * with a small relative tolerance, since the engines may sum the
+         * same path's weights in a different order.
+         */
+        static std::string Validate(const WGraph &g, int root,
+                                    const std::vector<float> &dist, const std::vector<int> &parent,
+                                    int threads = std::thread::hardware_concurrency()) {
+            int n = g.num_nodes();
+            std::stringstream err;
+            if (static_cast<int>(dist.size()) != n || static_cast<int>(parent.size()) != n) {
+                err << "result has " << dist.size() << " distances and " << parent.size()
+                    << " parents for " << n << " vertices";
+                return err.str();
+            }
+            if (parent[root] != root || dist[root] != 0.0f) {
+                err << "root " << root << " has parent " << parent[root] << " and distance " << dist[root];
+                return err.str();
+            }
+
+            std::mutex mutex;
+            std::string first;
+            auto fail = [&](const std::string &msg) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (first.empty()) first = msg;
+            };
+
+            ParallelFor(n, threads, [&](int begin, int end) {
+                    for (int v = begin; v < end; v++) {
+                        bool reached = parent[v] != -1;
+                        if (reached != std::isfinite(dist[v])) {
+                            std::stringstream ss;
+                            ss << "vertex " << v << " has parent " << parent[v] << " but distance " << dist[v];
+                            return fail(ss.str());
+                        }
+                        if (!reached) continue;
+
+                        // the tree edge into v
+                        int p = parent[v];
+                        if (v != root) {
+                            if (p < 0 || p >= n || parent[p] == -1) {
+                                std::stringstream ss;
+                                ss << "vertex " << v << " has unreached parent " << p;
+                                return fail(ss.str());
+                            }
+                            bool found = false;
+                            for (WEdge e : g.wedges(p))
+                                found = found || (static_cast<int>(e.dst) == v && Close(dist[p] + e.weight, dist[v]));
+                            if (!found) {
+                                std::stringstream ss;
+                                ss << "tree edge (" << p << "," << v << ") is not an edge of length "
+                                   << dist[v] - dist[p];
+                                return fail(ss.str());
+                            }
+                        }
+
+                        // the edges out of v
+                        for (WEdge e : g.wedges(v)) {
+                            int u = e.dst;
+                            if (parent[u] == -1 || (dist[u] > dist[v] + e.weight && !Close(dist[u], dist[v] + e.weight))) {
+                                std::stringstream ss;
+                                ss << "edge (" << v << "," << u << ") of weight " << e.weight
+                                   << " shortens " << dist[u] << " to " << dist[v] + e.weight;
+                                return fail(ss.str());
+                            }
+                        }
+                    }
+                });
+            if (!first.empty()) return first;
+
+            // parents lead to the root: depth[v] = depth[parent[v]] + 1
+            std::vector<int> depth(n, -1), chain;
+            depth[root] = 0;
+            for (int v = 0; v < n; v++) {
+                if (parent[v] == -1 || depth[v] != -1) continue;
+                chain.clear();
+                int u = v;
+                while (depth[u] == -1) {
+                    chain.push_back(u);
+                    u = parent[u];
+                    if (static_cast<int>(chain.size()) > n) {
+                        err << "parents of vertex " << v << " form a cycle";
+                        return err.str();
+                    }
+                }
+                for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+                    depth[*it] = depth[parent[*it]] + 1;
+            }
+            return "";
+        }
+
+        /**
+         * Graph500 statistics: quartiles, and the harmonic mean and its
+         * standard deviation for rates (harmonic = true) or the arithmetic
+         * ones for times.
+         */
+        static Statistics Stats(std::vector<double> x, bool harmonic) {
+            Statistics s;
+            std::sort(x.begin(), x.end());
+            double n = x.size();
+            s.min = x.front();
+            s.first_quartile = Benchmark::Percentile(x, 0.25);
+            s.median = Benchmark::Percentile(x, 0.5);
+            s.third_quartile = Benchmark::Percentile(x, 0.75);
+            s.max = x.back();
+            if (harmonic) {
+                double inv = 0;
+                for (double v : x) inv += 1.0 / v;
+                s.mean = n / inv;
+                double ss = 0;
+                for (double v : x) ss += (1.0 / v - 1.0 / s.mean) * (1.0 / v - 1.0 / s.mean);
+                s.stddev = n > 1 ? std::sqrt(ss) / (n - 1) * s.mean * s.mean : 0.0;
+            } else {
+                double sum = 0;
+                for (double v : x) sum += v;
+                s.mean = sum / n;
+                double ss = 0;
+                for (double v : x) ss += (v - s.mean) * (v - s.mean);
+                s.stddev = n > 1 ? std::sqrt(ss / (n - 1)) : 0.0;
+            }
+            return s;
+        }
+
+        /* the Graph500 output block for one engine's searches */
+        std::string stats_str(Engine engine, const std::vector<Search> &searches) const {
+            std::vector<double> times, teps;
+            int valid = 0;
+            for (const Search &s : searches) {
+                times.push_back(s.seconds);
+                teps.push_back(s.teps);
+                valid += s.error.empty();
+            }
+            Statistics t = Stats(times, false), r = Stats(teps, true);
+            std::stringstream ss;
+            ss << "engine:                " << EngineName(engine) << "\n";
+            ss << "SCALE:                 " << _scale << "\n";
+            ss << "edgefactor:            " << _edgefactor << "\n";
+            ss << "NBFS:                  " << searches.size() << "\n";
+            ss << "validated:             " << valid << " of " << searches.size() << "\n";
+            ss << "sssp_min_time:         " << t.min << "\n";
+            ss << "sssp_firstquartile_time: " << t.first_quartile << "\n";
+            ss << "sssp_median_time:      " << t.median << "\n";
+            ss << "sssp_thirdquartile_time: " << t.third_quartile << "\n";
+            ss << "sssp_max_time:         " << t.max << "\n";
+            ss << "sssp_mean_time:        " << t.mean << "\n";
+            ss << "sssp_stddev_time:      " << t.stddev << "\n";
+            ss << "sssp_min_TEPS:         " << r.min << "\n";
+            ss << "sssp_firstquartile_TEPS: " << r.first_quartile << "\n";
+            ss << "sssp_median_TEPS:      " << r.median << "\n";
+            ss << "sssp_thirdquartile_TEPS: " << r.third_quartile << "\n";
+            ss << "sssp_max_TEPS:         " << r.max << "\n";
+            ss << "sssp_harmonic_mean_TEPS: " << r.mean << "\n";
+            ss << "sssp_harmonic_stddev_TEPS: " << r.stddev << "\n";
+            return ss.str();
+        }
+
+        /**
+         * The bench entry point. Takes the Benchmark flags; the graph is
+         * the largest preset allowed by --max-preset, and reps is unused
+         * (there is one search per root). Times go into the Benchmark
+         * results, so they can be compared against a baseline like any
+         * other suite. Exits non-zero if a search fails validation.
+         */
+        static int Bench(int argc, char *argv[]) {
+            Benchmark bench(Benchmark::Options::Parse(argc, argv));
+            const std::string &preset = bench.options().max_preset;
+            int scale = Graph500Data::Presets().front().scale;
+            for (const Graph500Data::Preset &p : Graph500Data::Presets()) {
+                if (!bench.runs_preset(p.name)) break;
+                scale = p.scale;
+            }
+            Graph500SSSP k3(scale);
+            int failed = 0;
+            for (Engine e : Engines()) {
+                if (!bench.runs_case(EngineName(e))) continue;
+                if (e == Engine::FULL_WORLD_DIJKSTRA && scale > Graph500Data::FindPreset("Small").scale) continue;
+                auto searches = k3.run(e);
+                std::vector<double> seconds;
+                int64_t edges = 0;
+                for (const Search &s : searches) {
+                    seconds.push_back(s.seconds);
+                    edges += s.edges;
+                    if (!s.error.empty()) {
+                        std::cerr << EngineName(e) << " from " << s.root << ": " << s.error << std::endl;
+                        failed++;
+                    }
+                }
+                bench.record(std::string("kernel 3 ") + EngineName(e), preset,
+                             k3.graph()->num_nodes(), edges / static_cast<int64_t>(searches.size()), seconds);
+                std::cout << k3.stats_str(e, searches) << std::endl;
+            }
+            return (bench.finish() == 0 && failed == 0) ? 0 : 1;
+        }
+
+        static int Test(int argc, char *argv[]) {
+            Graph500SSSP k3(10, 16, 8);
+            const WGraph &g = *k3.graph();
+            int n = g.num_nodes();
+            assert(k3.roots().size() == 8);
+            for (int root : k3.roots()) assert(g.degree(root) > 0);
+
+            // the graph is undirected, so every edge is stored both ways
+            for (int v = 0; v < n; v++)
+                for (WEdge e : g.wedges(v)) {
+                    bool back = false;
+                    for (WEdge r : g.wedges(e.dst)) back = back || (static_cast<int>(r.dst) == v && r.weight == e.weight);
+                    assert(back);
+                    assert(e.weight >= 0.0f && e.weight < 1.0f);
+                }
+
+            // every engine validates and agrees with the others
+            std::vector<std::vector<Search>> all;
+            for (Engine e : Engines()) {
+                auto searches = k3.run(e, 4);
+                for (const Search &s : searches) {
+                    if (!s.error.empty()) std::cerr << EngineName(e) << ": " << s.error << std::endl;
+                    assert(s.error.empty());
+                    assert(s.edges > 0 && s.teps > 0);
+                }
+                if (!all.empty())
+                    for (size_t i = 0; i < searches.size(); i++)
+                        assert(searches[i].edges == all.front()[i].edges);
+                all.push_back(searches);
+                std::cout << k3.stats_str(e, searches) << std::endl;
+            }
+
+            // and the validator catches broken results
+            int root = k3.roots().front();
+            BasicFastDijkstra<WGraph, NoInstrumentation> d(k3.graph(), root, -1);
+            auto good = d.run();
+            assert(Validate(g, root, good.second, good.first).empty());
+            int v = -1;
+            for (int u = 0; u < n && v == -1; u++)
+                if (u != root && good.first[u] != -1) v = u;
+            assert(v != -1);
+            {
+                auto bad = good; // too long
+                bad.second[v] += 0.5f;
+                assert(!Validate(g, root, bad.second, bad.first).empty());
+            }
+            {
+                auto bad = good; // too short
+                bad.second[v] -= 0.5f;
+                assert(!Validate(g, root, bad.second, bad.first).empty());
+            }
+            {
+                auto bad = good; // unreached
+                bad.first[v] = -1;
+                bad.second[v] = INFINITY;
+                assert(!Validate(g, root, bad.second, bad.first).empty());
+            }
+            {
+                auto bad = good; // wrong root
+                bad.first[root] = v;
+                assert(!Validate(g, root, bad.second, bad.first).empty());
+            }
+
+            // Graph500 statistics
+            Statistics s = Stats({1.0, 2.0, 4.0}, true);
+            assert(std::fabs(s.mean - 12.0 / 7.0) < 1e-9);
+            assert(s.median == 2.0 && s.min == 1.0 && s.max == 4.0);
+            s = Stats({1.0, 2.0, 3.0}, false);
+            assert(s.mean == 2.0 && s.stddev == 1.0);
+            return 0;
+        }
+
+    private:
+        /* both directions of every generated edge, sharing one weight */
+        static WGraph Generate(int scale, int edgefactor, uint64_t seed1, uint64_t seed2) {
+            Graph500Data data = Graph500Data::Generate(scale, static_cast<int64_t>(edgefactor) << scale, seed1, seed2);
+            int64_t m = data.num_edges();
+            packed_edge *edges = reinterpret_cast<packed_edge*>(malloc(sizeof(packed_edge) * 2 * m));
+            if (edges == NULL) throw std::bad_alloc();
+            std::vector<float> weights(2 * m);
+            std::mt19937_64 gen(seed1 * 31 + seed2);
+            std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+            const packed_edge *in = data.begin();
+            for (int64_t i = 0; i < m; i++) {
+                int64_t u = get_v0_from_edge(&in[i]), v = get_v1_from_edge(&in[i]);
+                float w = dist(gen);
+                if (w >= 1.0f) w = 0.0f; // some libraries round up to 1
+                write_edge(&edges[2*i],   u, v);
+                write_edge(&edges[2*i+1], v, u);
+                weights[2*i] = weights[2*i+1] = w;
+            }
+            Graph500Data both(edges, 2 * m);
+            return WGraph::FromGraph500Data(both, &weights[0]);
+        }
+
+        /* distinct random roots with at least one edge, as Graph500 picks them */
+        static std::vector<int> Roots(const WGraph &g, int nroots, uint64_t seed) {
+            std::vector<int> candidates;
+            int n = g.num_nodes();
+            for (int v = 0; v < n; v++)
+                if (g.degree(v) > 0) candidates.push_back(v);
+            if (candidates.empty())
+                throw std::invalid_argument("Graph500SSSP: graph has no edges");
+            std::mt19937_64 gen(seed);
+            std::shuffle(candidates.begin(), candidates.end(), gen);
+            candidates.resize(std::min<size_t>(nroots, candidates.size()));
+            return candidates;
+        }
+
+        /* undirected input edges with an endpoint reached */
+        static int64_t ComponentEdges(const WGraph &g, const std::vector<int> &parent) {
+            int64_t degrees = 0;
+            int n = g.num_nodes();
+            for (int v = 0; v < n; v++)
+                if (parent[v] != -1) degrees += g.degree(v);
+            return degrees / 2;
+        }
+
+        static bool Close(float a, float b) {
+            return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::max(std::fabs(a), std::fabs(b)));
+        }
+
+        template <typename F>
+        static void ParallelFor(int n, int threads, F f) {
+            threads = std::max(1, std::min(threads, n));
+            std::vector<std::thread> workers;
+            int chunk = (n + threads - 1) / threads;
+            for (int t = 1; t < threads; t++)
+                workers.emplace_back(f, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+            f(0, std::min(n, chunk));
+            for (auto &w : workers) w.join();
+        }
+
+        double Time(Engine engine, int root, int threads,
+                    std::pair<std::vector<int>, std::vector<float>> &result) const {
+            using clock = std::chrono::steady_clock;
+            clock::time_point t0, t1;
+            switch (engine) {
+            case Engine::DIJKSTRA: {
+                BasicDijkstra<WGraph, NoInstrumentation> d(_wg, root);
+                t0 = clock::now();
+                result = d.run();
+                t1 = clock::now();
+                break;
+            }
+            case Engine::DIJKSTRA_PARALLEL: {
+                BasicDijkstra<WGraph, NoInstrumentation> d(_wg, root);
+                t0 = clock::now();
+                result = d.run_parallel(threads);
+                t1 = clock::now();
+                break;
+            }
+            case Engine::FAST_DIJKSTRA: {
+                BasicFastDijkstra<WGraph, NoInstrumentation> d(_wg, root, -1);
+                t0 = clock::now();
+                result = d.run();
+                t1 = clock::now();
+                break;
+            }
+            case Engine::FULL_WORLD_DIJKSTRA: {
+                BasicFullWorldDijkstra<WGraph, NoInstrumentation> d(_wg, root, -1);
+                t0 = clock::now();
+                result = d.run();
+                t1 = clock::now();
+                break;
+            }
+            }
+            return std::chrono::duration<double>(t1 - t0).count();
+        }
+
+        int _scale;
+        int _edgefactor;
+        WGraph::Ptr _wg;
+        std::vector<int> _roots;
+    };
+}
@@ -0,0 +1,220 @@
+#pragma once
+#include <Benchmark.hpp>
+#include <Graph.hpp>
+#include <WGraph.hpp>
+#include <InterleavedWGraph.hpp>
+#include <Graph500Data.hpp>
+#include <BFS.hpp>
+#include <SparsePushBFS.hpp>
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+#include <FullWorldDijkstra.hpp>
+#include <BidirectionalDijkstra.hpp>
+#include <ALTDijkstra.hpp>
+#include <BatchDijkstra.hpp>
+#include <PageRank.hpp>
+#include <Instrumentation.hpp>
+#include <vector>
+#include <string>
+#include <random>
+#include <limits.h>
+
+namespace graph_tools {
+
+    /**
+     * The benchmark suite behind `make bench`: every builder, traversal,
+     * SSSP variant and PageRank mode on the Graph::Tiny..Mega presets (Graph500
+     * Kronecker graphs) and, for the weighted algorithms, on WGraph's
+     * uniform generator at the same sizes. Templated algorithms run
+     * with NoInstrumentation, as in production. Algorithms that are
+     * quadratic in nodes only run on the small presets.
+     */
+    class GraphBenchmarks {
+    public:
+        using Preset = Graph500Data::Preset;
+
+        GraphBenchmarks(Benchmark &bench) : _bench(bench) {}
+
+        void run() {
+            for (const Preset &p : Graph500Data::Presets()) {
+                if (!_bench.runs_preset(p.name)) continue;
+                Graph500Data data = Graph500Data::Generate(p.scale, p.edges);
+                builders(p, data);
+                unweighted(p, std::make_shared<const Graph>(Graph::FromGraph500Data(data)));
+                weighted(p, p.name, std::make_shared<const WGraph>(WGraph::FromGraph500Data(data)));
+                weighted(p, p.name + " uniform",
+                         std::make_shared<const WGraph>(WGraph::Uniform(1 << p.scale, p.edges)));
+            }
+        }
+
+        static int Bench(int argc, char *argv[]) {
+            Benchmark bench(Benchmark::Options::Parse(argc, argv));
+            GraphBenchmarks(bench).run();
+            return bench.finish() == 0 ? 0 : 1;
+        }
+
+        static int Test(int argc, char *argv[]) {
+            // the whole suite, once, on the smallest preset
+            Benchmark::Options o;
+            o.warmup = 0;
+            o.reps = 1;
+            o.max_preset = "Tiny";
+            Benchmark bench(o);
+            GraphBenchmarks(bench).run();
+            for (const auto &r : bench.results())
+                assert(r.graph == "Tiny" || r.graph == "Tiny uniform");
+            assert(bench.results().size() > 10);
+            return bench.finish();
+        }
+
+    private:
+        /* quadratic algorithms stop here */
+        static bool Small(const Preset &p) { return p.scale <= Graph500Data::FindPreset("Small").scale; }
+
+        void builders(const Preset &p, const Graph500Data &data) {
+            Graph g;
+            WGraph wg;
+            std::vector<float> weights(data.num_edges(), 1.0f);
+            _bench.run("graph500 generate", p.name, 1 << p.scale, p.edges, [&]() {
+                    Graph500Data d = Graph500Data::Generate(p.scale, p.edges);
+                    _sink += d.num_edges();
+                });
+            _bench.run("graph build", p.name, 1 << p.scale, p.edges, [&]() {
+                    g = Graph::FromGraph500Data(data);
+                });
+            _bench.run("graph transpose", p.name, g.num_nodes(), g.num_edges(), [&]() {
+                    _sink += g.transpose().num_edges();
+                });
+            _bench.run("wgraph build", p.name, 1 << p.scale, p.edges, [&]() {
+                    wg = WGraph::FromGraph500Data(data, &weights[0]);
+                });
+            _bench.run("wgraph transpose", p.name, wg.num_nodes(), wg.num_edges(), [&]() {
+                    _sink += wg.transpose().num_edges();
+                });
+        }
+
+        void unweighted(const Preset &p, const Graph::Ptr &g) {
+            // the transpose is cached, so run_back doesn't time building it
+            g->transposed();
+            Graph::NodeID root = Root(*g);
+            BFS bfs(g);
+            _bench.run("bfs forward", p.name, g->num_nodes(), g->num_edges(), [&]() {
+                    bfs.run(root, INT_MAX, true);
+                    _sink += bfs.visited().size();
+                });
+            _bench.run("bfs back", p.name, g->num_nodes(), g->num_edges(), [&]() {
+                    bfs.run(root, INT_MAX, false);
+                    _sink += bfs.visited().size();
+                });
+
+            // a fixed number of iterations, so every mode does the same work
+            const int iterations = 10;
+            for (PageRank::Mode mode : {PageRank::Mode::PULL, PageRank::Mode::PUSH_ATOMIC,
+                        PageRank::Mode::PUSH_PRIVATE, PageRank::Mode::BLOCKED}) {
+                PageRank pr(g);
+                _bench.run(std::string("pagerank ") + PageRank::ModeName(mode), p.name,
+                           g->num_nodes(), static_cast<int64_t>(iterations) * g->num_edges(), [&]() {
+                        _sink += pr.run(mode, 0.85f, 0, iterations);
+                    });
+            }
+        }
+
+        void weighted(const Preset &p, const std::string &graph, const WGraph::Ptr &wg) {
+            int64_t n = wg->num_nodes(), m = wg->num_edges();
+            int root = Root(*wg);
+            wg->transposed();
+
+            // a goal about halfway out, for the point-to-point searches
+            BasicFastDijkstra<WGraph, NoInstrumentation> all(wg, root, -1);
+            all.run();
+            int goal = Goal(all.distance(), root);
+
+            _bench.run("sparse push bfs", graph, n, m, [&]() {
+                    std::set<int> frontier = {root}, visited = {root};
+                    while (!frontier.empty()) {
+                        BasicSparsePushBFS<WGraph, NoInstrumentation> bfs(wg, frontier, visited);
+                        bfs.run();
+                        frontier.swap(bfs.frontier_out());
+                        visited.swap(bfs.visited_out());
+                    }
+                    _sink += visited.size();
+                });
+            _bench.run("dijkstra", graph, n, m, [&]() {
+                    BasicDijkstra<WGraph, NoInstrumentation> d(wg, root);
+                    d.run();
+                });
+            _bench.run("dijkstra parallel", graph, n, m, [&]() {
+                    BasicDijkstra<WGraph, NoInstrumentation> d(wg, root);
+                    d.run_parallel();
+                });
+            _bench.run("fast dijkstra", graph, n, m, [&]() {
+                    BasicFastDijkstra<WGraph, NoInstrumentation> d(wg, root, goal);
+                    d.run();
+                });
+
+            // the same searches on the interleaved (dst, weight) layout
+            auto iwg = std::make_shared<const InterleavedWGraph>(*wg);
+            iwg->transposed();
+            _bench.run("dijkstra interleaved", graph, n, m, [&]() {
+                    BasicDijkstra<InterleavedWGraph, NoInstrumentation> d(iwg, root);
+                    d.run();
+                });
+            _bench.run("fast dijkstra interleaved", graph, n, m, [&]() {
+                    BasicFastDijkstra<InterleavedWGraph, NoInstrumentation> d(iwg, root, goal);
+                    d.run();
+                });
+            if (Small(p))
+                _bench.run("full world dijkstra", graph, n, m, [&]() {
+                        BasicFullWorldDijkstra<WGraph, NoInstrumentation> d(wg, root, goal);
+                        d.run();
+                    });
+            _bench.run("bidirectional dijkstra", graph, n, m, [&]() {
+                    BidirectionalDijkstra d(wg, root, goal);
+                    d.run();
+                });
+
+            ALTLandmarks::Ptr lm;
+            _bench.run("alt landmarks build", graph, n, m, [&]() {
+                    lm = std::make_shared<const ALTLandmarks>(ALTLandmarks::Build(wg, 8));
+                });
+            if (lm) {
+                ALTDijkstra alt(wg, lm, root, goal);
+                _bench.run("alt dijkstra", graph, n, m, [&]() {
+                        _sink += alt.query(root, goal) < INFINITY;
+                    });
+            }
+
+            std::vector<BatchDijkstra::Query> queries;
+            std::default_random_engine gen;
+            std::uniform_int_distribution<int> vertex(0, n - 1);
+            for (int q = 0; q < 64; q++) queries.push_back({vertex(gen), vertex(gen)});
+            BatchDijkstra batch(wg);
+            _bench.run("batch dijkstra", graph, n, m, [&]() {
+                    _sink += batch.run(queries).size();
+                });
+        }
+
+        /* the first vertex with edges */
+        template <typename G>
+        static int Root(const G &g) {
+            for (typename G::NodeID v = 0; v < g.num_nodes(); v++)
+                if (g.degree(v) > 0) return v;
+            return 0;
+        }
+
+        /* the reachable vertex with the median distance from root */
+        template <typename A>
+        static int Goal(const A &distance, int root) {
+            std::vector<std::pair<float, int>> reached;
+            for (size_t v = 0; v < distance.size(); v++)
+                if (distance[v] != INFINITY && static_cast<int>(v) != root)
+                    reached.push_back({distance[v], static_cast<int>(v)});
+            if (reached.empty()) return root;
+            std::nth_element(reached.begin(), reached.begin() + reached.size() / 2, reached.end());
+            return reached[reached.size() / 2].second;
+        }
+
+        Benchmark &_bench;
+        volatile int64_t _sink = 0; // keeps results live
+    };
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <initializer_list>
+#include <stdint.h>
+
+namespace graph_tools {
+
+    /* event counts an algorithm may report */
+    enum class Stat { TRAVERSED_EDGES, FP_COMPARES, FP_ADDS, UPDATES, FRONTIER_READS, COUNT };
+
+    inline const char * StatName(Stat s) {
+        switch (s) {
+        case Stat::TRAVERSED_EDGES: return "traversed edges";
+        case Stat::FP_COMPARES:     return "fp compares";
+        case Stat::FP_ADDS:         return "fp adds";
+        case Stat::UPDATES:         return "updates";
+        case Stat::FRONTIER_READS:  return "frontier reads";
+        default:                    return "unknown";
+        }
+    }
+
+    /**
+     * Instrumentation policies, passed to algorithms as a template
+     * parameter. Algorithms call add() in their inner loops and
+     * next_round() at the end of each level, sweep or settle step, and
+     * report through stats_str()/stats_csv() with the stats they use.
+     *
+     *   NoInstrumentation - everything compiles away; for production runs
+     *   Counters          - 64-bit totals, private to one algorithm object
+     *                       (and so to one thread); merge() reduces them
+     *   PerIteration      - Counters plus the counts of every round
+     *
+     * ENABLED lets algorithms compile out bookkeeping that only feeds the
+     * stats, like per-vertex discovery times.
+     */
+    class NoInstrumentation {
+    public:
+        enum : bool { ENABLED = false };
+
+        void add(Stat, int64_t = 1) {}
+        void next_round() {}
+        void reset() {}
+        int64_t get(Stat) const { return 0; }
+
+        std::string stats_str(std::initializer_list<Stat>) const {
+            return "instrumentation:       none\n";
+        }
+        std::string stats_csv_header(std::initializer_list<Stat>) const { return ""; }
+        std::string stats_csv(std::initializer_list<Stat>) const { return ""; }
+    };
+
+    class Counters {
+    public:
+        enum : bool { ENABLED = true };
+
+        Counters() { reset(); }
+
+        void add(Stat s, int64_t n = 1) { _counts[static_cast<int>(s)] += n; }
+        void next_round() {}
+        void reset() { _counts.fill(0); }
+        int64_t get(Stat s) const { return _counts[static_cast<int>(s)]; }
+
+        /* fold in another (e.g. per-thread) set of counters */
+        void merge(const Counters &other) {
+            for (size_t i = 0; i < _counts.size(); i++) _counts[i] += other._counts[i];
+        }
+
+        /* aligned "label: value" lines, as in the algorithms' stats_str() */
+        std::string stats_str(std::initializer_list<Stat> stats) const {
+            std::stringstream ss;
+            for (Stat s : stats) {
+                std::string label = std::string(StatName(s)) + ":";
+                ss << label << std::string(label.size() < 23 ? 23 - label.size() : 1, ' ')
+                   << get(s) << "\n";
+            }
+            return ss.str();
+        }
+
+        std::string stats_csv_header(std::initializer_list<Stat> stats) const {
+            std::stringstream ss;
+            for (Stat s : stats) ss << ColumnName(s) << ",";
+            return ss.str();
+        }
+
+        std::string stats_csv(std::initializer_list<Stat> stats) const {
+            std::stringstream ss;
+            for (Stat s : stats) ss << get(s) << ",";
+            return ss.str();
+        }
+
+    protected:
+        using Counts = std::array<int64_t, static_cast<size_t>(Stat::COUNT)>;
+
+        static std::string ColumnName(Stat s) {
+            std::string name = StatName(s);
+            for (char &c : name) if (c == ' ') c = '_';
+            return name;
+        }
+
+        Counts _counts;
+    };
+
+    class PerIteration : public Counters {
+    public:
+        PerIteration() { reset(); }
+
+        /* close the current round */
+        void next_round() {
+            Counts round;
+            for (size_t i = 0; i < round.size(); i++) round[i] = _counts[i] - _start[i];
+            _rounds.push_back(round);
+            _start = _counts;
+        }
+
+        void reset() {
+            Counters::reset();
+            _start.fill(0);
+            _rounds.clear();
+        }
+
+        size_t rounds() const { return _rounds.size(); }
+        int64_t get(Stat s, size_t round) const { return _rounds.at(round)[static_cast<int>(s)]; }
+        using Counters::get;
+
+        std::string stats_str(std::initializer_list<Stat> stats) const {
+            std::stringstream ss;
+            ss << Counters::stats_str(stats);
+            ss << "rounds:                " << _rounds.size() << "\n";
+            return ss.str();
+        }
+
+        /* one row per round */
+        std::string rounds_csv(std::initializer_list<Stat> stats) const {
+            std::stringstream ss;
+            ss << "round," << stats_csv_header(stats) << "\n";
+            for (size_t r = 0; r < _rounds.size(); r++) {
+                ss << r << ",";
+                for (Stat s : stats) ss << _rounds[r][static_cast<int>(s)] << ",";
+                ss << "\n";
+            }
+            return ss.str();
+        }
+
+    private:
+        Counts _start;
+        std::vector<Counts> _rounds;
+    };
+}
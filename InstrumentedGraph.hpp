@@ -0,0 +1,439 @@
+#pragma once
+#include <Graph.hpp>
+#include <WGraph.hpp>
+#include <InterleavedWGraph.hpp>
+#include <VertexArray.hpp>
+#include <MemoryPort.hpp>
+#include <VectorWithCache.hpp>
+#include <MemoryTrace.hpp>
+#include <BFS.hpp>
+#include <SparsePushBFS.hpp>
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+#include <FullWorldDijkstra.hpp>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <cassert>
+
+namespace graph_tools {
+
+    /**
+     * Graph, WGraph and InterleavedWGraph views that report every read of
+     * the CSR arrays to a MemoryPort (a CachePort, TraceWriter,
+     * MemoryHierarchy port, ...).
+     * They wrap a shared graph handle, so the arrays keep their real
+     * addresses and nothing is copied. Algorithms templated on the graph
+     * type run on these unchanged; VertexArray gives them VectorWithCache
+     * property arrays on the same port.
+     */
+    class InstrumentedGraphBase {
+    public:
+        using NodeID = Graph::NodeID;
+        using Addr   = memory_modeling::MemoryPort::Addr;
+        using Port   = memory_modeling::MemoryPort;
+
+        /* neighbor ids, one model load per id read */
+        class Neighborhood {
+        public:
+            class iterator {
+            public:
+                iterator(const NodeID *p, Port *port) : _p(p), _port(port) {}
+                NodeID operator*() const { return Load(_port, _p); }
+                iterator & operator++() { ++_p; return *this; }
+                bool operator!=(const iterator &other) const { return _p != other._p; }
+            private:
+                const NodeID *_p;
+                Port *_port;
+            };
+
+            Neighborhood(const NodeID *begin, const NodeID *end, Port *port) :
+                _begin(begin), _end(end), _port(port) {}
+
+            NodeID operator[](size_t i) const { return Load(_port, _begin+i); }
+            NodeID size() const { return _end - _begin; }
+            iterator begin() const { return iterator(_begin, _port); }
+            iterator end()   const { return iterator(_end, _port); }
+        private:
+            const NodeID *_begin;
+            const NodeID *_end;
+            Port *_port;
+        };
+
+        const Port::Ptr & port() const { return _port; }
+
+    protected:
+        InstrumentedGraphBase(const Port::Ptr &port) : _port(port) {}
+
+        template <typename T>
+        static T Load(Port *port, const T *p) {
+            port->load_multi(reinterpret_cast<Addr>(p), sizeof(T));
+            return *p;
+        }
+
+        template <typename T>
+        T load(const T *p) const { return Load(_port.get(), p); }
+
+        template <typename T>
+        void set_region(const std::string &name, const std::vector<T> &v) const {
+            auto begin = reinterpret_cast<Addr>(v.data());
+            _port->set_region(name, begin, begin + static_cast<Addr>(v.size() * sizeof(T)));
+        }
+
+        Port::Ptr _port;
+    };
+
+    class InstrumentedGraph : public InstrumentedGraphBase {
+    public:
+        using Ptr = std::shared_ptr<const InstrumentedGraph>;
+
+        InstrumentedGraph(const Graph::Ptr &g, const Port::Ptr &port) :
+            InstrumentedGraphBase(port), _g(g) {}
+
+        Neighborhood neighbors(NodeID v) const {
+            NodeID off = offset(v);
+            const NodeID *begin = _g->get_neighbors().data() + off;
+            return Neighborhood(begin, begin + degree(v), _port.get());
+        }
+
+        /* sizes are metadata, not memory traffic */
+        NodeID num_nodes() const { return _g->num_nodes(); }
+        NodeID num_vertices() const { return num_nodes(); }
+        NodeID num_edges() const { return _g->num_edges(); }
+        NodeID degree(NodeID v) const { return load(&_g->get_degrees()[v]); }
+        NodeID offset(NodeID v) const { return load(&_g->get_offsets()[v]); }
+
+        Ptr transposed() const {
+            return std::make_shared<const InstrumentedGraph>(_g->transposed(), _port);
+        }
+
+        const Graph & graph() const { return *_g; }
+
+        /* the wrapped graph's */
+        MemoryFootprint footprint() const { return _g->footprint(); }
+
+        /* name the CSR arrays for per-region stats, e.g. "g.offsets" */
+        void set_regions(const std::string &prefix = "") const {
+            set_region(prefix + "offsets", _g->get_offsets());
+            set_region(prefix + "degrees", _g->get_degrees());
+            set_region(prefix + "neighbors", _g->get_neighbors());
+        }
+
+        static int Test(int argc, char *argv[]);
+
+    private:
+        Graph::Ptr _g;
+    };
+
+    class InstrumentedWGraph : public InstrumentedGraphBase {
+    public:
+        using Ptr = std::shared_ptr<const InstrumentedWGraph>;
+
+        /* (dst, weight) arcs, one model load per field read */
+        class WNeighborhood {
+        public:
+            class iterator {
+            public:
+                iterator(const NodeID *dst, const float *weight, Port *port) :
+                    _dst(dst), _weight(weight), _port(port) {}
+
+                WEdge operator*() const { return {Load(_port, _dst), Load(_port, _weight)}; }
+                iterator & operator++() { ++_dst; ++_weight; return *this; }
+                bool operator!=(const iterator &other) const { return _dst != other._dst; }
+            private:
+                const NodeID *_dst;
+                const float  *_weight;
+                Port *_port;
+            };
+
+            WNeighborhood(const NodeID *dst, const float *weight, NodeID size, Port *port) :
+                _dst(dst), _weight(weight), _size(size), _port(port) {}
+
+            WEdge operator[](size_t i) const { return {Load(_port, _dst+i), Load(_port, _weight+i)}; }
+            NodeID size() const { return _size; }
+            iterator begin() const { return iterator(_dst, _weight, _port); }
+            iterator end()   const { return iterator(_dst+_size, _weight+_size, _port); }
+        private:
+            const NodeID *_dst;
+            const float  *_weight;
+            NodeID _size;
+            Port *_port;
+        };
+
+        InstrumentedWGraph(const WGraph::Ptr &wg, const Port::Ptr &port) :
+            InstrumentedGraphBase(port), _wg(wg) {}
+
+        Neighborhood neighbors(NodeID v) const {
+            NodeID off = offset(v);
+            const NodeID *begin = _wg->get_neighbors().data() + off;
+            return Neighborhood(begin, begin + degree(v), _port.get());
+        }
+
+        WNeighborhood wedges(NodeID v) const {
+            NodeID off = offset(v);
+            return WNeighborhood(_wg->get_neighbors().data() + off,
+                                 _wg->get_weights().data() + off,
+                                 degree(v), _port.get());
+        }
+
+        NodeID num_nodes() const { return _wg->num_nodes(); }
+        NodeID num_vertices() const { return num_nodes(); }
+        NodeID num_edges() const { return _wg->num_edges(); }
+        NodeID degree(NodeID v) const { return load(&_wg->get_degrees()[v]); }
+        NodeID offset(NodeID v) const { return load(&_wg->get_offsets()[v]); }
+
+        Ptr transposed() const {
+            return std::make_shared<const InstrumentedWGraph>(_wg->transposed(), _port);
+        }
+
+        const WGraph & graph() const { return *_wg; }
+
+        /* the wrapped graph's */
+        MemoryFootprint footprint() const { return _wg->footprint(); }
+
+        void set_regions(const std::string &prefix = "") const {
+            set_region(prefix + "offsets", _wg->get_offsets());
+            set_region(prefix + "degrees", _wg->get_degrees());
+            set_region(prefix + "neighbors", _wg->get_neighbors());
+            set_region(prefix + "weights", _wg->get_weights());
+        }
+
+    private:
+        WGraph::Ptr _wg;
+    };
+
+    template <typename T>
+    struct VertexArray<InstrumentedGraph, T> {
+        using type = memory_modeling::VectorWithCache<T>;
+        static type Make(const InstrumentedGraph &g, size_t n, T init) {
+            return type(n, init, nullptr, g.port());
+        }
+        static int64_t Bytes(const type &a) { return MemoryFootprint::Bytes(a.data()); }
+    };
+
+    template <typename T>
+    struct VertexArray<InstrumentedWGraph, T> {
+        using type = memory_modeling::VectorWithCache<T>;
+        static type Make(const InstrumentedWGraph &g, size_t n, T init) {
+            return type(n, init, nullptr, g.port());
+        }
+        static int64_t Bytes(const type &a) { return MemoryFootprint::Bytes(a.data()); }
+    };
+
+    /**
+     * InterleavedWGraph view that reports every read to a MemoryPort, as
+     * InstrumentedWGraph does for the split layout: one model load per
+     * (dst, weight) record instead of one per field.
+     */
+    class InstrumentedInterleavedWGraph : public InstrumentedGraphBase {
+    public:
+        using Ptr = std::shared_ptr<const InstrumentedInterleavedWGraph>;
+
+        class WNeighborhood {
+        public:
+            class iterator {
+            public:
+                iterator(const WEdge *p, Port *port) : _p(p), _port(port) {}
+                WEdge operator*() const { return Load(_port, _p); }
+                iterator & operator++() { ++_p; return *this; }
+                bool operator!=(const iterator &other) const { return _p != other._p; }
+            private:
+                const WEdge *_p;
+                Port *_port;
+            };
+
+            WNeighborhood(const WEdge *begin, NodeID size, Port *port) :
+                _begin(begin), _size(size), _port(port) {}
+
+            WEdge operator[](size_t i) const { return Load(_port, _begin+i); }
+            NodeID size() const { return _size; }
+            iterator begin() const { return iterator(_begin, _port); }
+            iterator end()   const { return iterator(_begin+_size, _port); }
+        private:
+            const WEdge *_begin;
+            NodeID _size;
+            Port *_port;
+        };
+
+        InstrumentedInterleavedWGraph(const InterleavedWGraph::Ptr &g, const Port::Ptr &port) :
+            InstrumentedGraphBase(port), _g(g) {}
+
+        WNeighborhood wedges(NodeID v) const {
+            NodeID off = offset(v);
+            return WNeighborhood(_g->get_edges().data() + off, degree(v), _port.get());
+        }
+
+        NodeID num_nodes() const { return _g->num_nodes(); }
+        NodeID num_vertices() const { return num_nodes(); }
+        NodeID num_edges() const { return _g->num_edges(); }
+        NodeID degree(NodeID v) const { return load(&_g->get_degrees()[v]); }
+        NodeID offset(NodeID v) const { return load(&_g->get_offsets()[v]); }
+
+        Ptr transposed() const {
+            return std::make_shared<const InstrumentedInterleavedWGraph>(_g->transposed(), _port);
+        }
+
+        const InterleavedWGraph & graph() const { return *_g; }
+
+        /* the wrapped graph's */
+        MemoryFootprint footprint() const { return _g->footprint(); }
+
+        void set_regions(const std::string &prefix = "") const {
+            set_region(prefix + "offsets", _g->get_offsets());
+            set_region(prefix + "degrees", _g->get_degrees());
+            set_region(prefix + "edges", _g->get_edges());
+        }
+
+    private:
+        InterleavedWGraph::Ptr _g;
+    };
+
+    template <typename T>
+    struct VertexArray<InstrumentedInterleavedWGraph, T> {
+        using type = memory_modeling::VectorWithCache<T>;
+        static type Make(const InstrumentedInterleavedWGraph &g, size_t n, T init) {
+            return type(n, init, nullptr, g.port());
+        }
+        static int64_t Bytes(const type &a) { return MemoryFootprint::Bytes(a.data()); }
+    };
+
+    /**
+     * Simulated misses of one FastDijkstra query run over an instrumented
+     * view I of g, in a 32 KiB 8-way LRU cache: the whole search (arcs,
+     * offsets and the VectorWithCache distance and path arrays) and the
+     * arc arrays alone.
+     */
+    struct LayoutMisses {
+        int64_t total;
+        int64_t arcs;
+    };
+
+    template <typename I, typename G>
+    LayoutMisses SimulateLayout(const std::shared_ptr<const G> &g, int root, int goal,
+                                std::vector<float> &distance) {
+        auto cache = std::make_shared<memory_modeling::LRUCache>(32*1024, 64, 8);
+        auto ig = std::make_shared<const I>(g, std::make_shared<memory_modeling::CachePort>(cache));
+        ig->set_regions();
+        BasicFastDijkstra<I> fdijkstra(ig, root, goal);
+        fdijkstra.run();
+        distance = fdijkstra.distance().data();
+
+        LayoutMisses misses = {cache->sum_misses(), 0};
+        for (auto &r : cache->region_stats())
+            if (r.name == "neighbors" || r.name == "weights" || r.name == "edges")
+                misses.arcs += r.misses;
+        return misses;
+    }
+
+    inline int InstrumentedGraph::Test(int argc, char *argv[]) {
+        using namespace memory_modeling;
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+
+        // Dijkstra variants give the same answers and report their traffic
+        {
+            auto cache = std::make_shared<LRUCache>(32*1024, 64, 8);
+            auto iwg = std::make_shared<const InstrumentedWGraph>(wg, std::make_shared<CachePort>(cache));
+
+            Dijkstra dijkstra(wg, 0);
+            dijkstra.run();
+            int goal = dijkstra.goal(3.0);
+
+            // the transpose is what Dijkstra walks
+            iwg->transposed()->set_regions("t.");
+
+            BasicDijkstra<InstrumentedWGraph> idijkstra(iwg, 0);
+            idijkstra.run();
+            assert(idijkstra.distance().data() == dijkstra.distance());
+            assert(idijkstra.goal(3.0) == goal);
+            std::cout << "dijkstra: " << cache->stats_csv_header() << "\n"
+                      << "          " << cache->stats_csv() << std::endl;
+            int64_t attributed = 0;
+            for (auto &r : cache->region_stats()) attributed += r.hits + r.misses;
+            assert(attributed == cache->sum_hits() + cache->sum_misses());
+            assert(cache->region_stats()[0].name == "other"); // distance and path
+            std::cout << cache->region_stats_csv_header() << "\n" << cache->region_stats_csv()
+                      << cache->region_evictions_csv();
+
+            auto fcache = std::make_shared<LRUCache>(32*1024, 64, 8);
+            auto fwg = std::make_shared<const InstrumentedWGraph>(wg, std::make_shared<CachePort>(fcache));
+            FastDijkstra fdijkstra(wg, 0, goal);
+            fdijkstra.run();
+            BasicFastDijkstra<InstrumentedWGraph> ifdijkstra(fwg, 0, goal);
+            ifdijkstra.run();
+            assert(ifdijkstra.distance().data() == fdijkstra.distance());
+            assert(ifdijkstra.path().data() == fdijkstra.path());
+            std::cout << "fast dijkstra: " << fcache->stats_csv() << std::endl;
+            // a goal-directed search touches far less than the full fixed point
+            assert(fcache->sum_hits() + fcache->sum_misses() < cache->sum_hits() + cache->sum_misses());
+
+            BasicFullWorldDijkstra<InstrumentedWGraph> iwdijkstra(fwg, 0, goal);
+            iwdijkstra.run();
+            assert(iwdijkstra.distance()[goal] == fdijkstra.distance()[goal]);
+        }
+
+        // Every edge read is one neighbor and one weight load
+        {
+            auto cache = std::make_shared<LRUCache>(32*1024, 64, 8);
+            InstrumentedWGraph iwg(wg, std::make_shared<CachePort>(cache));
+            int64_t edges = 0;
+            for (NodeID v = 0; v < iwg.num_nodes(); v++)
+                for (WEdge e : iwg.wedges(v)) {
+                    assert(e.dst < iwg.num_nodes());
+                    edges++;
+                }
+            assert(edges == wg->num_edges());
+            assert(cache->sum_hits() + cache->sum_misses() == 2 * edges + 2 * wg->num_nodes());
+        }
+
+        // BFS and SparsePushBFS, recorded to a trace
+        {
+            memory_modeling::TemporaryFile file("instrumented_graph");
+            auto trace = std::make_shared<TraceWriter>(file.name(), 64);
+            auto iwg = std::make_shared<const InstrumentedWGraph>(wg, trace);
+
+            auto plain = BasicSparsePushBFS<WGraph>::RunBFS(wg, 0, 3, false);
+            auto traced = BasicSparsePushBFS<InstrumentedWGraph>::RunBFS(iwg, 0, 3, false);
+            for (size_t i = 0; i < plain.size(); i++)
+                assert(plain[i].frontier_out() == traced[i].frontier_out());
+
+            auto g = std::make_shared<Graph>();
+            g->get_offsets() = wg->get_offsets();
+            g->get_degrees() = wg->get_degrees();
+            g->get_neighbors() = wg->get_neighbors();
+            auto ig = std::make_shared<const InstrumentedGraph>(g, trace);
+
+            BFS bfs(g);
+            bfs.run(0, 3, false);
+            BasicBFS<InstrumentedGraph> ibfs(ig);
+            ibfs.run(0, 3, false);
+            assert(bfs.visited() == ibfs.visited());
+
+            trace->close();
+            std::cout << "bfs trace: " << trace->records() << " records" << std::endl;
+            assert(trace->records() > 0);
+        }
+
+        // The interleaved layout answers the same search with fewer arc misses
+        {
+            auto big = std::make_shared<const WGraph>(WGraph::Uniform(100*1000, 320*1000));
+            auto ig = std::make_shared<const InterleavedWGraph>(*big);
+
+            Dijkstra dijkstra(big, 0);
+            dijkstra.run();
+            int goal = dijkstra.goal(10.0);
+
+            BasicDijkstra<InterleavedWGraph> idijkstra(ig, 0);
+            idijkstra.run();
+            assert(idijkstra.distance() == dijkstra.distance());
+
+            std::vector<float> split, interleaved;
+            LayoutMisses s = SimulateLayout<InstrumentedWGraph>(big, 0, goal, split);
+            LayoutMisses i = SimulateLayout<InstrumentedInterleavedWGraph>(ig, 0, goal, interleaved);
+            std::cout << "split      : simulated misses " << s.total << ", arcs " << s.arcs << "\n"
+                      << "interleaved: simulated misses " << i.total << ", arcs " << i.arcs << std::endl;
+            assert(split == interleaved);
+            assert(i.arcs < s.arcs);
+        }
+        return 0;
+    }
+}
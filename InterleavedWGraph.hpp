@@ -0,0 +1,135 @@
+#pragma once
+#include <WGraph.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <algorithm>
+#include <cassert>
+
+namespace graph_tools {
+
+    /**
+     * WGraph with each arc stored as one contiguous (dst, weight) record,
+     * so a relaxation touches one cache line instead of two.
+     * Exposes the same wedges() view as WGraph so kernels templated on
+     * the graph type run on either layout.
+     */
+    class InterleavedWGraph {
+    public:
+        using NodeID = WGraph::NodeID;
+        using Ptr    = std::shared_ptr<const InterleavedWGraph>;
+
+        class WNeighborhood {
+        public:
+            WNeighborhood(const WEdge *begin = nullptr, const WEdge *end = nullptr) :
+                _begin(begin), _end(end) {}
+
+            const WEdge & operator[](size_t i) const { return _begin[i]; }
+            NodeID size() const { return _end - _begin; }
+            const WEdge *begin() const { return _begin; }
+            const WEdge *end()   const { return _end;   }
+        private:
+            const WEdge *_begin;
+            const WEdge *_end;
+        };
+
+        InterleavedWGraph() {}
+        explicit InterleavedWGraph(const WGraph &wg) :
+            _offsets(wg.get_offsets()),
+            _degrees(wg.get_degrees()) {
+            auto &neib = wg.get_neighbors();
+            auto &wgts = wg.get_weights();
+            _edges.reserve(neib.size());
+            for (size_t e = 0; e < neib.size(); e++)
+                _edges.push_back({neib[e], wgts[e]});
+        }
+
+        WNeighborhood wedges(NodeID v) const {
+            return WNeighborhood(_edges.data()+_offsets[v], _edges.data()+_offsets[v]+_degrees[v]);
+        }
+
+        NodeID num_nodes() const { return _degrees.size(); }
+        NodeID num_vertices() const { return num_nodes(); }
+        NodeID num_edges() const { return _edges.size(); }
+        NodeID degree(NodeID v) const { return _degrees[v]; }
+        NodeID offset(NodeID v) const { return _offsets[v]; }
+
+        InterleavedWGraph transpose() const {
+            InterleavedWGraph t;
+            t._degrees.assign(num_nodes(), 0);
+            for (const WEdge &e : _edges)
+                t._degrees[e.dst]++;
+
+            t._offsets.resize(num_nodes());
+            NodeID off = 0;
+            for (NodeID v = 0; v < num_nodes(); v++) {
+                t._offsets[v] = off;
+                off += t._degrees[v];
+            }
+
+            // sources are visited in order, so each in-list stays sorted by src
+            std::vector<NodeID> fill(t._offsets);
+            t._edges.resize(num_edges());
+            for (NodeID src = 0; src < num_nodes(); src++)
+                for (const WEdge &e : wedges(src))
+                    t._edges[fill[e.dst]++] = {src, e.weight};
+
+            return t;
+        }
+
+        /**
+         * Transpose of this graph, built on first use and shared thereafter
+         */
+        Ptr transposed() const {
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) return t;
+            Ptr built = std::make_shared<const InterleavedWGraph>(transpose());
+            // another thread may have built it first; keep theirs
+            if (std::atomic_compare_exchange_strong(&_transposed, &t, built))
+                return built;
+            return t;
+        }
+
+        const std::vector<NodeID>& get_offsets() const { return _offsets; }
+        const std::vector<NodeID>& get_degrees() const { return _degrees; }
+        const std::vector<WEdge> & get_edges()   const { return _edges; }
+
+        /* bytes held by this graph, and by its cached transpose if built */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("offsets", MemoryFootprint::Bytes(_offsets));
+            f.add("degrees", MemoryFootprint::Bytes(_degrees));
+            f.add("edges", MemoryFootprint::Bytes(_edges));
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) f.add("transposed", t->footprint());
+            return f;
+        }
+
+        std::string to_string() const {
+            std::stringstream ss;
+            for (NodeID v = 0; v < num_nodes(); v++) {
+                ss << v << " : ";
+                for (const WEdge &e : wedges(v))
+                    ss << "(" << v << "," << e.dst << "," << e.weight << "), ";
+                ss << "\n";
+            }
+            return ss.str();
+        }
+
+        static int Test(int argc, char *argv[]) {
+            // same arcs as the split layout
+            WGraph wg = WGraph::Uniform(10, 32);
+            InterleavedWGraph ig(wg);
+            assert(ig.to_string() == wg.to_string());
+            assert(ig.transpose().to_string() == wg.transpose().to_string());
+            return 0;
+        }
+
+    private:
+        std::vector<NodeID> _offsets;
+        std::vector<NodeID> _degrees;
+        std::vector<WEdge>  _edges;
+        mutable Ptr _transposed;
+    };
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+#include <stdint.h>
+
+namespace graph_tools {
+
+    /**
+     * Bytes owned by an object, structure by structure. Owned entries add
+     * up to the object's size at rest; transient entries are peaks that
+     * were allocated and freed along the way (a builder's adjacency lists,
+     * a traversal's frontier), so peak() is owned() plus the largest of
+     * them. Objects reached through a shared pointer are added under a
+     * prefix (e.g. "transposed/") so a roll-up can tell what it contains.
+     *
+     * Container sizes are estimates for a 64-bit libstdc++: a vector's
+     * capacity, and for node-based containers the element plus the node's
+     * pointers, rounded up to malloc's 16 byte granularity.
+     */
+    class MemoryFootprint {
+    public:
+        struct Entry {
+            std::string name;
+            int64_t bytes;
+            bool transient;
+        };
+
+        MemoryFootprint & add(const std::string &name, int64_t bytes) {
+            _entries.push_back({name, bytes, false});
+            return *this;
+        }
+
+        MemoryFootprint & add_transient(const std::string &name, int64_t bytes) {
+            if (bytes > 0) _entries.push_back({name, bytes, true});
+            return *this;
+        }
+
+        /* nest another object's footprint, naming its entries prefix/name */
+        MemoryFootprint & add(const std::string &prefix, const MemoryFootprint &child) {
+            for (const Entry &e : child._entries)
+                _entries.push_back({prefix + "/" + e.name, e.bytes, e.transient});
+            return *this;
+        }
+
+        const std::vector<Entry> & entries() const { return _entries; }
+
+        int64_t owned() const {
+            int64_t sum = 0;
+            for (const Entry &e : _entries) if (!e.transient) sum += e.bytes;
+            return sum;
+        }
+
+        int64_t transient() const {
+            int64_t peak = 0;
+            for (const Entry &e : _entries) if (e.transient) peak = std::max(peak, e.bytes);
+            return peak;
+        }
+
+        int64_t peak() const { return owned() + transient(); }
+
+        /* stats api */
+        std::string stats_str() const {
+            std::stringstream ss;
+            for (const Entry &e : _entries) {
+                std::string label = e.name + (e.transient ? " (peak):" : ":");
+                ss << label << std::string(label.size() < 23 ? 23 - label.size() : 1, ' ')
+                   << Human(e.bytes) << "\n";
+            }
+            ss << "owned:                 " << Human(owned()) << "\n";
+            ss << "peak:                  " << Human(peak()) << "\n";
+            return ss.str();
+        }
+
+        std::string stats_csv_header() const { return "structure,bytes,transient,"; }
+
+        std::string stats_csv() const {
+            std::stringstream ss;
+            for (const Entry &e : _entries)
+                ss << e.name << "," << e.bytes << "," << e.transient << ",\n";
+            return ss.str();
+        }
+
+        /* e.g. "1.5 GiB (1610612736)" */
+        static std::string Human(int64_t bytes) {
+            const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+            double v = static_cast<double>(bytes);
+            int u = 0;
+            while (v >= 1024 && u < 4) { v /= 1024; u++; }
+            std::stringstream ss;
+            ss.precision(3);
+            ss << v << " " << units[u];
+            if (u > 0) ss << " (" << bytes << ")";
+            return ss.str();
+        }
+
+        /* container estimates */
+        template <typename T, typename A>
+        static int64_t Bytes(const std::vector<T, A> &v) { return v.capacity() * sizeof(T); }
+
+        template <typename T, typename C, typename A>
+        static int64_t Bytes(const std::set<T, C, A> &s) { return s.size() * Node(sizeof(T), 32); }
+
+        template <typename K, typename V, typename C, typename A>
+        static int64_t Bytes(const std::map<K, V, C, A> &m) {
+            return m.size() * Node(sizeof(std::pair<const K, V>), 32);
+        }
+
+        template <typename T, typename A>
+        static int64_t Bytes(const std::list<T, A> &l) { return l.size() * Node(sizeof(T), 16); }
+
+        /* a std::list node holding element, before malloc rounds it */
+        static int64_t ListNode(size_t element) {
+            return (2 * sizeof(void*) + element + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+        }
+
+        static int Test(int argc, char *argv[]);
+
+    private:
+        /* an element plus its node header, as malloc rounds it */
+        static int64_t Node(size_t element, size_t header) {
+            return (element + header + 15) / 16 * 16;
+        }
+
+        std::vector<Entry> _entries;
+    };
+
+    /**
+     * Live and peak bytes allocated through TrackingAllocators that share
+     * it. Not thread safe; one tracker belongs to one builder call.
+     */
+    class AllocationTracker {
+    public:
+        AllocationTracker() : _live(0), _peak(0), _allocations(0) {}
+
+        void allocate(size_t bytes) {
+            _live += bytes;
+            _peak = std::max(_peak, _live);
+            _allocations++;
+        }
+        void deallocate(size_t bytes) { _live -= bytes; }
+
+        int64_t live() const { return _live; }
+        int64_t peak() const { return _peak; }
+        int64_t allocations() const { return _allocations; }
+
+    private:
+        int64_t _live;
+        int64_t _peak;
+        int64_t _allocations;
+    };
+
+    /**
+     * std::allocator that reports to an AllocationTracker, for measuring
+     * the transient structures in builders. Copies and rebinds share the
+     * tracker, so a container's nodes and its elements' own allocations
+     * are all counted, with malloc's overhead left out.
+     */
+    template <typename T>
+    class TrackingAllocator {
+    public:
+        using value_type = T;
+
+        TrackingAllocator(AllocationTracker *tracker) : _tracker(tracker) {}
+
+        template <typename U>
+        TrackingAllocator(const TrackingAllocator<U> &other) : _tracker(other.tracker()) {}
+
+        T * allocate(size_t n) {
+            _tracker->allocate(n * sizeof(T));
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T *p, size_t n) {
+            _tracker->deallocate(n * sizeof(T));
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        AllocationTracker * tracker() const { return _tracker; }
+
+    private:
+        AllocationTracker *_tracker;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const TrackingAllocator<T> &a, const TrackingAllocator<U> &b) { return a.tracker() == b.tracker(); }
+
+    template <typename T, typename U>
+    bool operator!=(const TrackingAllocator<T> &a, const TrackingAllocator<U> &b) { return !(a == b); }
+
+    inline int MemoryFootprint::Test(int argc, char *argv[]) {
+        // Owned entries add up; transients only raise the peak
+        MemoryFootprint child;
+        child.add("offsets", 400).add("neighbors", 1600).add_transient("build", 5000);
+        MemoryFootprint f;
+        f.add("distance", 100).add("graph", child).add_transient("frontier", 300);
+        assert(f.owned() == 2100);
+        assert(f.transient() == 5000);
+        assert(f.peak() == 7100);
+        assert(f.entries()[1].name == "graph/offsets");
+        std::cout << f.stats_str() << f.stats_csv_header() << "\n" << f.stats_csv();
+
+        // Container estimates
+        std::vector<int> v;
+        v.reserve(100);
+        assert(Bytes(v) == 400);
+        std::set<int> s = {1, 2, 3};
+        assert(Bytes(s) == 3 * 48);
+        std::list<int> l = {1, 2};
+        assert(Bytes(l) == 2 * 32);
+        assert(ListNode(sizeof(int)) == 24);
+
+        // The tracker sees a map of lists grow and shrink
+        AllocationTracker tracker;
+        {
+            using List = std::list<int, TrackingAllocator<int>>;
+            using Map  = std::map<int, List, std::less<int>, TrackingAllocator<std::pair<const int, List>>>;
+            Map m{std::less<int>(), TrackingAllocator<std::pair<const int, List>>(&tracker)};
+            for (int i = 0; i < 100; i++) {
+                auto it = m.find(i % 10);
+                if (it == m.end())
+                    it = m.insert({i % 10, List(TrackingAllocator<int>(&tracker))}).first;
+                it->second.push_back(i);
+            }
+            assert(tracker.live() > 100 * static_cast<int64_t>(sizeof(int)));
+            assert(tracker.peak() == tracker.live());
+        }
+        assert(tracker.live() == 0);
+        assert(tracker.peak() > 0 && tracker.allocations() == 110);
+        std::cout << "map of lists peak:     " << Human(tracker.peak()) << std::endl;
+        return 0;
+    }
+}
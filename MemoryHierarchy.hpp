@@ -0,0 +1,469 @@
+#pragma once
+#include <Cache.hpp>
+#include <MemoryPort.hpp>
+#include <VectorWithCache.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * Banked DRAM with one open row per bank and a bandwidth cap.
+         * Consecutive rows are interleaved across banks.
+         */
+        class DRAM {
+        public:
+            using Addr = Cache::Addr;
+
+            DRAM(int banks = 16,
+                 Addr row_size = 2048,
+                 int64_t row_hit_latency = 40,
+                 int64_t row_miss_latency = 100,
+                 double bytes_per_cycle = 32.0) :
+                _row_size(row_size),
+                _row_hit_latency(row_hit_latency),
+                _row_miss_latency(row_miss_latency),
+                _bytes_per_cycle(bytes_per_cycle),
+                _open(std::max(banks, 1), NO_ROW),
+                _row_hits(0),
+                _row_misses(0),
+                _bytes_read(0),
+                _bytes_written(0) {
+            }
+
+            /* returns the latency of this access */
+            int64_t access(Addr addr, Addr bytes, bool write) {
+                Addr row  = addr / _row_size;
+                size_t bank = row % _open.size();
+                row /= _open.size();
+
+                (write ? _bytes_written : _bytes_read) += bytes;
+                if (_open[bank] == row) {
+                    _row_hits++;
+                    return _row_hit_latency;
+                }
+                _open[bank] = row;
+                _row_misses++;
+                return _row_miss_latency;
+            }
+
+            /* cycles needed to move every byte at peak bandwidth */
+            int64_t bandwidth_cycles() const {
+                return static_cast<int64_t>(std::ceil((_bytes_read + _bytes_written) / _bytes_per_cycle));
+            }
+
+            int banks() const { return _open.size(); }
+            int64_t row_hits() const { return _row_hits; }
+            int64_t row_misses() const { return _row_misses; }
+            int64_t bytes_read() const { return _bytes_read; }
+            int64_t bytes_written() const { return _bytes_written; }
+
+        private:
+            enum : Addr { NO_ROW = -1 };
+
+            Addr _row_size;
+            int64_t _row_hit_latency;
+            int64_t _row_miss_latency;
+            double _bytes_per_cycle;
+            std::vector<Addr> _open; // open row per bank
+
+            int64_t _row_hits;
+            int64_t _row_misses;
+            int64_t _bytes_read;
+            int64_t _bytes_written;
+        };
+
+        /**
+         * Caches chained level by level in front of a DRAM.
+         * A level is a group of Caches that are either private (picked by
+         * core) or banked (picked by block address). Each level declares its
+         * inclusion with respect to the levels above it and its write policy.
+         * Only demand fills are on the critical path; writebacks move bytes
+         * but add no latency. There is no coherence between private caches.
+         *
+         * The estimate is max(serialized latency, DRAM bandwidth floor), which
+         * is meant for ranking kernels against each other, not absolute time.
+         */
+        class MemoryHierarchy {
+        public:
+            using Addr = Cache::Addr;
+            using Ptr  = std::shared_ptr<MemoryHierarchy>;
+
+            enum class Sharing   { PRIVATE, BANKED };
+            enum class Inclusion { NINE, INCLUSIVE, EXCLUSIVE };
+            enum class Write     { BACK, THROUGH };
+
+            struct Level {
+                std::string name;
+                std::vector<Cache::Ptr> caches;
+                int64_t latency;
+                Sharing sharing;
+                Inclusion inclusion;
+                Write write;
+
+                int64_t accesses;
+                int64_t hits;
+                int64_t misses;
+                int64_t writebacks;    // blocks installed from above
+                int64_t bytes_read;    // filled from below
+                int64_t bytes_written; // sent below
+            };
+
+            explicit MemoryHierarchy(const DRAM &dram = DRAM()) :
+                _dram(dram),
+                _block_size(0),
+                _references(0),
+                _latency_cycles(0) {
+            }
+
+            /* append a level below the existing ones */
+            MemoryHierarchy & add_level(const std::string &name,
+                                        const std::vector<Cache::Ptr> &caches,
+                                        int64_t latency,
+                                        Sharing sharing = Sharing::PRIVATE,
+                                        Inclusion inclusion = Inclusion::NINE,
+                                        Write write = Write::BACK) {
+                if (caches.empty())
+                    throw std::invalid_argument("MemoryHierarchy: level '" + name + "' has no caches");
+                if (_levels.empty() && inclusion == Inclusion::EXCLUSIVE)
+                    throw std::invalid_argument("MemoryHierarchy: first level cannot be exclusive");
+                if (_block_size == 0) _block_size = caches[0]->block_size();
+                for (auto &c : caches)
+                    if (c->block_size() != _block_size)
+                        throw std::invalid_argument("MemoryHierarchy: levels must share a block size");
+
+                _levels.push_back({name, caches, latency, sharing, inclusion, write, 0, 0, 0, 0, 0, 0});
+                return *this;
+            }
+
+            /* primary api, same as Cache plus the requesting core */
+            void load(Addr addr, int core = 0) { reference(addr, false, core); }
+            void load_multi(Addr addr, Addr sz, int core = 0) {
+                for_each_block(addr, sz, [=](Addr a) { reference(a, false, core); });
+            }
+
+            void store(Addr addr, int core = 0) { reference(addr, true, core); }
+            void store_multi(Addr addr, Addr sz, int core = 0) {
+                for_each_block(addr, sz, [=](Addr a) { reference(a, true, core); });
+            }
+
+            /* a MemoryPort issuing requests from core, for VectorWithCache */
+            static MemoryPort::Ptr Port(const Ptr &hierarchy, int core = 0) {
+                return std::make_shared<CorePort>(hierarchy, core);
+            }
+
+            /* stats api */
+            int64_t references() const { return _references; }
+            int64_t latency_cycles() const { return _latency_cycles; }
+            int64_t bandwidth_cycles() const { return _dram.bandwidth_cycles(); }
+            int64_t cycles() const { return std::max(latency_cycles(), bandwidth_cycles()); }
+
+            const Level & level(size_t i) const { return _levels.at(i); }
+            size_t levels() const { return _levels.size(); }
+            const DRAM & dram() const { return _dram; }
+
+            std::string stats_str() const {
+                std::stringstream ss;
+                ss << "references:            " << references() << "\n";
+                ss << "estimated cycles:      " << cycles() << "\n";
+                ss << "latency cycles:        " << latency_cycles() << "\n";
+                ss << "bandwidth cycles:      " << bandwidth_cycles() << "\n";
+                for (auto &L : _levels) {
+                    ss << L.name << ":\n";
+                    ss << "  accesses:            " << L.accesses << "\n";
+                    ss << "  hits:                " << L.hits << "\n";
+                    ss << "  misses:              " << L.misses << "\n";
+                    ss << "  writebacks in:       " << L.writebacks << "\n";
+                    ss << "  bytes read:          " << L.bytes_read << "\n";
+                    ss << "  bytes written:       " << L.bytes_written << "\n";
+                }
+                ss << "DRAM:\n";
+                ss << "  row hits:            " << _dram.row_hits() << "\n";
+                ss << "  row misses:          " << _dram.row_misses() << "\n";
+                ss << "  bytes read:          " << _dram.bytes_read() << "\n";
+                ss << "  bytes written:       " << _dram.bytes_written() << "\n";
+                return ss.str();
+            }
+
+            static int Test(int argc, char *argv[]);
+
+        private:
+            using Outcome = Cache::Outcome;
+
+            class CorePort final : public MemoryPort {
+            public:
+                CorePort(const MemoryHierarchy::Ptr &hierarchy, int core) : _hierarchy(hierarchy), _core(core) {}
+                void load_multi(Addr addr, Addr sz) override { _hierarchy->load_multi(addr, sz, _core); }
+                void store_multi(Addr addr, Addr sz) override { _hierarchy->store_multi(addr, sz, _core); }
+                Addr block_size() const override { return _hierarchy->_block_size; }
+            private:
+                MemoryHierarchy::Ptr _hierarchy;
+                int _core;
+            };
+
+            template <typename F>
+            void for_each_block(Addr addr, Addr sz, F f) const {
+                while (sz > 0) {
+                    f(addr);
+                    Addr step = _block_size - addr % _block_size;
+                    addr += step;
+                    sz   -= step;
+                }
+            }
+
+            void reference(Addr addr, bool store, int core) {
+                if (_levels.empty())
+                    throw std::logic_error("MemoryHierarchy: no levels");
+                _references++;
+                _latency_cycles += fetch(0, addr, store, core).latency;
+            }
+
+            /* data returned to the level above */
+            struct Fill {
+                int64_t latency;
+                bool dirty;
+            };
+
+            /* index of the cache in L serving addr, and addr as that cache sees it */
+            size_t select(const Level &L, Addr addr, int core, Addr &local) const {
+                size_t n = L.caches.size();
+                if (L.sharing == Sharing::PRIVATE) {
+                    local = addr;
+                    return core % n;
+                }
+                // drop the bank bits so each bank indexes all of its sets
+                Addr block = addr / _block_size;
+                local = (block / n) * _block_size;
+                return block % n;
+            }
+
+            Addr global(const Level &L, size_t idx, Addr local) const {
+                if (L.sharing == Sharing::PRIVATE) return local;
+                return ((local / _block_size) * L.caches.size() + idx) * _block_size;
+            }
+
+            /* demand request arriving at level i */
+            Fill fetch(size_t i, Addr addr, bool store, int core) {
+                if (i == _levels.size())
+                    return {_dram.access(addr - addr % _block_size, _block_size, false), false};
+
+                Level &L = _levels[i];
+                Addr local;
+                size_t idx = select(L, addr, core, local);
+                Cache &c = *L.caches[idx];
+                L.accesses++;
+
+                // blocks move up out of an exclusive level, and aren't filled on a miss
+                if (L.inclusion == Inclusion::EXCLUSIVE) {
+                    if (c.probe(local)) {
+                        L.hits++;
+                        return {L.latency, c.invalidate(local) == 1};
+                    }
+                    L.misses++;
+                    L.bytes_read += _block_size;
+                    Fill below = fetch(i+1, addr, false, core);
+                    return {L.latency + below.latency, below.dirty};
+                }
+
+                Outcome o = c.reference(local, store && L.write == Write::BACK);
+                Fill f = {L.latency, false};
+                if (o.hit) {
+                    L.hits++;
+                } else {
+                    L.misses++;
+                    L.bytes_read += _block_size;
+                    Fill below = fetch(i+1, addr, false, core);
+                    f.latency += below.latency;
+                    if (below.dirty) c.install(local, true);
+                }
+                if (o.victim != Cache::NONE)
+                    evict(i, global(L, idx, o.victim), o.dirty, core);
+                if (store && L.write == Write::THROUGH) {
+                    L.bytes_written += _block_size;
+                    write_down(i+1, addr, true, core);
+                }
+                return f;
+            }
+
+            /* block leaving level i */
+            void evict(size_t i, Addr addr, bool dirty, int core) {
+                Level &L = _levels[i];
+                if (L.inclusion == Inclusion::INCLUSIVE) {
+                    for (size_t up = 0; up < i; up++)
+                        dirty |= back_invalidate(_levels[up], addr);
+                }
+                bool exclusive_below = i+1 < _levels.size()
+                    && _levels[i+1].inclusion == Inclusion::EXCLUSIVE;
+                if (dirty || exclusive_below) {
+                    L.bytes_written += _block_size;
+                    write_down(i+1, addr, dirty, core);
+                }
+            }
+
+            /* true if a dirty copy was dropped */
+            bool back_invalidate(Level &L, Addr addr) {
+                bool dirty = false;
+                if (L.sharing == Sharing::PRIVATE) {
+                    for (auto &c : L.caches)
+                        dirty |= c->invalidate(addr) == 1;
+                } else {
+                    Addr local;
+                    size_t idx = select(L, addr, 0, local);
+                    dirty |= L.caches[idx]->invalidate(local) == 1;
+                }
+                return dirty;
+            }
+
+            /* writeback or victim arriving at level i */
+            void write_down(size_t i, Addr addr, bool dirty, int core) {
+                if (i == _levels.size()) {
+                    if (dirty) _dram.access(addr, _block_size, true);
+                    return;
+                }
+
+                Level &L = _levels[i];
+                Addr local;
+                size_t idx = select(L, addr, core, local);
+                L.writebacks++;
+                Outcome o = L.caches[idx]->install(local, dirty && L.write == Write::BACK);
+                if (o.victim != Cache::NONE)
+                    evict(i, global(L, idx, o.victim), o.dirty, core);
+                if (dirty && L.write == Write::THROUGH) {
+                    L.bytes_written += _block_size;
+                    write_down(i+1, addr, true, core);
+                }
+            }
+
+            DRAM _dram;
+            std::vector<Level> _levels;
+            Addr _block_size;
+            int64_t _references;
+            int64_t _latency_cycles;
+        };
+
+        inline int MemoryHierarchy::Test(int argc, char *argv[]) {
+            Addr block = 64;
+            auto blocks = [=](std::initializer_list<Addr> ids) {
+                std::vector<Addr> v;
+                for (Addr b : ids) v.push_back(b * block);
+                return v;
+            };
+
+            // One level matches a standalone cache; DRAM sees misses and flushes
+            {
+                MemoryHierarchy h;
+                h.add_level("L1", {std::make_shared<LRUCache>(4*1024, block, 4)}, 4);
+                LRUCache ref(4*1024, block, 4);
+                for (Addr i = 0; i < 20000; i++) {
+                    Addr addr = (i * 2654435761u) % (64*1024);
+                    if (i % 5 == 0) { h.store(addr); ref.store(addr); }
+                    else            { h.load(addr);  ref.load(addr);  }
+                }
+                assert(h.level(0).hits == ref.sum_hits());
+                assert(h.level(0).misses == ref.sum_misses());
+                assert(h.dram().bytes_read() == ref.sum_misses() * block);
+                assert(h.dram().bytes_written() == ref.sum_flushes() * block);
+                assert(h.latency_cycles() >= h.references() * 4);
+            }
+            // Inclusive L2 evictions back-invalidate L1
+            for (auto inclusion : {Inclusion::NINE, Inclusion::INCLUSIVE}) {
+                MemoryHierarchy h;
+                h.add_level("L1", {std::make_shared<LRUCache>(2*block, block, 2)}, 1);
+                h.add_level("L2", {std::make_shared<LRUCache>(2*block, block, 1)}, 10,
+                            Sharing::PRIVATE, inclusion);
+                // blocks 0 and 2 conflict in L2
+                for (Addr a : blocks({0, 2, 0})) h.load(a);
+                assert(h.level(0).hits == (inclusion == Inclusion::NINE ? 1 : 0));
+            }
+            // Exclusive L2 holds L1 victims
+            {
+                MemoryHierarchy h;
+                h.add_level("L1", {std::make_shared<LRUCache>(block, block, 1)}, 1);
+                h.add_level("L2", {std::make_shared<LRUCache>(block, block, 1)}, 10,
+                            Sharing::PRIVATE, Inclusion::EXCLUSIVE);
+                for (Addr a : blocks({0, 1, 0, 1})) h.load(a);
+                assert(h.level(1).hits == 2);
+                assert(h.dram().bytes_read() == 2*block);
+                // a dirty block survives the trip down and back up
+                h.store(0);
+                h.load(block);
+                h.load(2*block);
+                h.load(3*block);
+                assert(h.dram().bytes_written() == block);
+            }
+            // Write-through sends every store below
+            for (auto write : {Write::BACK, Write::THROUGH}) {
+                MemoryHierarchy h;
+                h.add_level("L1", {std::make_shared<LRUCache>(1024, block, 2)}, 1, Sharing::PRIVATE,
+                            Inclusion::NINE, write);
+                h.add_level("L2", {std::make_shared<LRUCache>(8*1024, block, 4)}, 10);
+                for (Addr i = 0; i < 100; i++) h.store((i % 4) * block);
+                assert(h.level(0).bytes_written == (write == Write::BACK ? 0 : 100*block));
+            }
+            // Two banks index the same sets as one cache twice the size
+            {
+                MemoryHierarchy banked, single;
+                banked.add_level("L1", {std::make_shared<LRUCache>(1024, block, 2)}, 1);
+                banked.add_level("L2", {std::make_shared<LRUCache>(8*1024, block, 4),
+                                        std::make_shared<LRUCache>(8*1024, block, 4)}, 10, Sharing::BANKED);
+                single.add_level("L1", {std::make_shared<LRUCache>(1024, block, 2)}, 1);
+                single.add_level("L2", {std::make_shared<LRUCache>(16*1024, block, 4)}, 10);
+                for (Addr i = 0; i < 20000; i++) {
+                    Addr addr = (i * 2654435761u) % (64*1024);
+                    banked.load(addr);
+                    single.load(addr);
+                }
+                assert(banked.level(1).hits == single.level(1).hits);
+                assert(banked.cycles() == single.cycles());
+            }
+            // Private L1s per core over a shared L2; streaming gets DRAM row hits
+            {
+                auto h = std::make_shared<MemoryHierarchy>(DRAM(8, 2048, 40, 100, 16.0));
+                h->add_level("L1", {std::make_shared<LRUCache>(4*1024, block, 4),
+                                    std::make_shared<LRUCache>(4*1024, block, 4)}, 4);
+                h->add_level("L2", {std::make_shared<LRUCache>(64*1024, block, 8),
+                                    std::make_shared<LRUCache>(64*1024, block, 8)}, 20,
+                             Sharing::BANKED, Inclusion::INCLUSIVE);
+                auto p0 = Port(h, 0), p1 = Port(h, 1);
+                for (Addr i = 0; i < 1 << 16; i++) {
+                    p0->load_multi(0x100000 + i * 4, 4);
+                    p1->load_multi(0x900800 + i * 4, 4); // next bank over
+                }
+                assert(h->level(0).misses == 2 * (1 << 16) * 4 / block);
+                assert(h->dram().row_hits() > h->dram().row_misses());
+                std::cout << h->stats_str() << std::endl;
+            }
+            // VectorWithCache attached through a port
+            {
+                auto h = std::make_shared<MemoryHierarchy>();
+                h->add_level("L1", {std::make_shared<LRUCache>(1024, block, 2)}, 4);
+                VectorWithCache<int> v(nullptr, Port(h));
+                v.data().resize(1024);
+                for (size_t i = 0; i < v.size(); i++) v.set(i, v.get(i) + 1);
+                assert(h->references() == 2 * 1024);
+                auto first = reinterpret_cast<Addr>(&v.data().front()) / block;
+                auto last  = reinterpret_cast<Addr>(&v.data().back()) / block;
+                assert(h->level(0).misses == last - first + 1);
+            }
+            // Bad configurations
+            {
+                bool thrown = false;
+                MemoryHierarchy h;
+                try {
+                    h.add_level("L1", {std::make_shared<LRUCache>(1024, 64, 2)}, 1);
+                    h.add_level("L2", {std::make_shared<LRUCache>(1024, 32, 2)}, 1);
+                } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+            }
+            return 0;
+        }
+    }
+}
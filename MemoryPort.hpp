@@ -0,0 +1,38 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * Sink for the load/store stream of an instrumented container,
+         * for models other than a single Cache (traces, hierarchies).
+         */
+        class MemoryPort {
+        public:
+            using Addr = intptr_t;
+            using Ptr  = std::shared_ptr<MemoryPort>;
+
+            virtual ~MemoryPort() {}
+
+            virtual void load_multi(Addr addr, Addr sz) = 0;
+            virtual void store_multi(Addr addr, Addr sz) = 0;
+
+            /**
+             * n back-to-back references to the block holding addr, such as a
+             * run of elements within one block. Ports that can't account
+             * for them in bulk replay them one at a time.
+             */
+            virtual void load_repeat(Addr addr, Addr n)  { while (n-- > 0) load_multi(addr, 1); }
+            virtual void store_repeat(Addr addr, Addr n) { while (n-- > 0) store_multi(addr, 1); }
+
+            /* block granularity callers may coalesce at; 1 means don't */
+            virtual Addr block_size() const { return 1; }
+
+            /* name an address range for per-region stats, where the model keeps them */
+            virtual void set_region(const std::string &name, Addr begin, Addr end) {}
+        };
+    }
+}
@@ -0,0 +1,379 @@
+#pragma once
+#include <Cache.hpp>
+#include <MemoryPort.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * On-disk layout of a memory trace: a fixed header followed by one
+         * LEB128 varint per access, holding zigzag(block - previous block)
+         * shifted left once with the store bit in bit 0. Streaming and
+         * neighbor accesses take a single byte.
+         */
+        struct TraceHeader {
+            enum : uint32_t { MAGIC = 0x31525447 }; // "GTR1"
+            uint32_t magic;
+            uint32_t reserved;
+            uint64_t block_size;
+            uint64_t records;
+        };
+
+        /**
+         * Records the load/store stream Cache would see, at block granularity,
+         * into a trace file for later replay against many caches.
+         */
+        class TraceWriter final : public MemoryPort {
+        public:
+            using Addr = Cache::Addr;
+            using Ptr  = std::shared_ptr<TraceWriter>;
+
+            TraceWriter(const std::string &file_name, Addr block_size) :
+                _file_name(file_name),
+                _ofs(file_name, std::ios::binary | std::ios::trunc),
+                _block_size(block_size),
+                _last(0),
+                _records(0) {
+                if (!_ofs)
+                    throw std::runtime_error("Failed to open '" + file_name + "': " + strerror(errno));
+                write_header();
+                _buf.reserve(BUFFER);
+            }
+
+            /* write errors are dropped here; call close() to see them */
+            ~TraceWriter() {
+                try { close(); } catch (...) {}
+            }
+
+            /* primary api, same as Cache */
+            void load(Addr addr) { record(addr / _block_size, false); }
+            void load_multi(Addr addr, Addr sz) override { record_multi(addr, sz, false); }
+            void store(Addr addr) { record(addr / _block_size, true); }
+            void store_multi(Addr addr, Addr sz) override { record_multi(addr, sz, true); }
+
+            /* flush buffered records and finalize the header */
+            void close() {
+                if (!_ofs.is_open()) return;
+                flush();
+                _ofs.seekp(0);
+                write_header();
+                _ofs.close();
+            }
+
+            Addr block_size() const override { return _block_size; }
+            int64_t records() const { return _records; }
+            const std::string & file_name() const { return _file_name; }
+
+        private:
+            enum : size_t { BUFFER = 1 << 20 };
+
+            void write_header() {
+                TraceHeader h;
+                h.magic = TraceHeader::MAGIC;
+                h.reserved = 0;
+                h.block_size = _block_size;
+                h.records = _records;
+                _ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            }
+
+            void flush() {
+                _ofs.write(reinterpret_cast<const char*>(_buf.data()), _buf.size());
+                if (!_ofs)
+                    throw std::runtime_error("Failed to write '" + _file_name + "'");
+                _buf.clear();
+            }
+
+            void record_multi(Addr addr, Addr sz, bool store) {
+                Addr first = addr / _block_size;
+                Addr last  = (addr + sz - 1) / _block_size;
+                for (Addr block = first; block <= last; block++)
+                    record(block, store);
+            }
+
+            void record(Addr block, bool store) {
+                int64_t delta = block - _last;
+                uint64_t v = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+                v = (v << 1) | store;
+                while (v >= 0x80) {
+                    _buf.push_back(static_cast<uint8_t>(v) | 0x80);
+                    v >>= 7;
+                }
+                _buf.push_back(static_cast<uint8_t>(v));
+                _last = block;
+                _records++;
+                if (_buf.size() >= BUFFER) flush();
+            }
+
+            std::string _file_name;
+            std::ofstream _ofs;
+            Addr _block_size;
+            Addr _last;
+            int64_t _records;
+            std::vector<uint8_t> _buf;
+        };
+
+        /**
+         * Read-only mapping of a trace file. Decoding keeps no state in the
+         * reader, so any number of threads may walk the same mapping.
+         */
+        class TraceReader {
+        public:
+            using Addr = Cache::Addr;
+
+            explicit TraceReader(const std::string &file_name) :
+                _file_name(file_name),
+                _map(nullptr),
+                _bytes(0) {
+                int fd = ::open(file_name.c_str(), O_RDONLY);
+                if (fd < 0)
+                    throw std::runtime_error("Failed to open '" + file_name + "': " + strerror(errno));
+                struct stat st;
+                if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TraceHeader)) {
+                    ::close(fd);
+                    throw std::runtime_error("'" + file_name + "' is not a memory trace");
+                }
+                _bytes = st.st_size;
+                void *map = mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (map == MAP_FAILED)
+                    throw std::runtime_error("Failed to map '" + file_name + "': " + strerror(errno));
+                _map = static_cast<const uint8_t*>(map);
+                madvise(map, _bytes, MADV_SEQUENTIAL);
+
+                std::memcpy(&_header, _map, sizeof(_header));
+                if (_header.magic != TraceHeader::MAGIC || _header.block_size == 0) {
+                    munmap(map, _bytes);
+                    throw std::runtime_error("'" + file_name + "' is not a memory trace");
+                }
+            }
+
+            ~TraceReader() {
+                if (_map) munmap(const_cast<uint8_t*>(_map), _bytes);
+            }
+
+            TraceReader(const TraceReader &) = delete;
+            TraceReader & operator=(const TraceReader &) = delete;
+
+            Addr block_size() const { return _header.block_size; }
+            int64_t records() const { return _header.records; }
+            size_t bytes() const { return _bytes; }
+
+            /* call f(addr, store) for each record in order */
+            template <typename F>
+            void for_each(F f) const {
+                const uint8_t *p   = _map + sizeof(TraceHeader);
+                const uint8_t *end = _map + _bytes;
+                Addr block = 0;
+                for (uint64_t r = 0; r < _header.records; r++) {
+                    uint64_t v = 0;
+                    int shift = 0;
+                    do {
+                        if (p == end)
+                            throw std::runtime_error("'" + _file_name + "' is truncated");
+                        v |= static_cast<uint64_t>(*p & 0x7f) << shift;
+                        shift += 7;
+                    } while (*p++ & 0x80);
+                    bool store = v & 1;
+                    v >>= 1;
+                    block += static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+                    f(block * block_size(), store);
+                }
+            }
+
+            /* replay every record through cache */
+            template <typename C>
+            void replay(C &cache) const {
+                for_each([&cache](Addr addr, bool store) {
+                        if (store) cache.store(addr);
+                        else       cache.load(addr);
+                    });
+            }
+
+        private:
+            std::string _file_name;
+            TraceHeader _header;
+            const uint8_t *_map;
+            size_t _bytes;
+        };
+
+        /**
+         * Replay one trace into each cache, caches handed out to threads.
+         * Each cache sees the full trace in order, so results match an online
+         * run whenever the cache block size is the trace block size.
+         * An error in any thread (e.g. a truncated trace) stops the hand-out
+         * and is rethrown here once all threads have joined.
+         */
+        inline void ReplayTrace(const TraceReader &trace, const std::vector<Cache::Ptr> &caches,
+                                int threads = std::thread::hardware_concurrency()) {
+            std::atomic<size_t> next(0);
+            int n = std::min<size_t>(std::max(threads, 1), caches.size());
+            std::vector<std::exception_ptr> errors(n);
+            auto work = [&](int t) {
+                try {
+                    for (size_t c = next++; c < caches.size(); c = next++)
+                        trace.replay(*caches[c]);
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                    next = caches.size();
+                }
+            };
+            std::vector<std::thread> workers;
+            for (int t = 1; t < n; t++)
+                workers.emplace_back(work, t);
+            work(0);
+            for (auto &w : workers) w.join();
+            for (auto &e : errors)
+                if (e) std::rethrow_exception(e);
+        }
+
+        inline void ReplayTrace(const std::string &file_name, const std::vector<Cache::Ptr> &caches,
+                                int threads = std::thread::hardware_concurrency()) {
+            TraceReader trace(file_name);
+            ReplayTrace(trace, caches, threads);
+        }
+
+        /**
+         * A unique file in $TMPDIR (or /tmp), created with mkstemp and
+         * removed when this goes out of scope, for tests that write
+         * traces.
+         */
+        class TemporaryFile {
+        public:
+            explicit TemporaryFile(const std::string &prefix) {
+                const char *dir = getenv("TMPDIR");
+                std::string pattern = std::string(dir && *dir ? dir : "/tmp") + "/" + prefix + ".XXXXXX";
+                std::vector<char> name(pattern.begin(), pattern.end());
+                name.push_back('\0');
+                int fd = mkstemp(name.data());
+                if (fd == -1)
+                    throw std::runtime_error("Failed to create '" + pattern + "': " + strerror(errno));
+                ::close(fd);
+                _name = name.data();
+            }
+
+            ~TemporaryFile() { unlink(_name.c_str()); }
+
+            TemporaryFile(const TemporaryFile &) = delete;
+            TemporaryFile & operator=(const TemporaryFile &) = delete;
+
+            const std::string & name() const { return _name; }
+
+        private:
+            std::string _name;
+        };
+
+        class MemoryTrace {
+        public:
+            static int Test(int argc, char *argv[]) {
+                using Addr = Cache::Addr;
+                TemporaryFile file("memory_trace");
+                const std::string &file_name = file.name();
+                Addr block = 32;
+
+                // forward, backward, far jumps and unaligned spans
+                std::vector<std::pair<Addr,Addr>> accesses;
+                std::default_random_engine gen;
+                std::uniform_int_distribution<Addr> gather(0, Addr(1) << 32);
+                for (Addr i = 0; i < 100000; i++) {
+                    switch (i % 4) {
+                    case 0: accesses.push_back({0x1000 + i * 4, 4}); break;
+                    case 1: accesses.push_back({gather(gen), 8}); break;
+                    case 2: accesses.push_back({0x200000 - i * 12, 12}); break;
+                    default: accesses.push_back({0x300000 + (i % 4096) * 4, 4}); break;
+                    }
+                }
+
+                // online
+                std::vector<Cache::Ptr> online = {
+                    std::make_shared<LRUCache>(4*1024, block, 4),
+                    std::make_shared<SRRIPCache>(16*1024, block, 8),
+                    std::make_shared<FIFOCache>(32*1024, block, 2),
+                    std::make_shared<TreePLRUCache>(64*1024, block, 16),
+                };
+                std::vector<Cache::Ptr> replayed = {
+                    std::make_shared<LRUCache>(4*1024, block, 4),
+                    std::make_shared<SRRIPCache>(16*1024, block, 8),
+                    std::make_shared<FIFOCache>(32*1024, block, 2),
+                    std::make_shared<TreePLRUCache>(64*1024, block, 16),
+                };
+
+                // record
+                {
+                    TraceWriter writer(file_name, block);
+                    for (size_t i = 0; i < accesses.size(); i++) {
+                        bool store = i % 3 == 0;
+                        for (auto &c : online) {
+                            if (store) c->store_multi(accesses[i].first, accesses[i].second);
+                            else       c->load_multi(accesses[i].first, accesses[i].second);
+                        }
+                        if (store) writer.store_multi(accesses[i].first, accesses[i].second);
+                        else       writer.load_multi(accesses[i].first, accesses[i].second);
+                    }
+                    writer.close();
+                    std::cout << writer.records() << " records" << std::endl;
+                }
+
+                TraceReader trace(file_name);
+                std::cout << trace.bytes() << " bytes, "
+                          << static_cast<double>(trace.bytes()) / trace.records() << " bytes/record"
+                          << std::endl;
+
+                ReplayTrace(trace, replayed, 4);
+                for (size_t c = 0; c < online.size(); c++) {
+                    std::cout << replayed[c]->parameters_csv() << ": " << replayed[c]->stats_csv() << std::endl;
+                    assert(online[c]->stats_csv() == replayed[c]->stats_csv());
+                }
+
+                // a truncated trace fails the replay, not the process
+                {
+                    if (truncate(file_name.c_str(), trace.bytes() / 2) != 0)
+                        throw std::runtime_error("Failed to truncate '" + file_name + "': " + strerror(errno));
+                    TraceReader cut(file_name);
+                    bool thrown = false;
+                    try { ReplayTrace(cut, replayed, 4); } catch (std::runtime_error &) { thrown = true; }
+                    assert(thrown);
+                }
+
+                // write errors throw from close(), and are dropped by the destructor
+                {
+                    bool thrown = false;
+                    TraceWriter full("/dev/full", block);
+                    for (Addr i = 0; i < 100000; i++) full.load(i * 4096);
+                    try { full.close(); } catch (std::runtime_error &) { thrown = true; }
+                    assert(thrown);
+
+                    TraceWriter dropped("/dev/full", block);
+                    for (Addr i = 0; i < 100000; i++) dropped.load(i * 4096);
+                }
+
+                // bad files are rejected
+                {
+                    std::ofstream(file_name, std::ios::binary) << "not a trace at all, no";
+                    bool thrown = false;
+                    try { TraceReader bad(file_name); } catch (std::runtime_error &) { thrown = true; }
+                    assert(thrown);
+                }
+                return 0;
+            }
+        };
+    }
+}
@@ -0,0 +1,536 @@
+#pragma once
+#include <Graph.hpp>
+#include <PullRelaxation.hpp>
+#include <PerfCounters.hpp>
+#include <MemoryFootprint.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cassert>
+
+namespace graph_tools {
+
+    /**
+     * PageRank by power iteration over a Graph, with the accumulation of
+     * contributions (rank / out-degree) done in one of four modes:
+     *
+     * PULL:         each vertex sums over its in-edges, read from the
+     *               cached transpose; threads never share a write.
+     * PUSH_ATOMIC:  each source adds to its out-neighbors' sums with a
+     *               compare-and-swap. With more than one thread the adds
+     *               land in whatever order the threads reach them, so
+     *               ranks can differ between runs in the last bits.
+     * PUSH_PRIVATE: each thread pushes into its own copy of the sums,
+     *               which are then reduced.
+     * BLOCKED:      propagation blocking; sources append their value to
+     *               per-thread bins, one bin per bin_bytes of the sum
+     *               array, and each bin is then accumulated into a slice
+     *               of the sums that stays in cache. The graph is static,
+     *               so the bins' destinations are recorded once and each
+     *               iteration only writes values.
+     *
+     * Dangling vertices spread their rank uniformly. Iterations stop when
+     * the L1 change in rank falls below tolerance. The dense update of
+     * rank, L1 delta and next contribution uses PullRelaxation's ISAs.
+     * Sources and destinations are split across threads in ranges of
+     * roughly equal edge count, and run on threads-1 workers started
+     * with the engine plus the calling thread. Except for PUSH_ATOMIC, every mode sums
+     * in an order fixed by the graph and thread count, so repeated runs
+     * give identical ranks.
+     */
+    class PageRank {
+    public:
+        using NodeID = Graph::NodeID;
+        using ISA    = PullRelaxation::ISA;
+        enum class Mode { PULL, PUSH_ATOMIC, PUSH_PRIVATE, BLOCKED };
+
+        static const char *ModeName(Mode mode) {
+            switch (mode) {
+            case Mode::PUSH_ATOMIC:  return "push atomic";
+            case Mode::PUSH_PRIVATE: return "push private";
+            case Mode::BLOCKED:      return "blocked";
+            default:                 return "pull";
+            }
+        }
+
+        PageRank(const Graph::Ptr &g,
+                 int threads = std::thread::hardware_concurrency(),
+                 ISA isa = PullRelaxation::Detect(),
+                 int64_t bin_bytes = 256 << 10) :
+            _g(g),
+            _threads(std::max(threads, 1)),
+            _isa(isa),
+            _bin_shift(0),
+            _mode(Mode::PULL),
+            _iterations(0),
+            _delta(0) {
+            if (bin_bytes < static_cast<int64_t>(sizeof(float)))
+                throw std::invalid_argument("PageRank: bin_bytes must hold at least one rank");
+            while ((static_cast<int64_t>(sizeof(float)) << (_bin_shift + 1)) <= bin_bytes)
+                _bin_shift++;
+
+            NodeID n = g->num_nodes();
+            _inv_degree.resize(n);
+            for (NodeID v = 0; v < n; v++) {
+                _inv_degree[v] = g->degree(v) ? 1.0f / g->degree(v) : 0.0f;
+                if (!g->degree(v)) _dangling.push_back(v);
+            }
+            _push_bounds = Split(*g, _threads);
+            for (int t = 0; t <= _threads; t++)
+                _vertex_bounds.push_back(static_cast<NodeID>(static_cast<int64_t>(n) * t / _threads));
+
+            for (int t = 1; t < _threads; t++)
+                _workers.emplace_back(&PageRank::work, this, t);
+        }
+
+        ~PageRank() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _start.notify_all();
+            for (auto &w : _workers) w.join();
+        }
+
+        PageRank(const PageRank &) = delete;
+        PageRank & operator=(const PageRank &) = delete;
+
+        /**
+         * Iterates until the L1 change in rank is below tolerance or
+         * max_iterations is reached; returns the iterations run.
+         */
+        int run(Mode mode, float damping = 0.85f, double tolerance = 1e-4, int max_iterations = 100) {
+            if (!(damping >= 0 && damping < 1))
+                throw std::invalid_argument("PageRank: damping must be in [0,1)");
+            prepare(mode);
+
+            NodeID n = _g->num_nodes();
+            _rank.assign(n, 1.0f / n);
+            _contrib.resize(n);
+            _sum.resize(n);
+            for (NodeID v = 0; v < n; v++) _contrib[v] = _rank[v] * _inv_degree[v];
+            double dangling = dangling_sum();
+
+            _mode = mode;
+            _iterations = 0;
+            _delta = 0;
+            while (_iterations < max_iterations) {
+                PerfScope scope("pagerank iteration", _iterations);
+                accumulate(mode);
+                float base = static_cast<float>((1 - damping) / n + damping * dangling / n);
+                _delta = update(base, damping);
+                dangling = dangling_sum();
+                _iterations++;
+                if (_delta < tolerance) break;
+            }
+            return _iterations;
+        }
+
+        const std::vector<float> & rank() const { return _rank; }
+        int iterations() const { return _iterations; }
+        double delta() const { return _delta; }
+        int threads() const { return _threads; }
+        ISA isa() const { return _isa; }
+        int64_t bin_width() const { return int64_t(1) << _bin_shift; }
+        int64_t bins() const { return (static_cast<int64_t>(_g->num_nodes()) + bin_width() - 1) >> _bin_shift; }
+
+        /* bytes this engine owns; the graph and its transpose are shared */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("rank", MemoryFootprint::Bytes(_rank));
+            f.add("contribution", MemoryFootprint::Bytes(_contrib));
+            f.add("sum", MemoryFootprint::Bytes(_sum));
+            f.add("inverse degree", MemoryFootprint::Bytes(_inv_degree));
+            f.add("dangling", MemoryFootprint::Bytes(_dangling));
+            int64_t priv = 0, bins = 0;
+            for (const std::vector<float> &p : _private) priv += MemoryFootprint::Bytes(p);
+            for (const Bin &b : _bins) bins += MemoryFootprint::Bytes(b.dst) + MemoryFootprint::Bytes(b.value);
+            if (priv) f.add("private sums", priv);
+            if (bins) f.add("bins", bins);
+            return f;
+        }
+
+        /* stats api */
+        std::string stats_str() const {
+            double total = 0;
+            for (float r : _rank) total += r;
+            std::stringstream ss;
+            ss << "mode:                  " << ModeName(_mode) << "\n";
+            ss << "isa:                   " << PullRelaxation::ISAName(_isa) << "\n";
+            ss << "threads:               " << _threads << "\n";
+            if (_mode == Mode::BLOCKED)
+                ss << "bins:                  " << bins() << " x " << bin_width() << " vertices\n";
+            ss << "iterations:            " << _iterations << "\n";
+            ss << "l1 delta:              " << _delta << "\n";
+            ss << "rank sum:              " << total << "\n";
+            ss << "traversed edges:       " << static_cast<int64_t>(_iterations) * _g->num_edges() << "\n";
+            return ss.str();
+        }
+
+        static int Test(int argc, char *argv[]);
+
+    private:
+        /* one thread's pairs for one range of destinations */
+        struct Bin {
+            std::vector<NodeID> dst;
+            std::vector<float>  value;
+        };
+
+        /* [begin, end) vertex ranges of roughly equal edge count */
+        static std::vector<NodeID> Split(const Graph &g, int threads) {
+            auto &offs = g.get_offsets();
+            std::vector<NodeID> bounds = {0};
+            for (int t = 1; t < threads; t++) {
+                NodeID target = static_cast<NodeID>(static_cast<double>(g.num_edges()) * t / threads);
+                NodeID v = std::lower_bound(offs.begin(), offs.end(), target) - offs.begin();
+                bounds.push_back(std::max(v, bounds.back()));
+            }
+            bounds.push_back(g.num_nodes());
+            return bounds;
+        }
+
+        /* f(thread, begin, end) on each of the _threads ranges, the first on this thread */
+        template <typename F>
+        void parallel(const std::vector<NodeID> &bounds, F f) {
+            std::function<void(int)> job = [&](int t) { f(t, bounds[t], bounds[t+1]); };
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _job = &job;
+                _pending = _workers.size();
+                _generation++;
+            }
+            _start.notify_all();
+            job(0);
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done.wait(lock, [&]() { return _pending == 0; });
+            }
+        }
+
+        /* worker t runs its range of each parallel() call until destruction */
+        void work(int t) {
+            uint64_t seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _start.wait(lock, [&]() { return _stop || _generation != seen; });
+                    if (_stop) return;
+                    seen = _generation;
+                }
+                (*_job)(t);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (--_pending == 0) _done.notify_one();
+                }
+            }
+        }
+
+        /* build what mode needs on first use */
+        void prepare(Mode mode) {
+            switch (mode) {
+            case Mode::PULL:
+                if (!_rg) {
+                    _rg = _g->transposed();
+                    _pull_bounds = Split(*_rg, _threads);
+                }
+                break;
+            case Mode::PUSH_PRIVATE:
+                _private.resize(_threads);
+                for (auto &p : _private) p.resize(_g->num_nodes());
+                break;
+            case Mode::BLOCKED:
+                if (_bins.empty()) {
+                    _bins.resize(static_cast<size_t>(_threads) * bins());
+                    parallel(_push_bounds, [&](int t, NodeID begin, NodeID end) {
+                            Bin *mine = &_bins[static_cast<size_t>(t) * bins()];
+                            for (NodeID src = begin; src < end; src++)
+                                for (NodeID dst : _g->neighbors(src))
+                                    mine[dst >> _bin_shift].dst.push_back(dst);
+                            for (int64_t b = 0; b < bins(); b++)
+                                mine[b].value.resize(mine[b].dst.size());
+                        });
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        /* _sum[v] = sum of _contrib over v's in-edges */
+        void accumulate(Mode mode) {
+            const float *contrib = _contrib.data();
+            float *sum = _sum.data();
+            switch (mode) {
+            case Mode::PULL:
+                parallel(_pull_bounds, [&](int, NodeID begin, NodeID end) {
+                        for (NodeID dst = begin; dst < end; dst++) {
+                            float s = 0;
+                            for (NodeID src : _rg->neighbors(dst)) s += contrib[src];
+                            sum[dst] = s;
+                        }
+                    });
+                break;
+            case Mode::PUSH_ATOMIC:
+                std::fill(_sum.begin(), _sum.end(), 0.0f);
+                parallel(_push_bounds, [&](int, NodeID begin, NodeID end) {
+                        for (NodeID src = begin; src < end; src++)
+                            for (NodeID dst : _g->neighbors(src)) AtomicAdd(&sum[dst], contrib[src]);
+                    });
+                break;
+            case Mode::PUSH_PRIVATE:
+                parallel(_push_bounds, [&](int t, NodeID begin, NodeID end) {
+                        std::vector<float> &mine = _private[t];
+                        std::fill(mine.begin(), mine.end(), 0.0f);
+                        for (NodeID src = begin; src < end; src++)
+                            for (NodeID dst : _g->neighbors(src)) mine[dst] += contrib[src];
+                    });
+                parallel(_vertex_bounds, [&](int, NodeID begin, NodeID end) {
+                        for (NodeID v = begin; v < end; v++) {
+                            float s = 0;
+                            for (const std::vector<float> &p : _private) s += p[v];
+                            sum[v] = s;
+                        }
+                    });
+                break;
+            case Mode::BLOCKED:
+                // bin: values land in the same order the destinations were recorded
+                parallel(_push_bounds, [&](int t, NodeID begin, NodeID end) {
+                        Bin *mine = &_bins[static_cast<size_t>(t) * bins()];
+                        std::vector<size_t> cursor(bins(), 0);
+                        for (NodeID src = begin; src < end; src++)
+                            for (NodeID dst : _g->neighbors(src)) {
+                                int64_t b = dst >> _bin_shift;
+                                mine[b].value[cursor[b]++] = contrib[src];
+                            }
+                    });
+                // accumulate: each thread owns whole bins, so whole slices of sum
+                parallel(bin_bounds(), [&](int, NodeID begin, NodeID end) {
+                        for (NodeID b = begin; b < end; b++) {
+                            int64_t lo = static_cast<int64_t>(b) << _bin_shift;
+                            int64_t hi = std::min<int64_t>(lo + bin_width(), _g->num_nodes());
+                            std::fill(sum + lo, sum + hi, 0.0f);
+                            for (int t = 0; t < _threads; t++) {
+                                const Bin &bin = _bins[static_cast<size_t>(t) * bins() + b];
+                                for (size_t i = 0; i < bin.dst.size(); i++) sum[bin.dst[i]] += bin.value[i];
+                            }
+                        }
+                    });
+                break;
+            }
+        }
+
+        std::vector<NodeID> bin_bounds() const {
+            std::vector<NodeID> bounds;
+            for (int t = 0; t <= _threads; t++)
+                bounds.push_back(static_cast<NodeID>(bins() * t / _threads));
+            return bounds;
+        }
+
+        static void AtomicAdd(float *p, float v) {
+            float old, want;
+            __atomic_load(p, &old, __ATOMIC_RELAXED);
+            do {
+                want = old + v;
+            } while (!__atomic_compare_exchange(p, &old, &want, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        }
+
+        /* rank = base + damping*sum, contrib = rank/degree; returns the L1 change */
+        double update(float base, float damping) {
+            std::vector<double> delta(_threads, 0);
+            parallel(_vertex_bounds, [&](int t, NodeID begin, NodeID end) {
+                    switch (_isa) {
+#ifdef PULL_RELAXATION_X86
+                    case ISA::AVX512: delta[t] = update_avx512(begin, end, base, damping); break;
+                    case ISA::AVX2:   delta[t] = update_avx2(begin, end, base, damping); break;
+#endif
+                    default:          delta[t] = update_scalar(begin, end, base, damping); break;
+                    }
+                });
+            double total = 0;
+            for (double d : delta) total += d;
+            return total;
+        }
+
+        double update_scalar(NodeID begin, NodeID end, float base, float damping) {
+            const float *sum = _sum.data(), *inv = _inv_degree.data();
+            float *rank = _rank.data(), *contrib = _contrib.data();
+            double delta = 0;
+            for (NodeID v = begin; v < end; v++) {
+                float r = base + damping * sum[v];
+                delta += std::fabs(r - rank[v]);
+                rank[v] = r;
+                contrib[v] = r * inv[v];
+            }
+            return delta;
+        }
+
+#ifdef PULL_RELAXATION_X86
+        __attribute__((target("avx2")))
+        double update_avx2(NodeID begin, NodeID end, float base, float damping) {
+            const float *sum = _sum.data(), *inv = _inv_degree.data();
+            float *rank = _rank.data(), *contrib = _contrib.data();
+            const __m256 vbase = _mm256_set1_ps(base), vdamp = _mm256_set1_ps(damping);
+            const __m256 sign  = _mm256_set1_ps(-0.0f);
+            __m256d acc = _mm256_setzero_pd();
+            NodeID v = begin;
+            for (; v + 8 <= end; v += 8) {
+                __m256 r = _mm256_add_ps(vbase, _mm256_mul_ps(vdamp, _mm256_loadu_ps(&sum[v])));
+                __m256 d = _mm256_andnot_ps(sign, _mm256_sub_ps(r, _mm256_loadu_ps(&rank[v])));
+                acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_castps256_ps128(d)));
+                acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)));
+                _mm256_storeu_ps(&rank[v], r);
+                _mm256_storeu_ps(&contrib[v], _mm256_mul_ps(r, _mm256_loadu_ps(&inv[v])));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + update_scalar(v, end, base, damping);
+        }
+
+        __attribute__((target("avx512f")))
+        double update_avx512(NodeID begin, NodeID end, float base, float damping) {
+            const float *sum = _sum.data(), *inv = _inv_degree.data();
+            float *rank = _rank.data(), *contrib = _contrib.data();
+            const __m512 vbase = _mm512_set1_ps(base), vdamp = _mm512_set1_ps(damping);
+            __m512d acc = _mm512_setzero_pd();
+            NodeID v = begin;
+            for (; v + 16 <= end; v += 16) {
+                __m512 r = _mm512_add_ps(vbase, _mm512_mul_ps(vdamp, _mm512_loadu_ps(&sum[v])));
+                __m512 d = _mm512_abs_ps(_mm512_sub_ps(r, _mm512_loadu_ps(&rank[v])));
+                // widen both halves to double; maskz, so no undefined source
+                __m512d dd = _mm512_castps_pd(d);
+                __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, dd, 0));
+                __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, dd, 1));
+                acc = _mm512_add_pd(acc, _mm512_maskz_cvtps_pd(0xFF, lo));
+                acc = _mm512_add_pd(acc, _mm512_maskz_cvtps_pd(0xFF, hi));
+                _mm512_storeu_ps(&rank[v], r);
+                _mm512_storeu_ps(&contrib[v], _mm512_mul_ps(r, _mm512_loadu_ps(&inv[v])));
+            }
+            double lanes[8];
+            _mm512_storeu_pd(lanes, acc);
+            double total = 0;
+            for (double l : lanes) total += l;
+            return total + update_scalar(v, end, base, damping);
+        }
+#endif
+
+        /* in vertex order, so every mode and thread count sees the same value */
+        double dangling_sum() const {
+            double s = 0;
+            for (NodeID v : _dangling) s += _rank[v];
+            return s;
+        }
+
+        Graph::Ptr _g;
+        Graph::Ptr _rg; // transpose, for PULL
+        int _threads;
+        ISA _isa;
+        int _bin_shift;
+        std::vector<float>  _rank;
+        std::vector<float>  _contrib;
+        std::vector<float>  _sum;
+        std::vector<float>  _inv_degree;
+        std::vector<NodeID> _dangling;
+        std::vector<NodeID> _push_bounds;
+        std::vector<NodeID> _pull_bounds;
+        std::vector<NodeID> _vertex_bounds;
+        std::vector<std::vector<float>> _private; // PUSH_PRIVATE, per thread
+        std::vector<Bin> _bins;                   // BLOCKED, thread-major
+        Mode _mode;
+        int _iterations;
+        double _delta;
+
+        // hand-off between parallel() and the workers, guarded by _mutex
+        std::mutex _mutex;
+        std::condition_variable _start;
+        std::condition_variable _done;
+        uint64_t _generation = 0;
+        size_t _pending = 0;
+        bool _stop = false;
+        const std::function<void(int)> *_job = nullptr;
+        std::vector<std::thread> _workers;
+    };
+
+    inline int PageRank::Test(int argc, char *argv[]) {
+        // A cycle with a dangling tail: 0->1->2->0, 2->3
+        {
+            auto g = std::make_shared<Graph>();
+            g->get_offsets()   = {0, 1, 2, 4};
+            g->get_degrees()   = {1, 1, 2, 0};
+            g->get_neighbors() = {1, 2, 0, 3};
+            PageRank pr(g, 2);
+            pr.run(Mode::PULL, 0.85f, 1e-7, 1000);
+            double total = 0;
+            for (float r : pr.rank()) total += r;
+            assert(std::fabs(total - 1) < 1e-5);
+            assert(pr.rank()[3] > 0 && pr.rank()[2] > pr.rank()[3]);
+        }
+
+        // Every mode, thread count and ISA agrees with a double precision reference
+        auto g = std::make_shared<const Graph>(Graph::Generate(10, 10<<10));
+        NodeID n = g->num_nodes();
+        const double damping = 0.85;
+        std::vector<double> ref(n, 1.0 / n);
+        for (int it = 0; it < 200; it++) {
+            double dangling = 0;
+            std::vector<double> next(n, 0);
+            for (NodeID v = 0; v < n; v++) {
+                if (!g->degree(v)) dangling += ref[v];
+                for (NodeID dst : g->neighbors(v)) next[dst] += ref[v] / g->degree(v);
+            }
+            for (NodeID v = 0; v < n; v++)
+                next[v] = (1 - damping) / n + damping * (next[v] + dangling / n);
+            ref.swap(next);
+        }
+
+        std::vector<ISA> isas = {ISA::SCALAR};
+        if (PullRelaxation::Detect() != ISA::SCALAR) isas.push_back(ISA::AVX2);
+        if (PullRelaxation::Detect() == ISA::AVX512) isas.push_back(ISA::AVX512);
+
+        for (Mode mode : {Mode::PULL, Mode::PUSH_ATOMIC, Mode::PUSH_PRIVATE, Mode::BLOCKED}) {
+            for (int threads : {1, 4}) {
+                for (ISA isa : isas) {
+                    // small bins, so BLOCKED spreads a Small graph over several
+                    PageRank pr(g, threads, isa, 1 << 10);
+                    pr.run(mode, damping, 1e-6);
+                    double l1 = 0;
+                    for (NodeID v = 0; v < n; v++) l1 += std::fabs(pr.rank()[v] - ref[v]);
+                    std::cout << ModeName(mode) << ", " << threads << " threads, "
+                              << PullRelaxation::ISAName(isa) << ": " << pr.iterations()
+                              << " iterations, l1 error " << l1 << std::endl;
+                    assert(pr.iterations() < 100);
+                    assert(pr.delta() < 1e-6);
+                    assert(l1 < 1e-4);
+                    if (mode == Mode::BLOCKED) assert(pr.bins() == (n + 255) / 256);
+
+                    // repeatable, except atomic pushes from several threads,
+                    // which are only held to the reference above
+                    if (mode != Mode::PUSH_ATOMIC || threads == 1) {
+                        PageRank again(g, threads, isa, 1 << 10);
+                        again.run(mode, damping, 1e-6);
+                        assert(again.rank() == pr.rank());
+                    }
+                }
+            }
+        }
+
+        PageRank pr(g, 4);
+        pr.run(Mode::BLOCKED);
+        std::cout << pr.stats_str() << pr.footprint().stats_str();
+
+        bool threw = false;
+        try { pr.run(Mode::PULL, 1.0f); } catch (std::invalid_argument &) { threw = true; }
+        assert(threw);
+        threw = false;
+        try { PageRank bad(g, 1, ISA::SCALAR, 0); } catch (std::invalid_argument &) { threw = true; }
+        assert(threw);
+        return 0;
+    }
+}
@@ -0,0 +1,347 @@
+#pragma once
+#include <array>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <stdint.h>
+#include <cassert>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace graph_tools {
+
+    /* hardware events sampled around a scope */
+    enum class PerfEvent { CYCLES, INSTRUCTIONS, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, COUNT };
+
+    inline const char * PerfEventName(PerfEvent e) {
+        switch (e) {
+        case PerfEvent::CYCLES:        return "cycles";
+        case PerfEvent::INSTRUCTIONS:  return "instructions";
+        case PerfEvent::LLC_MISSES:    return "llc misses";
+        case PerfEvent::DTLB_MISSES:   return "dtlb misses";
+        case PerfEvent::BRANCH_MISSES: return "branch misses";
+        default:                       return "unknown";
+        }
+    }
+
+    /**
+     * Hardware counters for the calling thread, opened with
+     * perf_event_open(2). Each event is opened on its own, so one the
+     * kernel or CPU doesn't offer (or a container forbids) reads as -1
+     * without taking the others down. Counts are user-space only, which
+     * is what perf_event_paranoid <= 2 allows, and are scaled up if the
+     * kernel multiplexed the counter.
+     */
+    class PerfCounters {
+    public:
+        enum : int { EVENTS = static_cast<int>(PerfEvent::COUNT) };
+        using Values = std::array<int64_t, EVENTS>;
+
+        PerfCounters() {
+            _fds.fill(-1);
+#ifdef __linux__
+            for (int e = 0; e < EVENTS; e++) {
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                Config(static_cast<PerfEvent>(e), attr);
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+                if (fd < 0) {
+                    if (_error.empty()) _error = std::string(PerfEventName(static_cast<PerfEvent>(e))) + ": " + strerror(errno);
+                } else {
+                    _fds[e] = static_cast<int>(fd);
+                }
+            }
+#else
+            _error = "perf_event_open is linux only";
+#endif
+        }
+
+        ~PerfCounters() {
+#ifdef __linux__
+            for (int fd : _fds) if (fd >= 0) close(fd);
+#endif
+        }
+
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters & operator=(const PerfCounters &) = delete;
+
+        bool available(PerfEvent e) const { return _fds[static_cast<int>(e)] >= 0; }
+        bool any_available() const {
+            for (int fd : _fds) if (fd >= 0) return true;
+            return false;
+        }
+
+        /* why the first unavailable event failed to open; empty if none did */
+        const std::string & error() const { return _error; }
+
+        /* running totals since the counters were opened; -1 if unavailable */
+        Values read() const {
+            Values v;
+            v.fill(-1);
+#ifdef __linux__
+            for (int e = 0; e < EVENTS; e++) {
+                uint64_t buf[3]; // value, time enabled, time running
+                if (_fds[e] < 0 || ::read(_fds[e], buf, sizeof(buf)) != sizeof(buf)) continue;
+                if (buf[2] == 0) { v[e] = 0; continue; }
+                v[e] = static_cast<int64_t>(buf[2] < buf[1] ? static_cast<double>(buf[0]) * buf[1] / buf[2] : buf[0]);
+            }
+#endif
+            return v;
+        }
+
+        /* this thread's counters, opened on first use */
+        static PerfCounters & ThisThread() {
+            static thread_local PerfCounters counters;
+            return counters;
+        }
+
+        static int Test(int argc, char *argv[]);
+
+    private:
+#ifdef __linux__
+        static void Config(PerfEvent e, perf_event_attr &attr) {
+            auto cache = [](uint64_t c, uint64_t op, uint64_t result) { return c | (op << 8) | (result << 16); };
+            switch (e) {
+            case PerfEvent::CYCLES:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case PerfEvent::INSTRUCTIONS:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case PerfEvent::LLC_MISSES:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+            case PerfEvent::DTLB_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS);
+                break;
+            case PerfEvent::BRANCH_MISSES:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            default:
+                break;
+            }
+        }
+#endif
+        std::array<int, EVENTS> _fds;
+        std::string _error;
+    };
+
+    /**
+     * Counts accumulated per named scope. Scopes are inclusive: a level
+     * inside a traversal counts toward both. Recording is thread safe;
+     * each thread's scopes count only that thread's work.
+     *
+     * The global profile is what the library's own scopes (graph builds,
+     * transposes, BFS levels, Dijkstra sweeps) report to. It is off
+     * unless GRAPH_TOOLS_PERF is set in the environment or enable() is
+     * called, and a disabled scope costs one load.
+     */
+    class PerfProfile {
+    public:
+        using Values = PerfCounters::Values;
+
+        struct Entry {
+            int64_t calls;
+            Values  counts;
+        };
+
+        PerfProfile(bool enabled = false) : _enabled(enabled) {}
+
+        static PerfProfile & Global() {
+            static PerfProfile profile(EnvEnabled());
+            return profile;
+        }
+
+        bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+        void enable(bool on = true) { _enabled.store(on, std::memory_order_relaxed); }
+
+        void record(const std::string &scope, const Values &delta) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _entries.find(scope);
+            if (it == _entries.end()) {
+                Entry e;
+                e.calls = 0;
+                e.counts.fill(0);
+                it = _entries.insert({scope, e}).first;
+            }
+            Entry &e = it->second;
+            e.calls++;
+            for (int i = 0; i < PerfCounters::EVENTS; i++)
+                e.counts[i] = (delta[i] < 0 || e.counts[i] < 0) ? -1 : e.counts[i] + delta[i];
+        }
+
+        void reset() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries.clear();
+        }
+
+        std::map<std::string, Entry> entries() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _entries;
+        }
+
+        /* stats api */
+        std::string stats_csv_header() const {
+            std::stringstream ss;
+            ss << "scope,calls,";
+            for (int i = 0; i < PerfCounters::EVENTS; i++) {
+                std::string name = PerfEventName(static_cast<PerfEvent>(i));
+                for (char &c : name) if (c == ' ') c = '_';
+                ss << name << ",";
+            }
+            ss << "ipc,";
+            return ss.str();
+        }
+
+        /* one row per scope; unavailable counts are left empty */
+        std::string stats_csv() const {
+            std::stringstream ss;
+            for (auto &kv : entries()) {
+                ss << kv.first << "," << kv.second.calls << ",";
+                for (int64_t c : kv.second.counts) {
+                    if (c >= 0) ss << c;
+                    ss << ",";
+                }
+                double ipc = IPC(kv.second);
+                if (ipc >= 0) ss << ipc;
+                ss << ",\n";
+            }
+            return ss.str();
+        }
+
+        std::string stats_str() const {
+            std::stringstream ss;
+            const PerfCounters &counters = PerfCounters::ThisThread();
+            if (!counters.any_available())
+                ss << "perf counters:         unavailable (" << counters.error() << ")\n";
+            for (auto &kv : entries()) {
+                ss << "scope:                 " << kv.first << "\n";
+                ss << "calls:                 " << kv.second.calls << "\n";
+                for (int i = 0; i < PerfCounters::EVENTS; i++) {
+                    std::string label = std::string(PerfEventName(static_cast<PerfEvent>(i))) + ":";
+                    ss << label << std::string(23 - label.size(), ' ');
+                    if (kv.second.counts[i] >= 0) ss << kv.second.counts[i] << "\n";
+                    else                          ss << "n/a\n";
+                }
+                double ipc = IPC(kv.second);
+                if (ipc >= 0) ss << "ipc:                   " << ipc << "\n";
+            }
+            return ss.str();
+        }
+
+    private:
+        static bool EnvEnabled() {
+            const char *v = std::getenv("GRAPH_TOOLS_PERF");
+            return v && *v && std::string(v) != "0";
+        }
+
+        static double IPC(const Entry &e) {
+            int64_t cyc = e.counts[static_cast<int>(PerfEvent::CYCLES)];
+            int64_t ins = e.counts[static_cast<int>(PerfEvent::INSTRUCTIONS)];
+            return (cyc > 0 && ins >= 0) ? static_cast<double>(ins) / cyc : -1.0;
+        }
+
+        std::atomic<bool> _enabled;
+        mutable std::mutex _mutex;
+        std::map<std::string, Entry> _entries;
+    };
+
+    /**
+     * Samples this thread's counters over its lifetime and records the
+     * difference under name. The (name, index) form names per-round scopes
+     * like "bfs level[3]", and only formats the name when enabled.
+     */
+    class PerfScope {
+    public:
+        PerfScope(const char *name, PerfProfile &profile = PerfProfile::Global()) :
+            _profile(profile.enabled() ? &profile : nullptr) {
+            if (_profile) start(name);
+        }
+
+        PerfScope(const char *name, int64_t index, PerfProfile &profile = PerfProfile::Global()) :
+            _profile(profile.enabled() ? &profile : nullptr) {
+            if (_profile) start(std::string(name) + "[" + std::to_string(index) + "]");
+        }
+
+        ~PerfScope() {
+            if (!_profile) return;
+            PerfCounters::Values end = PerfCounters::ThisThread().read();
+            for (int i = 0; i < PerfCounters::EVENTS; i++)
+                end[i] = (end[i] < 0 || _start[i] < 0) ? -1 : end[i] - _start[i];
+            _profile->record(_name, end);
+        }
+
+        PerfScope(const PerfScope &) = delete;
+        PerfScope & operator=(const PerfScope &) = delete;
+
+    private:
+        void start(const std::string &name) {
+            _name = name;
+            _start = PerfCounters::ThisThread().read();
+        }
+
+        PerfProfile *_profile;
+        std::string _name;
+        PerfCounters::Values _start;
+    };
+
+    inline int PerfCounters::Test(int argc, char *argv[]) {
+        PerfCounters &counters = PerfCounters::ThisThread();
+        std::cout << "perf counters: "
+                  << (counters.any_available() ? "available" : "unavailable (" + counters.error() + ")")
+                  << std::endl;
+
+        volatile double x = 0;
+        auto work = [&x](int n) { for (int i = 0; i < n; i++) x = x + i * 0.5; };
+
+        // A disabled profile records nothing
+        {
+            PerfProfile off;
+            { PerfScope scope("off", off); work(1000); }
+            assert(off.entries().empty());
+        }
+
+        // Scopes accumulate calls and counts, with or without counters
+        PerfProfile profile(true);
+        for (int i = 0; i < 3; i++) {
+            PerfScope scope("small", profile);
+            work(10000);
+        }
+        {
+            PerfScope scope("large", profile);
+            work(1000000);
+        }
+        for (int i = 0; i < 2; i++) {
+            PerfScope scope("round", i, profile);
+            work(1000);
+        }
+        auto entries = profile.entries();
+        assert(entries.size() == 4);
+        assert(entries["small"].calls == 3);
+        assert(entries["large"].calls == 1);
+        assert(entries.count("round[0]") && entries.count("round[1]"));
+
+        const int ins = static_cast<int>(PerfEvent::INSTRUCTIONS);
+        if (counters.available(PerfEvent::INSTRUCTIONS)) {
+            assert(entries["large"].counts[ins] > entries["small"].counts[ins]);
+        } else {
+            assert(entries["large"].counts[ins] == -1);
+        }
+
+        std::cout << profile.stats_str();
+        std::cout << profile.stats_csv_header() << "\n" << profile.stats_csv() << std::endl;
+        profile.reset();
+        assert(profile.entries().empty());
+        return 0;
+    }
+}
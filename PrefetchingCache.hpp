@@ -0,0 +1,373 @@
+#pragma once
+#include <Cache.hpp>
+#include <MemoryPort.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <random>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * Watches demand accesses and proposes addresses to prefetch.
+         * stream tags an access with its source (a PC, or which array a
+         * kernel is walking); 0 when the caller doesn't say.
+         */
+        class Prefetcher {
+        public:
+            using Addr = Cache::Addr;
+            using Ptr  = std::shared_ptr<Prefetcher>;
+
+            enum class Event {
+                MISS,
+                HIT,
+                PREFETCH_HIT, // first demand hit on a prefetched block
+            };
+
+            virtual ~Prefetcher() {}
+
+            /* append addresses to prefetch to out */
+            virtual void observe(Addr addr, int stream, Event event, std::vector<Addr> &out) = 0;
+            virtual std::string name() const = 0;
+        };
+
+        /**
+         * Tagged next-line: on a miss, or the first use of a block it
+         * prefetched, fetch the next degree blocks.
+         */
+        class NextLinePrefetcher : public Prefetcher {
+        public:
+            NextLinePrefetcher(Addr block_size, int degree = 1) :
+                _block_size(block_size),
+                _degree(degree) {}
+
+            void observe(Addr addr, int stream, Event event, std::vector<Addr> &out) override {
+                if (event == Event::HIT) return;
+                Addr block = addr - addr % _block_size;
+                for (int d = 1; d <= _degree; d++)
+                    out.push_back(block + d * _block_size);
+            }
+
+            std::string name() const override { return "next-line"; }
+
+        private:
+            Addr _block_size;
+            int _degree;
+        };
+
+        /**
+         * Per-stream stride detector with a 2-bit confidence counter.
+         * Once a stride repeats, prefetches lookahead strides ahead,
+         * at most once per target block.
+         */
+        class StridePrefetcher : public Prefetcher {
+        public:
+            StridePrefetcher(Addr block_size, int lookahead = 16) :
+                _block_size(block_size),
+                _lookahead(lookahead) {}
+
+            void observe(Addr addr, int stream, Event event, std::vector<Addr> &out) override {
+                auto ins = _table.insert({stream, Entry{addr, 0, 0, -1}});
+                Entry &e = ins.first->second;
+                if (ins.second) return;
+
+                Addr stride = addr - e.last;
+                if (stride == 0) return;
+                if (stride == e.stride) {
+                    if (e.confidence < 3) e.confidence++;
+                } else {
+                    if (e.confidence > 0) e.confidence--;
+                    else e.stride = stride;
+                }
+                e.last = addr;
+
+                if (e.confidence >= 2) {
+                    Addr target = addr + e.stride * _lookahead;
+                    Addr block  = target - target % _block_size;
+                    if (block != e.issued) {
+                        out.push_back(block);
+                        e.issued = block;
+                    }
+                }
+            }
+
+            std::string name() const override { return "stride"; }
+
+        private:
+            struct Entry {
+                Addr last;
+                Addr stride;
+                int confidence;
+                Addr issued; // last block prefetched, to skip repeats
+            };
+
+            Addr _block_size;
+            int _lookahead;
+            std::unordered_map<int, Entry> _table;
+        };
+
+        /**
+         * Indirect prefetcher for a[b[i]] patterns: when the index array b
+         * is read at i, reads b[i+lookahead] from memory and prefetches
+         * the element of a it names. The arrays are the host arrays the
+         * model's addresses come from, e.g. a graph's neighbors and a
+         * distance vector.
+         */
+        template <typename Index>
+        class IndirectPrefetcher : public Prefetcher {
+        public:
+            IndirectPrefetcher(const Index *index_begin, const Index *index_end,
+                               Addr data_base, Addr data_elem_size,
+                               int lookahead = 16) :
+                _begin(index_begin),
+                _end(index_end),
+                _data_base(data_base),
+                _elem_size(data_elem_size),
+                _lookahead(lookahead) {}
+
+            void observe(Addr addr, int stream, Event event, std::vector<Addr> &out) override {
+                Addr begin = reinterpret_cast<Addr>(_begin);
+                Addr end   = reinterpret_cast<Addr>(_end);
+                if (addr < begin || addr >= end) return;
+                Addr i = (addr - begin) / sizeof(Index) + _lookahead;
+                if (i >= _end - _begin) return;
+                out.push_back(_data_base + static_cast<Addr>(_begin[i]) * _elem_size);
+            }
+
+            std::string name() const override { return "indirect"; }
+
+        private:
+            const Index *_begin;
+            const Index *_end;
+            Addr _data_base;
+            Addr _elem_size;
+            int _lookahead;
+        };
+
+        /**
+         * Cache front end that runs prefetchers on the demand stream.
+         * Prefetches are installed without counting as demand hits or
+         * misses, so the cache's own stats stay demand-only.
+         *   accuracy = useful prefetches / issued prefetches
+         *   coverage = useful prefetches / (useful + remaining demand misses)
+         * where a prefetch is useful if a demand access hits it before
+         * it is evicted. Prefetches of blocks already cached are dropped.
+         */
+        class PrefetchingCache final : public MemoryPort {
+        public:
+            using Ptr = std::shared_ptr<PrefetchingCache>;
+
+            struct Stats {
+                int64_t issued;
+                int64_t useful;
+                int64_t useless;   // evicted before use
+                int64_t redundant; // already cached
+            };
+
+            PrefetchingCache(const Cache::Ptr &cache,
+                             const std::vector<Prefetcher::Ptr> &prefetchers = {}) :
+                _cache(cache),
+                _prefetchers(prefetchers),
+                _stats(prefetchers.size(), Stats{0, 0, 0, 0}) {}
+
+            /* primary api, same as Cache plus a stream id */
+            void load(Addr addr, int stream = 0) { access(addr, false, stream); }
+            void load_multi(Addr addr, Addr sz, int stream) {
+                for_each_block(addr, sz, [=](Addr a) { access(a, false, stream); });
+            }
+            void load_multi(Addr addr, Addr sz) override { load_multi(addr, sz, 0); }
+
+            void store(Addr addr, int stream = 0) { access(addr, true, stream); }
+            void store_multi(Addr addr, Addr sz, int stream) {
+                for_each_block(addr, sz, [=](Addr a) { access(a, true, stream); });
+            }
+            void store_multi(Addr addr, Addr sz) override { store_multi(addr, sz, 0); }
+
+            /* a MemoryPort tagging accesses with stream, for VectorWithCache */
+            static MemoryPort::Ptr Stream(const Ptr &cache, int stream) {
+                return std::make_shared<StreamPort>(cache, stream);
+            }
+
+            Cache::CPtr cache() const { return _cache; }
+
+            /* stats api */
+            const Stats & stats(size_t p) const { return _stats.at(p); }
+
+            Stats total() const {
+                Stats t = {0, 0, 0, 0};
+                for (auto &s : _stats) {
+                    t.issued += s.issued;
+                    t.useful += s.useful;
+                    t.useless += s.useless;
+                    t.redundant += s.redundant;
+                }
+                return t;
+            }
+
+            double accuracy(const Stats &s) const {
+                return s.issued == 0 ? 0.0 : static_cast<double>(s.useful) / s.issued;
+            }
+
+            double coverage(const Stats &s) const {
+                int64_t would_miss = total().useful + _cache->sum_misses();
+                return would_miss == 0 ? 0.0 : static_cast<double>(s.useful) / would_miss;
+            }
+
+            std::string stats_str() const {
+                std::stringstream ss;
+                ss << "demand hits:           " << _cache->sum_hits() << "\n";
+                ss << "demand misses:         " << _cache->sum_misses() << "\n";
+                for (size_t p = 0; p < _prefetchers.size(); p++) {
+                    const Stats &s = _stats[p];
+                    ss << _prefetchers[p]->name() << ":\n";
+                    ss << "  issued:              " << s.issued << "\n";
+                    ss << "  useful:              " << s.useful << "\n";
+                    ss << "  useless:             " << s.useless << "\n";
+                    ss << "  redundant:           " << s.redundant << "\n";
+                    ss << "  accuracy:            " << accuracy(s) << "\n";
+                    ss << "  coverage:            " << coverage(s) << "\n";
+                }
+                return ss.str();
+            }
+
+            static int Test(int argc, char *argv[]);
+
+        private:
+            using Event = Prefetcher::Event;
+
+            class StreamPort final : public MemoryPort {
+            public:
+                StreamPort(const PrefetchingCache::Ptr &cache, int stream) : _cache(cache), _stream(stream) {}
+                void load_multi(Addr addr, Addr sz) override { _cache->load_multi(addr, sz, _stream); }
+                void store_multi(Addr addr, Addr sz) override { _cache->store_multi(addr, sz, _stream); }
+            private:
+                PrefetchingCache::Ptr _cache;
+                int _stream;
+            };
+
+            template <typename F>
+            void for_each_block(Addr addr, Addr sz, F f) const {
+                Addr block_size = _cache->block_size();
+                while (sz > 0) {
+                    f(addr);
+                    Addr step = block_size - addr % block_size;
+                    addr += step;
+                    sz   -= step;
+                }
+            }
+
+            Addr block_of(Addr addr) const { return addr / _cache->block_size(); }
+
+            void access(Addr addr, bool store, int stream) {
+                Cache::Outcome o = _cache->reference(addr, store);
+                Event event = o.hit ? Event::HIT : Event::MISS;
+                if (o.hit) {
+                    auto p = _pending.find(block_of(addr));
+                    if (p != _pending.end()) {
+                        _stats[p->second].useful++;
+                        _pending.erase(p);
+                        event = Event::PREFETCH_HIT;
+                    }
+                }
+                evicted(o);
+
+                for (size_t p = 0; p < _prefetchers.size(); p++) {
+                    _out.clear();
+                    _prefetchers[p]->observe(addr, stream, event, _out);
+                    for (Addr a : _out) prefetch(a, p);
+                }
+            }
+
+            void prefetch(Addr addr, size_t p) {
+                if (addr < 0) return;
+                if (_cache->contains(addr)) {
+                    _stats[p].redundant++;
+                    return;
+                }
+                _stats[p].issued++;
+                _pending[block_of(addr)] = p;
+                evicted(_cache->install(addr, false));
+            }
+
+            void evicted(const Cache::Outcome &o) {
+                if (o.victim == Cache::NONE) return;
+                auto p = _pending.find(block_of(o.victim));
+                if (p == _pending.end()) return;
+                _stats[p->second].useless++;
+                _pending.erase(p);
+            }
+
+            Cache::Ptr _cache;
+            std::vector<Prefetcher::Ptr> _prefetchers;
+            std::vector<Stats> _stats;
+            std::unordered_map<Addr, size_t> _pending; // prefetched, unused block -> prefetcher
+            std::vector<Addr> _out;
+        };
+
+        inline int PrefetchingCache::Test(int argc, char *argv[]) {
+            Addr block = 64;
+            auto make = [=]() { return std::make_shared<LRUCache>(32*1024, block, 8); };
+
+            // Next-line covers a sequential stream
+            {
+                PrefetchingCache none(make()), nl(make(), {std::make_shared<NextLinePrefetcher>(block, 2)});
+                for (Addr i = 0; i < 1 << 18; i++) {
+                    none.load_multi(0x100000 + i * 4, 4);
+                    nl.load_multi(0x100000 + i * 4, 4);
+                }
+                assert(nl.coverage(nl.stats(0)) > 0.99);
+                assert(nl.accuracy(nl.stats(0)) > 0.99);
+                assert(nl.cache()->sum_misses() < none.cache()->sum_misses() / 100);
+                assert(nl.total().useful + nl.cache()->sum_misses() == none.cache()->sum_misses());
+            }
+
+            // Stride per stream, next to a random stream it can't help
+            {
+                PrefetchingCache sp(make(), {std::make_shared<StridePrefetcher>(block, 8)});
+                std::default_random_engine gen;
+                std::uniform_int_distribution<Addr> gather(0, 1 << 20);
+                for (Addr i = 0; i < 1 << 16; i++) {
+                    sp.load(0x100000 + i * 3 * block, 1);
+                    sp.load(0x8000000 + gather(gen) * 4, 2);
+                }
+                assert(sp.stats(0).useful > (1 << 16) * 9 / 10);
+                assert(sp.accuracy(sp.stats(0)) > 0.9);
+                std::cout << "stride:\n" << sp.stats_str() << std::endl;
+            }
+
+            // Indirect: sum data[neighbors[e]] over a CSR edge list
+            {
+                std::default_random_engine gen;
+                std::uniform_int_distribution<uint32_t> vertex(0, (1 << 20) - 1);
+                std::vector<uint32_t> neighbors(1 << 18);
+                for (auto &n : neighbors) n = vertex(gen);
+                std::vector<float> data(1 << 20);
+
+                auto indirect = std::make_shared<IndirectPrefetcher<uint32_t>>(
+                    neighbors.data(), neighbors.data() + neighbors.size(),
+                    reinterpret_cast<Addr>(data.data()), sizeof(float));
+                auto stride = std::make_shared<StridePrefetcher>(block);
+                auto none = std::make_shared<PrefetchingCache>(make());
+                auto imp  = std::make_shared<PrefetchingCache>(make(), std::vector<Prefetcher::Ptr>{stride, indirect});
+
+                for (auto pc : {none, imp}) {
+                    auto edges = Stream(pc, 1), values = Stream(pc, 2);
+                    for (size_t e = 0; e < neighbors.size(); e++) {
+                        edges->load_multi(reinterpret_cast<Addr>(&neighbors[e]), sizeof(uint32_t));
+                        values->load_multi(reinterpret_cast<Addr>(&data[neighbors[e]]), sizeof(float));
+                    }
+                }
+                std::cout << "stride + indirect:\n" << imp->stats_str() << std::endl;
+                assert(imp->accuracy(imp->stats(1)) > 0.9);
+                assert(imp->coverage(imp->total()) > 0.9);
+                assert(imp->cache()->sum_misses() < none->cache()->sum_misses() / 10);
+            }
+            return 0;
+        }
+    }
+}
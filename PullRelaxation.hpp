@@ -0,0 +1,263 @@
+#pragma once
+#include <WGraph.hpp>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PULL_RELAXATION_X86
+#endif
+
+namespace graph_tools {
+
+    /**
+     * One Bellman-Ford sweep in pull order over a transposed WGraph:
+     * each dst reduces min(cur[src]+w) over its in-edges. Destinations
+     * are split across threads in ranges of roughly equal edge count.
+     * Sweeps read cur and write next (Jacobi style) so threads never
+     * race on a distance. The worker threads are started once, by the
+     * constructor, and wait between sweeps.
+     */
+    class PullRelaxation {
+    public:
+        enum class ISA { SCALAR, AVX2, AVX512 };
+
+        /* pick the widest kernel the running cpu supports */
+        static ISA Detect() {
+#ifdef PULL_RELAXATION_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return ISA::AVX512;
+            if (__builtin_cpu_supports("avx2"))    return ISA::AVX2;
+#endif
+            return ISA::SCALAR;
+        }
+
+        static const char *ISAName(ISA isa) {
+            switch (isa) {
+            case ISA::AVX512: return "avx512";
+            case ISA::AVX2:   return "avx2";
+            default:          return "scalar";
+            }
+        }
+
+        PullRelaxation(const WGraph &rg, int threads, ISA isa = Detect()) :
+            _rg(rg),
+            _isa(isa) {
+            threads = std::max(threads, 1);
+            auto &offs = rg.get_offsets();
+            // split on edge count
+            _bounds.push_back(0);
+            for (int t = 1; t < threads; t++) {
+                WGraph::NodeID target = static_cast<WGraph::NodeID>(
+                    static_cast<double>(rg.num_edges()) * t / threads);
+                WGraph::NodeID dst = std::lower_bound(offs.begin(), offs.end(), target) - offs.begin();
+                _bounds.push_back(std::max(dst, _bounds.back()));
+            }
+            _bounds.push_back(rg.num_nodes());
+
+            _changed.resize(threads, 0);
+            for (int t = 1; t < threads; t++)
+                _workers.emplace_back(&PullRelaxation::work, this, t);
+        }
+
+        ~PullRelaxation() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _start.notify_all();
+            for (auto &w : _workers) w.join();
+        }
+
+        PullRelaxation(const PullRelaxation &) = delete;
+        PullRelaxation & operator=(const PullRelaxation &) = delete;
+
+        /**
+         * next[dst] = min(cur[dst], min over in-edges of cur[src]+w),
+         * path[dst] = the src achieving it; returns true if any improved.
+         */
+        bool sweep(const std::vector<float> &cur, std::vector<float> &next, std::vector<int> &path) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _cur = &cur;
+                _next = &next;
+                _path = &path;
+                _pending = _workers.size();
+                _generation++;
+            }
+            _start.notify_all();
+            _changed[0] = relax(cur, next, path, _bounds[0], _bounds[1]);
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done.wait(lock, [&]() { return _pending == 0; });
+            }
+            return std::find(_changed.begin(), _changed.end(), 1) != _changed.end();
+        }
+
+        ISA isa() const { return _isa; }
+        int threads() const { return _bounds.size()-1; }
+
+    private:
+        /* worker t relaxes its range once per sweep until destruction */
+        void work(int t) {
+            uint64_t seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _start.wait(lock, [&]() { return _stop || _generation != seen; });
+                    if (_stop) return;
+                    seen = _generation;
+                }
+                _changed[t] = relax(*_cur, *_next, *_path, _bounds[t], _bounds[t+1]);
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (--_pending == 0) _done.notify_one();
+                }
+            }
+        }
+
+        bool relax(const std::vector<float> &cur, std::vector<float> &next, std::vector<int> &path,
+                   WGraph::NodeID begin, WGraph::NodeID end) const {
+            switch (_isa) {
+#ifdef PULL_RELAXATION_X86
+            case ISA::AVX512: return relax_avx512(cur.data(), next.data(), path.data(), begin, end);
+            case ISA::AVX2:   return relax_avx2(cur.data(), next.data(), path.data(), begin, end);
+#endif
+            default:          return relax_scalar(cur.data(), next.data(), path.data(), begin, end);
+            }
+        }
+
+        bool relax_scalar(const float *cur, float *next, int *path,
+                          WGraph::NodeID begin, WGraph::NodeID end) const {
+            auto offs = _rg.get_offsets().data();
+            auto degs = _rg.get_degrees().data();
+            auto neib = _rg.get_neighbors().data();
+            auto wgts = _rg.get_weights().data();
+            bool changed = false;
+            for (WGraph::NodeID dst = begin; dst < end; dst++) {
+                float best = cur[dst];
+                int   from = path[dst];
+                for (WGraph::NodeID e = offs[dst]; e < offs[dst]+degs[dst]; e++) {
+                    float d = cur[neib[e]] + wgts[e];
+                    if (d < best) {
+                        best = d;
+                        from = neib[e];
+                    }
+                }
+                changed |= best < cur[dst];
+                next[dst] = best;
+                path[dst] = from;
+            }
+            return changed;
+        }
+
+#ifdef PULL_RELAXATION_X86
+        /* first in-edge in [e, e+n) with cur[src]+w == d */
+        WGraph::NodeID find_src(const float *cur, const WGraph::NodeID *neib, const float *wgts,
+                                WGraph::NodeID e, WGraph::NodeID n, float d) const {
+            for (; n > 0; e++, n--)
+                if (cur[neib[e]] + wgts[e] == d) return neib[e];
+            return 0;
+        }
+
+        __attribute__((target("avx2")))
+        bool relax_avx2(const float *cur, float *next, int *path,
+                        WGraph::NodeID begin, WGraph::NodeID end) const {
+            auto offs = _rg.get_offsets().data();
+            auto degs = _rg.get_degrees().data();
+            auto neib = _rg.get_neighbors().data();
+            auto wgts = _rg.get_weights().data();
+            const __m256  inf  = _mm256_set1_ps(INFINITY);
+            const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            bool changed = false;
+            for (WGraph::NodeID dst = begin; dst < end; dst++) {
+                float best = cur[dst];
+                int   from = path[dst];
+                WGraph::NodeID e_n = offs[dst]+degs[dst];
+                for (WGraph::NodeID e = offs[dst]; e < e_n; e += 8) {
+                    WGraph::NodeID n = std::min<WGraph::NodeID>(8, e_n-e);
+                    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(n), lane);
+                    __m256i src  = _mm256_maskload_epi32(reinterpret_cast<const int*>(&neib[e]), mask);
+                    __m256  w    = _mm256_maskload_ps(&wgts[e], mask);
+                    __m256  d    = _mm256_mask_i32gather_ps(inf, cur, src, _mm256_castsi256_ps(mask), 4);
+                    d = _mm256_add_ps(d, w);
+                    // horizontal min
+                    __m256 m = _mm256_min_ps(d, _mm256_permute2f128_ps(d, d, 1));
+                    m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+                    m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+                    float chunk = _mm256_cvtss_f32(m);
+                    if (chunk < best) {
+                        best = chunk;
+                        from = find_src(cur, neib, wgts, e, n, chunk);
+                    }
+                }
+                changed |= best < cur[dst];
+                next[dst] = best;
+                path[dst] = from;
+            }
+            return changed;
+        }
+
+        __attribute__((target("avx512f")))
+        bool relax_avx512(const float *cur, float *next, int *path,
+                          WGraph::NodeID begin, WGraph::NodeID end) const {
+            auto offs = _rg.get_offsets().data();
+            auto degs = _rg.get_degrees().data();
+            auto neib = _rg.get_neighbors().data();
+            auto wgts = _rg.get_weights().data();
+            const __m512 inf = _mm512_set1_ps(INFINITY);
+            // masked forms throughout: the unmasked ones read an
+            // undefined register, which gcc warns about
+            const __mmask16 all = 0xFFFF;
+            bool changed = false;
+            for (WGraph::NodeID dst = begin; dst < end; dst++) {
+                float best = cur[dst];
+                int   from = path[dst];
+                WGraph::NodeID e_n = offs[dst]+degs[dst];
+                for (WGraph::NodeID e = offs[dst]; e < e_n; e += 16) {
+                    WGraph::NodeID n = std::min<WGraph::NodeID>(16, e_n-e);
+                    __mmask16 mask = static_cast<__mmask16>((1u << n) - 1);
+                    __m512i src = _mm512_maskz_loadu_epi32(mask, &neib[e]);
+                    __m512  w   = _mm512_maskz_loadu_ps(mask, &wgts[e]);
+                    __m512  d   = _mm512_mask_i32gather_ps(inf, mask, src, cur, 4);
+                    d = _mm512_mask_add_ps(inf, mask, d, w);
+                    // horizontal min
+                    __m512 m = _mm512_mask_min_ps(d, all, d, _mm512_mask_shuffle_f32x4(d, all, d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+                    m = _mm512_mask_min_ps(m, all, m, _mm512_mask_shuffle_f32x4(m, all, m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+                    m = _mm512_mask_min_ps(m, all, m, _mm512_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+                    m = _mm512_mask_min_ps(m, all, m, _mm512_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+                    float chunk = _mm512_cvtss_f32(m);
+                    if (chunk < best) {
+                        best = chunk;
+                        from = find_src(cur, neib, wgts, e, n, chunk);
+                    }
+                }
+                changed |= best < cur[dst];
+                next[dst] = best;
+                path[dst] = from;
+            }
+            return changed;
+        }
+#endif
+
+        const WGraph &_rg;
+        ISA _isa;
+        std::vector<WGraph::NodeID> _bounds;
+
+        // hand-off between sweep() and the workers, guarded by _mutex
+        std::mutex _mutex;
+        std::condition_variable _start;
+        std::condition_variable _done;
+        uint64_t _generation = 0;
+        size_t _pending = 0;
+        bool _stop = false;
+        const std::vector<float> *_cur = nullptr;
+        std::vector<float> *_next = nullptr;
+        std::vector<int>   *_path = nullptr;
+        std::vector<char> _changed; // one per thread, read after _done
+        std::vector<std::thread> _workers;
+    };
+}
@@ -0,0 +1,438 @@
+#pragma once
+#include <WGraph.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <queue>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+#include <cassert>
+
+namespace graph_tools {
+
+    /**
+     * WGraph with 16-bit fixed-point weights. Every weight is stored as
+     * q in [0, 65535] and means (base + q) * scale, with base an integer,
+     * so path lengths can be summed exactly in integer units of scale
+     * and only converted to float at the end. Weights must be
+     * non-negative, and base + q must fit in 32 bits, so a range that
+     * is very narrow relative to its offset (e.g. [1000, 1000.001]) is
+     * rejected with std::invalid_argument.
+     */
+    class QuantizedWGraph {
+    public:
+        using NodeID  = WGraph::NodeID;
+        using QWeight = uint16_t;
+        using IWeight = uint32_t; // base + q
+        using Ptr     = std::shared_ptr<const QuantizedWGraph>;
+
+        /* integer (dst, weight) arc */
+        struct IEdge {
+            NodeID  dst;
+            IWeight weight;
+        };
+
+        /* (dst, weight) views over the neighbor and quantized weight arrays */
+        template <typename Edge>
+        class BasicNeighborhood {
+        public:
+            class iterator {
+            public:
+                iterator(const QuantizedWGraph *g, NodeID e) : _g(g), _e(e) {}
+                Edge operator*() const { return _g->edge<Edge>(_e); }
+                iterator & operator++() { ++_e; return *this; }
+                bool operator!=(const iterator &other) const { return _e != other._e; }
+            private:
+                const QuantizedWGraph *_g;
+                NodeID _e;
+            };
+
+            BasicNeighborhood(const QuantizedWGraph *g, NodeID begin, NodeID end) :
+                _g(g), _begin(begin), _end(end) {}
+
+            Edge operator[](size_t i) const { return _g->edge<Edge>(_begin+i); }
+            NodeID size() const { return _end - _begin; }
+            iterator begin() const { return iterator(_g, _begin); }
+            iterator end()   const { return iterator(_g, _end);   }
+        private:
+            const QuantizedWGraph *_g;
+            NodeID _begin;
+            NodeID _end;
+        };
+
+        using WNeighborhood = BasicNeighborhood<WEdge>;
+        using INeighborhood = BasicNeighborhood<IEdge>;
+
+        QuantizedWGraph() : _scale(1.0), _base(0) {}
+        explicit QuantizedWGraph(const WGraph &wg) :
+            _offsets(wg.get_offsets()),
+            _degrees(wg.get_degrees()),
+            _neighbors(wg.get_neighbors()),
+            _scale(1.0),
+            _base(0) {
+            auto &wgts = wg.get_weights();
+            if (wgts.empty()) return;
+
+            auto mm = std::minmax_element(wgts.begin(), wgts.end());
+            double lo = *mm.first, hi = *mm.second;
+            if (lo < 0) {
+                std::stringstream ss;
+                ss << "QuantizedWGraph: weights must be non-negative, found " << lo;
+                throw std::invalid_argument(ss.str());
+            }
+            // one step of slack so rounding base down still fits hi in 16 bits
+            _scale = hi > lo ? (hi - lo) / (std::numeric_limits<QWeight>::max() - 1)
+                : (lo > 0 ? lo : 1.0);
+            double base = std::round(lo / _scale);
+            if (base > std::numeric_limits<IWeight>::max() - std::numeric_limits<QWeight>::max()) {
+                std::stringstream ss;
+                ss << "QuantizedWGraph: weights in [" << lo << ", " << hi << "] need a base of "
+                   << base << " steps, which does not fit in 32 bits";
+                throw std::invalid_argument(ss.str());
+            }
+            _base  = static_cast<IWeight>(base);
+
+            _qweights.reserve(wgts.size());
+            for (float w : wgts) {
+                double q = std::round(w / _scale) - _base;
+                q = std::min<double>(std::max(q, 0.0), std::numeric_limits<QWeight>::max());
+                _qweights.push_back(static_cast<QWeight>(q));
+            }
+        }
+
+        WNeighborhood wedges(NodeID v) const {
+            return WNeighborhood(this, _offsets[v], _offsets[v]+_degrees[v]);
+        }
+
+        INeighborhood iedges(NodeID v) const {
+            return INeighborhood(this, _offsets[v], _offsets[v]+_degrees[v]);
+        }
+
+        NodeID num_nodes() const { return _degrees.size(); }
+        NodeID num_vertices() const { return num_nodes(); }
+        NodeID num_edges() const { return _neighbors.size(); }
+        NodeID degree(NodeID v) const { return _degrees[v]; }
+        NodeID offset(NodeID v) const { return _offsets[v]; }
+
+        /* weight of arc e in integer units of scale() */
+        IWeight iweight(NodeID e) const { return _base + _qweights[e]; }
+        float   weight(NodeID e) const { return static_cast<float>(iweight(e) * _scale); }
+        double  scale() const { return _scale; }
+        IWeight base() const { return _base; }
+
+        /* convert a path length in units of scale() to float */
+        float to_float(uint64_t idist) const { return static_cast<float>(idist * _scale); }
+
+        QuantizedWGraph transpose() const {
+            QuantizedWGraph t;
+            t._scale = _scale;
+            t._base  = _base;
+            t._degrees.assign(num_nodes(), 0);
+            for (NodeID dst : _neighbors)
+                t._degrees[dst]++;
+
+            t._offsets.resize(num_nodes());
+            NodeID off = 0;
+            for (NodeID v = 0; v < num_nodes(); v++) {
+                t._offsets[v] = off;
+                off += t._degrees[v];
+            }
+
+            // sources are visited in order, so each in-list stays sorted by src
+            std::vector<NodeID> fill(t._offsets);
+            t._neighbors.resize(num_edges());
+            t._qweights.resize(num_edges());
+            for (NodeID src = 0; src < num_nodes(); src++) {
+                for (NodeID e = _offsets[src]; e < _offsets[src]+_degrees[src]; e++) {
+                    NodeID at = fill[_neighbors[e]]++;
+                    t._neighbors[at] = src;
+                    t._qweights[at]  = _qweights[e];
+                }
+            }
+
+            return t;
+        }
+
+        /**
+         * Transpose of this graph, built on first use and shared thereafter
+         */
+        Ptr transposed() const {
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) return t;
+            Ptr built = std::make_shared<const QuantizedWGraph>(transpose());
+            // another thread may have built it first; keep theirs
+            if (std::atomic_compare_exchange_strong(&_transposed, &t, built))
+                return built;
+            return t;
+        }
+
+        const std::vector<NodeID> & get_offsets()   const { return _offsets; }
+        const std::vector<NodeID> & get_degrees()   const { return _degrees; }
+        const std::vector<NodeID> & get_neighbors() const { return _neighbors; }
+        const std::vector<QWeight>& get_qweights()  const { return _qweights; }
+
+        /* bytes held by this graph, and by its cached transpose if built */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("offsets", MemoryFootprint::Bytes(_offsets));
+            f.add("degrees", MemoryFootprint::Bytes(_degrees));
+            f.add("neighbors", MemoryFootprint::Bytes(_neighbors));
+            f.add("qweights", MemoryFootprint::Bytes(_qweights));
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) f.add("transposed", t->footprint());
+            return f;
+        }
+
+        std::string to_string() const {
+            std::stringstream ss;
+            for (NodeID v = 0; v < num_nodes(); v++) {
+                ss << v << " : ";
+                for (WEdge e : wedges(v))
+                    ss << "(" << v << "," << e.dst << "," << e.weight << "), ";
+                ss << "\n";
+            }
+            return ss.str();
+        }
+
+        static int Test(int argc, char *argv[]);
+
+    private:
+        template <typename Edge>
+        Edge edge(NodeID e) const;
+
+        std::vector<NodeID>  _offsets;
+        std::vector<NodeID>  _degrees;
+        std::vector<NodeID>  _neighbors;
+        std::vector<QWeight> _qweights;
+        double  _scale;
+        IWeight _base;
+        mutable Ptr _transposed;
+    };
+
+    template <>
+    inline WEdge QuantizedWGraph::edge<WEdge>(NodeID e) const {
+        return {_neighbors[e], weight(e)};
+    }
+
+    template <>
+    inline QuantizedWGraph::IEdge QuantizedWGraph::edge<QuantizedWGraph::IEdge>(NodeID e) const {
+        return {_neighbors[e], iweight(e)};
+    }
+
+    /**
+     * Point-to-point Dijkstra on a QuantizedWGraph that sums weights as
+     * integers; distances are exact multiples of the graph's scale.
+     * Pass goal = -1 to settle every reachable vertex.
+     */
+    class QuantizedDijkstra {
+    public:
+        using IDistance = uint64_t;
+        static IDistance Unreached() { return std::numeric_limits<IDistance>::max(); }
+
+        QuantizedDijkstra(const QuantizedWGraph::Ptr &qg, int root, int goal = -1) :
+            _qg(qg),
+            _root(root),
+            _goal(goal),
+            _traversed_edges(0),
+            _int_compares(0),
+            _int_adds(0) {}
+
+        std::pair<std::vector<int>, std::vector<float>>
+        run() {
+            using Entry = std::pair<IDistance, int>;
+            _idistance.assign(_qg->num_nodes(), Unreached());
+            _path.assign(_qg->num_nodes(), -1);
+
+            _idistance[_root] = 0;
+            _path[_root] = _root;
+
+            std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+            queue.push({0, _root});
+
+            while (!queue.empty()) {
+                Entry top = queue.top();
+                queue.pop();
+                int src = top.second;
+                if (src == _goal)
+                    break;
+                _int_compares += 1;
+                if (top.first > _idistance[src])
+                    continue; // stale entry
+
+                for (QuantizedWGraph::IEdge e : _qg->iedges(src)) {
+                    IDistance d = top.first + e.weight;
+                    if (d < _idistance[e.dst]) {
+                        _idistance[e.dst] = d;
+                        _path[e.dst] = src;
+                        queue.push({d, static_cast<int>(e.dst)});
+                    }
+                    _int_adds += 1;
+                    _int_compares += 1;
+                    _traversed_edges += 1;
+                }
+            }
+
+            return {_path, distance()};
+        }
+
+        /* distances converted back to float */
+        std::vector<float> distance() const {
+            std::vector<float> d(_idistance.size());
+            for (size_t v = 0; v < d.size(); v++)
+                d[v] = _idistance[v] == Unreached() ? INFINITY : _qg->to_float(_idistance[v]);
+            return d;
+        }
+
+        std::vector<IDistance> & idistance() { return _idistance; }
+        std::vector<int>       & path() { return _path; }
+
+        /* bytes this search owns; the graph is shared and reports its own */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("idistance", MemoryFootprint::Bytes(_idistance));
+            f.add("path", MemoryFootprint::Bytes(_path));
+            return f;
+        }
+
+        std::string stats_str() const {
+            std::stringstream ss;
+            ss << "nodes:                 " << _qg->num_nodes() << "\n";
+            ss << "edges:                 " << _qg->num_edges() << "\n";
+            ss << "root:                  " << _root << "\n";
+            ss << "goal:                  " << _goal << "\n";
+            ss << "traversed edges:       " << _traversed_edges << "\n";
+            ss << "int compares:          " << _int_compares << "\n";
+            ss << "int adds:              " << _int_adds << "\n";
+            if (_goal != -1)
+                ss << "distance (root->goal): " << distance()[_goal] << "\n";
+            return ss.str();
+        }
+
+    private:
+        QuantizedWGraph::Ptr _qg;
+        int _root;
+        int _goal;
+        int64_t _traversed_edges;
+        int64_t _int_compares;
+        int64_t _int_adds;
+        std::vector<IDistance> _idistance;
+        std::vector<int>       _path;
+    };
+
+    /**
+     * Error of quantized distances against float reference distances,
+     * over vertices reachable in both.
+     */
+    struct QuantizationError {
+        double max_abs;
+        double mean_abs;
+        double max_rel;
+        int64_t compared;
+        int64_t reachability_mismatches;
+
+        static QuantizationError Compare(const std::vector<float> &reference,
+                                         const std::vector<float> &quantized) {
+            QuantizationError err = {0.0, 0.0, 0.0, 0, 0};
+            double sum = 0.0;
+            for (size_t v = 0; v < reference.size(); v++) {
+                if (std::isinf(reference[v]) != std::isinf(quantized[v])) {
+                    err.reachability_mismatches++;
+                    continue;
+                }
+                if (std::isinf(reference[v])) continue;
+                double abs = std::fabs(static_cast<double>(reference[v]) - quantized[v]);
+                err.max_abs = std::max(err.max_abs, abs);
+                if (reference[v] > 0)
+                    err.max_rel = std::max(err.max_rel, abs / reference[v]);
+                sum += abs;
+                err.compared++;
+            }
+            err.mean_abs = err.compared ? sum / err.compared : 0.0;
+            return err;
+        }
+
+        std::string string() const {
+            std::stringstream ss;
+            ss << "compared vertices:       " << compared << "\n";
+            ss << "reachability mismatches: " << reachability_mismatches << "\n";
+            ss << "max abs error:           " << max_abs << "\n";
+            ss << "mean abs error:          " << mean_abs << "\n";
+            ss << "max rel error:           " << max_rel << "\n";
+            return ss.str();
+        }
+    };
+}
+
+#include <Dijkstra.hpp>
+#include <FastDijkstra.hpp>
+
+namespace graph_tools {
+
+    inline int QuantizedWGraph::Test(int argc, char *argv[]) {
+        auto wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+        auto qg = std::make_shared<const QuantizedWGraph>(*wg);
+        std::cout << "scale = " << qg->scale() << ", base = " << qg->base() << std::endl;
+
+        // quantized weights are within half a step of the originals,
+        // plus the rounding of weight() back to float
+        for (NodeID e = 0; e < wg->num_edges(); e++) {
+            float w = wg->get_weights()[e];
+            assert(std::fabs(qg->weight(e) - w)
+                   <= 0.5 * qg->scale() + std::numeric_limits<float>::epsilon() * w);
+        }
+
+        // a narrow range far from zero can't be offset by a 32-bit base
+        {
+            WGraph narrow = WGraph::Uniform(10, 32);
+            for (float &w : narrow.get_weights()) w = 1000.0f;
+            narrow.get_weights()[0] = 1000.001f;
+            bool threw = false;
+            try { QuantizedWGraph q(narrow); } catch (std::invalid_argument &) { threw = true; }
+            assert(threw);
+        }
+
+        // negative weights are refused with their own message
+        {
+            WGraph negative = WGraph::Uniform(10, 32);
+            negative.get_weights()[3] = -0.5f;
+            std::string what;
+            try { QuantizedWGraph q(negative); } catch (std::invalid_argument &e) { what = e.what(); }
+            assert(what.find("non-negative") != std::string::npos);
+        }
+
+        Dijkstra reference(wg, 0);
+        reference.run();
+        int goal = reference.goal(5.0);
+
+        // float kernels run unchanged on the dequantized view
+        BasicDijkstra<QuantizedWGraph> qdijkstra(qg, 0);
+        qdijkstra.run();
+        BasicFastDijkstra<QuantizedWGraph> qfdijkstra(qg, 0, goal);
+        qfdijkstra.run();
+
+        // integer kernel
+        QuantizedDijkstra idijkstra(qg, 0);
+        idijkstra.run();
+
+        std::cout << "float kernel on quantized weights vs float weights:" << std::endl;
+        QuantizationError ferr = QuantizationError::Compare(reference.distance(), qdijkstra.distance());
+        std::cout << ferr.string() << std::endl;
+
+        std::cout << "integer kernel on quantized weights vs float weights:" << std::endl;
+        QuantizationError ierr = QuantizationError::Compare(reference.distance(), idijkstra.distance());
+        std::cout << ierr.string() << std::endl;
+
+        assert(ferr.reachability_mismatches == 0);
+        assert(ierr.reachability_mismatches == 0);
+        assert(ierr.max_rel < 1e-4);
+        assert(std::fabs(qfdijkstra.distance()[goal] - reference.distance()[goal]) < 1e-3);
+
+        std::cout << "weight bytes: " << wg->num_edges() * sizeof(float)
+                  << " -> " << qg->num_edges() * sizeof(QWeight) << std::endl;
+        return 0;
+    }
+}
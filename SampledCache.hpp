@@ -0,0 +1,297 @@
+#pragma once
+#include <Cache.hpp>
+#include <MemoryPort.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * Set-sampled simulation of a size/block_size/assoc cache of type C.
+         * Only one set in every sample_every is simulated; a reference to any
+         * other set costs one mask test. Sampled sets behave exactly as in the
+         * full cache, since a set's contents depend only on the blocks mapping
+         * to it, and the full cache's stats are extrapolated from them with a
+         * confidence interval over the per-set variation.
+         *
+         * Sets and sample_every must be powers of two, so that the sampled
+         * sets are those whose low set-index bits equal offset.
+         */
+        template <typename C>
+        class SampledCache final : public MemoryPort {
+        public:
+            using Ptr  = std::shared_ptr<SampledCache>;
+            using Set  = Cache::Set;
+
+            /* an extrapolated count and its confidence interval */
+            struct Estimate {
+                double value;
+                double low;
+                double high;
+            };
+
+            SampledCache(Addr size, Addr block_size, Addr assoc, Addr sample_every, Addr offset = 0) :
+                _sample_every(sample_every),
+                _sample(Check(size, block_size, assoc, sample_every, offset) / sample_every, block_size, assoc),
+                _sets(size / (block_size * assoc)),
+                _block_shift(Log2(block_size)),
+                _sample_shift(Log2(sample_every)),
+                _addr_mask((sample_every - 1) << _block_shift),
+                _addr_match(offset << _block_shift),
+                _stats(_sample.sets()),
+                _filtered(0) {
+            }
+
+            /* primary api, same as Cache */
+            void load(Addr addr) { if (sampled(addr)) reference(addr, false, 1); }
+            void load_multi(Addr addr, Addr sz) override {
+                for_each_block(addr, sz, [this](Addr a) { load(a); });
+            }
+
+            void store(Addr addr) { if (sampled(addr)) reference(addr, true, 1); }
+            void store_multi(Addr addr, Addr sz) override {
+                for_each_block(addr, sz, [this](Addr a) { store(a); });
+            }
+
+            void load_repeat(Addr addr, Addr n) override { if (sampled(addr)) reference(addr, false, n); }
+            void store_repeat(Addr addr, Addr n) override { if (sampled(addr)) reference(addr, true, n); }
+
+            Addr block_size() const override { return _sample.block_size(); }
+
+            /* geometry of the modeled (full) cache */
+            Addr size() const  { return _sets * assoc() * block_size(); }
+            Addr sets() const  { return _sets; }
+            Addr assoc() const { return _sample.assoc(); }
+            Addr sample_every() const { return _sample_every; }
+
+            /* the sampled sets as a cache of their own */
+            const C & sample() const { return _sample; }
+
+            /* block references skipped by the mask test */
+            int64_t filtered() const { return _filtered; }
+
+            /* extrapolated stats; z = 1.96 is a 95% interval */
+            Estimate hits(double z = 1.96) const    { return estimate(&Cache::Stats::hits, z); }
+            Estimate misses(double z = 1.96) const  { return estimate(&Cache::Stats::misses, z); }
+            Estimate flushes(double z = 1.96) const { return estimate(&Cache::Stats::flushes, z); }
+
+            /* compulsory misses extrapolate too, without an interval */
+            double compulsory_misses() const {
+                return static_cast<double>(_sample.compulsory_misses()) * _sample_every;
+            }
+
+            double miss_ratio() const {
+                double h = hits().value, m = misses().value;
+                return h + m > 0 ? m / (h + m) : 0.0;
+            }
+
+            /* stats api, same columns as Cache */
+            std::string stats_csv_header() const {
+                return _sample.stats_csv_header();
+            }
+
+            std::string stats_csv() const {
+                std::stringstream ss;
+                ss << static_cast<int64_t>(std::llround(hits().value)) << ",";
+                ss << static_cast<int64_t>(std::llround(misses().value)) << ",";
+                ss << static_cast<int64_t>(std::llround(compulsory_misses())) << ",";
+                ss << static_cast<int64_t>(std::llround(flushes().value)) << ",";
+                return ss.str();
+            }
+
+            std::string stats_str(double z = 1.96) const {
+                std::stringstream ss;
+                auto line = [&ss](const char *label, const Estimate &e) {
+                    ss << label << static_cast<int64_t>(std::llround(e.value))
+                       << " [" << static_cast<int64_t>(std::llround(e.low))
+                       << ", " << static_cast<int64_t>(std::llround(e.high)) << "]\n";
+                };
+                ss << "sampled sets:          " << _sample.sets() << " of " << _sets << "\n";
+                ss << "filtered references:   " << _filtered << "\n";
+                line("hits:                  ", hits(z));
+                line("misses:                ", misses(z));
+                line("flushes:               ", flushes(z));
+                ss << "miss ratio:            " << miss_ratio() << "\n";
+                return ss.str();
+            }
+
+            static int Test(int argc, char *argv[]);
+
+        private:
+            static Addr Check(Addr size, Addr block_size, Addr assoc, Addr sample_every, Addr offset) {
+                Addr sets = size / (block_size * assoc);
+                if (Log2(block_size) < 0 || Log2(sets) < 0 || Log2(sample_every) < 0)
+                    throw std::invalid_argument("SampledCache: block size, sets and sample_every must be powers of two");
+                if (sample_every > sets)
+                    throw std::invalid_argument("SampledCache: sample_every exceeds the number of sets");
+                if (offset < 0 || offset >= sample_every)
+                    throw std::invalid_argument("SampledCache: offset must be in [0, sample_every)");
+                return size;
+            }
+
+            static int Log2(Addr x) {
+                if (x <= 0 || (x & (x-1)) != 0) return -1;
+                int n = 0;
+                while ((Addr(1) << n) < x) n++;
+                return n;
+            }
+
+            bool sampled(Addr addr) {
+                if ((addr & _addr_mask) == _addr_match) return true;
+                _filtered++;
+                return false;
+            }
+
+            /* n back-to-back references to a sampled block */
+            void reference(Addr addr, bool store, Addr n) {
+                Addr block = addr >> _block_shift;
+                Addr local = (block >> _sample_shift) << _block_shift;
+                Cache::Stats &s = _stats[(block >> _sample_shift) & (_sample.sets() - 1)];
+                Cache::Outcome out = _sample.reference(local, store);
+                if (out.hit) s.hits++;
+                else         s.misses++;
+                if (out.dirty) s.flushes++;
+                if (n > 1) {
+                    _sample.load_repeat(local, n - 1);
+                    s.hits += n - 1;
+                }
+            }
+
+            template <typename F>
+            void for_each_block(Addr addr, Addr sz, F f) const {
+                Addr bs = block_size();
+                while (sz > 0) {
+                    f(addr);
+                    Addr step = bs - (addr & (bs - 1));
+                    addr += step;
+                    sz   -= step;
+                }
+            }
+
+            /**
+             * The total over all sets, from the systematic sample of every
+             * sample_every-th set starting at offset: sets * mean, with an
+             * interval computed as if the sample were simple random (with
+             * the finite population correction). That holds when set
+             * behavior is unrelated to the set index modulo sample_every;
+             * an access pattern strided in step with the sample (e.g. every
+             * sample_every-th block) is over- or under-represented, and the
+             * interval does not cover that bias. Compare a few offsets if in
+             * doubt.
+             */
+            Estimate estimate(int64_t Cache::Stats::*stat, double z) const {
+                double m = static_cast<double>(_stats.size());
+                double sum = 0, sumsq = 0;
+                for (const auto &s : _stats) {
+                    double x = static_cast<double>(s.*stat);
+                    sum += x;
+                    sumsq += x * x;
+                }
+                double total = sum * _sample_every;
+                if (_stats.size() < 2 || _sample_every == 1) return {total, total, total};
+                double mean = sum / m;
+                double var = std::max(0.0, (sumsq - m * mean * mean) / (m - 1));
+                double N = static_cast<double>(_sets);
+                double se = N * std::sqrt(var / m * (1.0 - m / N));
+                return {total, std::max(0.0, total - z * se), total + z * se};
+            }
+
+            Addr _sample_every;
+            C _sample;
+            Addr _sets;
+            int _block_shift;
+            int _sample_shift;
+            Addr _addr_mask;
+            Addr _addr_match;
+            std::vector<Cache::Stats> _stats; // per sampled set
+            int64_t _filtered;
+        };
+
+        using SampledLRUCache = SampledCache<LRUCache>;
+
+        template <typename C>
+        inline int SampledCache<C>::Test(int argc, char *argv[]) {
+            // a graph-like stream: sequential offsets and neighbors, gathers into a property array
+            std::vector<std::pair<Addr, bool>> trace;
+            std::default_random_engine gen;
+            std::uniform_int_distribution<Addr> vertex(0, (1 << 22) - 1);
+            for (Addr i = 0; i < 3000000; i++) {
+                switch (i % 4) {
+                case 0: trace.push_back({0x10000000 + (i / 4) * 4, false}); break;
+                case 1: trace.push_back({0x20000000 + (i / 2) * 4, false}); break;
+                case 2: trace.push_back({0x40000000 + vertex(gen) * 4, false}); break;
+                default: trace.push_back({0x40000000 + vertex(gen) * 4, true}); break;
+                }
+            }
+
+            Addr size = 4 << 20, block = 64, assoc = 16;
+            using clock = std::chrono::steady_clock;
+            C full(size, block, assoc);
+            auto t0 = clock::now();
+            for (auto &a : trace) {
+                if (a.second) full.store(a.first);
+                else          full.load(a.first);
+            }
+            auto t1 = clock::now();
+            double full_s = std::chrono::duration<double>(t1 - t0).count();
+
+            // Sampling every set is the full simulation
+            {
+                SampledCache exact(size, block, assoc, 1);
+                for (auto &a : trace) {
+                    if (a.second) exact.store(a.first);
+                    else          exact.load(a.first);
+                }
+                assert(exact.stats_csv() == full.stats_csv());
+                assert(exact.misses().low == exact.misses().high);
+                assert(exact.filtered() == 0);
+            }
+
+            // Sparser samples stay within their intervals, and get cheaper
+            for (Addr every : {8, 32, 128}) {
+                SampledCache sampled(size, block, assoc, every, every / 2);
+                auto t2 = clock::now();
+                for (auto &a : trace) {
+                    if (a.second) sampled.store(a.first);
+                    else          sampled.load(a.first);
+                }
+                auto t3 = clock::now();
+                double sampled_s = std::chrono::duration<double>(t3 - t2).count();
+
+                std::cout << "1/" << every << " of sets (" << full_s / sampled_s << "x faster):\n"
+                          << sampled.stats_str();
+                std::cout << "full misses:           " << full.sum_misses() << "\n" << std::endl;
+
+                auto m = sampled.misses();
+                auto h = sampled.hits();
+                auto f = sampled.flushes();
+                assert(m.low <= full.sum_misses() && full.sum_misses() <= m.high);
+                assert(h.low <= full.sum_hits() && full.sum_hits() <= h.high);
+                assert(f.low <= full.sum_flushes() && full.sum_flushes() <= f.high);
+                assert(std::fabs(sampled.miss_ratio() - double(full.sum_misses()) / trace.size()) < 0.02);
+                assert(sampled.filtered() + sampled.sample().sum_hits() + sampled.sample().sum_misses()
+                       == static_cast<int64_t>(trace.size()));
+            }
+
+            // Bad geometries are rejected
+            {
+                bool thrown = false;
+                try { SampledCache bad(size, block, assoc, 3); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+                thrown = false;
+                try { SampledCache bad(size, block, assoc, 8, 8); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+            }
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,305 @@
+#pragma once
+#include <Cache.hpp>
+#include <MemoryPort.hpp>
+#include <VectorWithCache.hpp>
+#include <map>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * A software-managed local memory, like a HammerBlade tile's DMEM.
+         * Every access hits; what matters is what fits and how many bytes
+         * are moved in and out. Space is reserved by name against the
+         * capacity, and data moves in and out by DMA, counted in transfers
+         * and in bytes rounded up to the DMA burst size.
+         */
+        class Scratchpad final : public MemoryPort {
+        public:
+            using Ptr = std::shared_ptr<Scratchpad>;
+
+            Scratchpad(Addr capacity, Addr dma_burst = 64) :
+                _capacity(capacity),
+                _dma_burst(dma_burst),
+                _used(0),
+                _peak(0),
+                _loads(0),
+                _stores(0),
+                _load_bytes(0),
+                _store_bytes(0),
+                _dma_transfers(0),
+                _dma_in_bytes(0),
+                _dma_out_bytes(0) {
+                if (capacity <= 0 || dma_burst <= 0)
+                    throw std::invalid_argument("Scratchpad: capacity and dma burst must be positive");
+            }
+
+            /* space management; throws if name is taken or bytes don't fit */
+            void allocate(const std::string &name, Addr bytes) {
+                if (_allocations.count(name))
+                    throw std::invalid_argument("Scratchpad: '" + name + "' is already allocated");
+                if (bytes > available()) {
+                    std::stringstream ss;
+                    ss << "Scratchpad: '" << name << "' needs " << bytes << " bytes, "
+                       << available() << " of " << _capacity << " free";
+                    throw std::invalid_argument(ss.str());
+                }
+                _allocations[name] = bytes;
+                _used += bytes;
+                _peak = std::max(_peak, _used);
+            }
+
+            void free(const std::string &name) {
+                auto it = _allocations.find(name);
+                if (it == _allocations.end())
+                    throw std::invalid_argument("Scratchpad: '" + name + "' is not allocated");
+                _used -= it->second;
+                _allocations.erase(it);
+            }
+
+            /* bulk transfers to and from the memory behind the cache */
+            void dma_in(Addr bytes)  { _dma_in_bytes += dma(bytes); }
+            void dma_out(Addr bytes) { _dma_out_bytes += dma(bytes); }
+
+            /* local accesses */
+            void load_multi(Addr addr, Addr sz) override { _loads++; _load_bytes += sz; }
+            void store_multi(Addr addr, Addr sz) override { _stores++; _store_bytes += sz; }
+
+            Addr capacity() const { return _capacity; }
+            Addr used() const { return _used; }
+            Addr peak() const { return _peak; }
+            Addr available() const { return _capacity - _used; }
+            Addr dma_burst() const { return _dma_burst; }
+
+            /* stats api */
+            int64_t loads() const { return _loads; }
+            int64_t stores() const { return _stores; }
+            int64_t accesses() const { return _loads + _stores; }
+            int64_t access_bytes() const { return _load_bytes + _store_bytes; }
+            int64_t dma_transfers() const { return _dma_transfers; }
+            int64_t dma_in_bytes() const { return _dma_in_bytes; }
+            int64_t dma_out_bytes() const { return _dma_out_bytes; }
+
+            std::string stats_csv_header() const {
+                return "loads,stores,load_bytes,store_bytes,dma_transfers,dma_in_bytes,dma_out_bytes,peak_bytes";
+            }
+
+            std::string stats_csv() const {
+                std::stringstream ss;
+                ss << _loads << ",";
+                ss << _stores << ",";
+                ss << _load_bytes << ",";
+                ss << _store_bytes << ",";
+                ss << _dma_transfers << ",";
+                ss << _dma_in_bytes << ",";
+                ss << _dma_out_bytes << ",";
+                ss << _peak << ",";
+                return ss.str();
+            }
+
+            static int Test(int argc, char *argv[]);
+
+        private:
+            Addr dma(Addr bytes) {
+                _dma_transfers++;
+                return (bytes + _dma_burst - 1) / _dma_burst * _dma_burst;
+            }
+
+            Addr _capacity;
+            Addr _dma_burst;
+            Addr _used;
+            Addr _peak;
+            std::map<std::string, Addr> _allocations;
+
+            int64_t _loads;
+            int64_t _stores;
+            int64_t _load_bytes;
+            int64_t _store_bytes;
+            int64_t _dma_transfers;
+            int64_t _dma_in_bytes;
+            int64_t _dma_out_bytes;
+        };
+
+        /**
+         * Pins a VectorWithCache in a scratchpad for this object's lifetime.
+         * Its space is reserved under name, its contents are DMA'd in on
+         * pinning and out on release (per transfer), and its accesses go to
+         * the scratchpad instead of its cache and port.
+         */
+        template <typename T>
+        class Pinned {
+        public:
+            enum Transfer { NONE = 0, IN = 1, OUT = 2, IN_OUT = IN | OUT };
+
+            Pinned(const Scratchpad::Ptr &spm, VectorWithCache<T> &v,
+                   const std::string &name, Transfer transfer = IN_OUT) :
+                _spm(spm),
+                _v(&v),
+                _name(name),
+                _transfer(transfer),
+                _bytes(static_cast<Cache::Addr>(v.size() * sizeof(T))),
+                _saved(v.model()) {
+                _spm->allocate(_name, _bytes);
+                if (_transfer & IN) _spm->dma_in(_bytes);
+                _v->set_model({nullptr, _spm});
+            }
+
+            ~Pinned() { release(); }
+
+            Pinned(const Pinned &) = delete;
+            Pinned & operator=(const Pinned &) = delete;
+
+            /* unpin early; the vector goes back to its own model */
+            void release() {
+                if (!_v) return;
+                if (_transfer & OUT) _spm->dma_out(_bytes);
+                _spm->free(_name);
+                _v->set_model(_saved);
+                _v = nullptr;
+            }
+
+        private:
+            Scratchpad::Ptr _spm;
+            VectorWithCache<T> *_v;
+            std::string _name;
+            Transfer _transfer;
+            Cache::Addr _bytes;
+            typename VectorWithCache<T>::Model _saved;
+        };
+
+        /**
+         * Where a kernel's data traffic went: served by the scratchpad,
+         * moved by DMA, or referenced through the cache (and, on a miss,
+         * from memory).
+         */
+        struct TrafficSplit {
+            TrafficSplit(const Scratchpad &spm, const Cache &cache) :
+                spm_accesses(spm.accesses()),
+                spm_bytes(spm.access_bytes()),
+                dma_bytes(spm.dma_in_bytes() + spm.dma_out_bytes()),
+                cache_accesses(cache.sum_hits() + cache.sum_misses()),
+                cache_misses(cache.sum_misses()),
+                memory_bytes(dma_bytes + (cache.sum_misses() + cache.sum_flushes()) * cache.block_size()) {}
+
+            int64_t spm_accesses;
+            int64_t spm_bytes;
+            int64_t dma_bytes;
+            int64_t cache_accesses;
+            int64_t cache_misses;
+            int64_t memory_bytes; // dma plus cache fills and writebacks
+
+            double spm_fraction() const {
+                int64_t total = spm_accesses + cache_accesses;
+                return total ? static_cast<double>(spm_accesses) / total : 0.0;
+            }
+
+            std::string csv_header() const {
+                return "spm_accesses,spm_bytes,dma_bytes,cache_accesses,cache_misses,memory_bytes,spm_fraction";
+            }
+
+            std::string csv() const {
+                std::stringstream ss;
+                ss << spm_accesses << ",";
+                ss << spm_bytes << ",";
+                ss << dma_bytes << ",";
+                ss << cache_accesses << ",";
+                ss << cache_misses << ",";
+                ss << memory_bytes << ",";
+                ss << spm_fraction() << ",";
+                return ss.str();
+            }
+        };
+
+        /* a HammerBlade tile's 4KB data memory */
+        static Scratchpad::Ptr HammerBladeScratchpad() {
+            return std::make_shared<Scratchpad>(4*1024, 32);
+        }
+
+        inline int Scratchpad::Test(int argc, char *argv[]) {
+            // a push step: scan the frontier, test and set a visited flag per neighbor
+            size_t nodes = 1 << 16, frontier_size = 1000, degree = 8;
+            std::vector<size_t> neighbors;
+            for (size_t i = 0; i < frontier_size * degree; i++)
+                neighbors.push_back((i * 2654435761u) % nodes);
+
+            auto kernel = [&](VectorWithCache<int> &frontier, VectorWithCache<int> &visited) {
+                for (size_t f = 0; f < frontier.size(); f++) {
+                    int src = frontier[f];
+                    for (size_t d = 0; d < degree; d++) {
+                        size_t dst = neighbors[src * degree + d];
+                        if (!visited[dst]) visited[dst] = 1;
+                    }
+                }
+            };
+
+            auto make_frontier = [&](const Cache::Ptr &cache) {
+                VectorWithCache<int> frontier(cache);
+                frontier.data().resize(frontier_size);
+                for (size_t i = 0; i < frontier_size; i++) frontier.data()[i] = i;
+                return frontier;
+            };
+
+            // Everything through the cache
+            auto all_cache = HammerBladeCache();
+            {
+                auto frontier = make_frontier(all_cache);
+                VectorWithCache<int> visited(all_cache);
+                visited.data().resize(nodes);
+                kernel(frontier, visited);
+            }
+
+            // Frontier pinned in the scratchpad, visited through the cache
+            auto cache = HammerBladeCache();
+            auto spm = HammerBladeScratchpad();
+            {
+                auto frontier = make_frontier(cache);
+                VectorWithCache<int> visited(cache);
+                visited.data().resize(nodes);
+                {
+                    Pinned<int> pin(spm, frontier, "frontier", Pinned<int>::IN);
+                    assert(spm->used() == static_cast<Addr>(frontier_size * sizeof(int)));
+                    kernel(frontier, visited);
+                }
+                assert(spm->used() == 0);
+                assert(frontier.model().cache == cache); // restored on release
+            }
+            assert(spm->loads() == static_cast<int64_t>(frontier_size));
+            assert(spm->dma_transfers() == 1 && spm->dma_in_bytes() == 4000 && spm->dma_out_bytes() == 0);
+            assert(cache->sum_hits() + cache->sum_misses() + spm->accesses()
+                   == all_cache->sum_hits() + all_cache->sum_misses());
+
+            TrafficSplit split(*spm, *cache);
+            std::cout << "all cache:       " << all_cache->stats_csv() << "\n"
+                      << "split:           " << split.csv_header() << "\n"
+                      << "                 " << split.csv() << std::endl;
+            assert(split.spm_fraction() > 0 && split.spm_fraction() < 1);
+
+            // Capacity is enforced
+            {
+                VectorWithCache<int> big(cache);
+                big.data().resize(1025);
+                bool thrown = false;
+                try { Pinned<int> pin(spm, big, "big"); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+                assert(big.model().cache == cache);
+
+                VectorWithCache<int> half(cache);
+                half.data().resize(512);
+                Pinned<int> a(spm, half, "a");
+                thrown = false;
+                try { Pinned<int> b(spm, half, "a"); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+                assert(spm->peak() == 4000 && spm->used() == 2048);
+            }
+            assert(spm->dma_out_bytes() == 2048);
+            return 0;
+        }
+    }
+}
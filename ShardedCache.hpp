@@ -0,0 +1,226 @@
+#pragma once
+#include <BankedCache.hpp>
+#include <MemoryPort.hpp>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <algorithm>
+#include <random>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * Simulates a BankedCache on worker threads. Banks never interact,
+         * so each worker owns the banks with bank % threads == its id and
+         * consumes a single-producer ring of their accesses in order;
+         * stats are identical to running the BankedCache serially.
+         *
+         * Accesses are staged per shard and published in batches. Call
+         * sync() before reading stats from the underlying BankedCache.
+         * Only one thread may issue accesses. A worker that finds its ring
+         * empty polls briefly, then sleeps until the next publish.
+         */
+        class ShardedCache final : public MemoryPort {
+        public:
+            using Ptr = std::shared_ptr<ShardedCache>;
+
+            ShardedCache(const BankedCache::Ptr &cache,
+                         int threads = std::thread::hardware_concurrency()) :
+                _cache(cache),
+                _shards(std::max<size_t>(1, std::min<size_t>(std::max(threads, 1), cache->banks()))),
+                _stop(false) {
+                for (auto &s : _shards) s.stage.reserve(BATCH);
+                for (size_t t = 0; t < _shards.size(); t++)
+                    _workers.emplace_back([this, t]() { work(_shards[t]); });
+            }
+
+            ~ShardedCache() {
+                sync();
+                _stop = true;
+                for (auto &s : _shards) {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    s.wake.notify_one();
+                }
+                for (auto &w : _workers) w.join();
+            }
+
+            ShardedCache(const ShardedCache &) = delete;
+            ShardedCache & operator=(const ShardedCache &) = delete;
+
+            /* primary api, same as Cache */
+            void load(Addr addr) { route(addr, false); }
+            void load_multi(Addr addr, Addr sz) override {
+                _cache->for_each_block(addr, sz, [this](Addr a) { route(a, false); });
+            }
+
+            void store(Addr addr) { route(addr, true); }
+            void store_multi(Addr addr, Addr sz) override {
+                _cache->for_each_block(addr, sz, [this](Addr a) { route(a, true); });
+            }
+
+            /* publish staged accesses and wait for every shard to drain them */
+            void sync() {
+                for (auto &s : _shards) publish(s);
+                for (auto &s : _shards)
+                    while (s.head.load(std::memory_order_acquire) != s.tail.load(std::memory_order_relaxed))
+                        std::this_thread::yield();
+            }
+
+            int threads() const { return _shards.size(); }
+            BankedCache::Ptr cache() const { return _cache; }
+
+            static int Test(int argc, char *argv[]);
+
+        private:
+            enum : size_t {
+                BATCH = 1024,
+                RING  = 64 * BATCH, // power of two
+                SPIN  = 4096,       // empty polls before a worker sleeps
+            };
+
+            /* one record per block; local addresses are block aligned, so bit 0 holds the store flag */
+            struct Record {
+                uint32_t bank;
+                Addr local;
+            };
+
+            struct Shard {
+                Shard() : ring(RING), head(0), tail(0), sleeping(false) {}
+                Shard(const Shard &) : Shard() {}
+                std::vector<Record> ring;
+                std::atomic<size_t> head; // next to consume, written by the worker
+                std::atomic<size_t> tail; // next to fill, written by the producer
+                std::vector<Record> stage;
+                std::atomic<bool> sleeping; // worker is in, or about to enter, sleep()
+                std::mutex mutex;
+                std::condition_variable wake;
+            };
+
+            void route(Addr addr, bool store) {
+                size_t bank = _cache->bank_of(addr);
+                Shard &s = _shards[bank % _shards.size()];
+                s.stage.push_back({static_cast<uint32_t>(bank), _cache->local_addr(addr) | store});
+                if (s.stage.size() == BATCH) publish(s);
+            }
+
+            void publish(Shard &s) {
+                size_t tail = s.tail.load(std::memory_order_relaxed);
+                while (tail + s.stage.size() - s.head.load(std::memory_order_acquire) > RING)
+                    std::this_thread::yield();
+                for (const Record &r : s.stage)
+                    s.ring[tail++ & (RING-1)] = r;
+                s.tail.store(tail, std::memory_order_release);
+                s.stage.clear();
+
+                // pairs with the fence in sleep(): either the worker sees
+                // the new tail or we see it sleeping
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (s.sleeping.load(std::memory_order_relaxed)) {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    s.wake.notify_one();
+                }
+            }
+
+            /* block until the producer publishes past head or stops us */
+            void sleep(Shard &s, size_t head) {
+                std::unique_lock<std::mutex> lock(s.mutex);
+                s.sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                s.wake.wait(lock, [&]() {
+                        return _stop.load(std::memory_order_acquire) ||
+                            s.tail.load(std::memory_order_acquire) != head;
+                    });
+                s.sleeping.store(false, std::memory_order_relaxed);
+            }
+
+            void work(Shard &s) {
+                size_t idle = 0;
+                for (;;) {
+                    size_t head = s.head.load(std::memory_order_relaxed);
+                    size_t tail = s.tail.load(std::memory_order_acquire);
+                    if (head == tail) {
+                        if (_stop.load(std::memory_order_acquire)) return;
+                        if (++idle > SPIN) {
+                            sleep(s, head);
+                            idle = 0;
+                        } else if (idle > 64) {
+                            std::this_thread::yield();
+                        }
+                        continue;
+                    }
+                    idle = 0;
+                    for (; head != tail; head++) {
+                        const Record &r = s.ring[head & (RING-1)];
+                        _cache->access_bank(r.bank, r.local & ~Addr(1), r.local & 1);
+                    }
+                    s.head.store(head, std::memory_order_release);
+                }
+            }
+
+            BankedCache::Ptr _cache;
+            std::vector<Shard> _shards;
+            std::vector<std::thread> _workers;
+            std::atomic<bool> _stop;
+        };
+
+        inline int ShardedCache::Test(int argc, char *argv[]) {
+            std::vector<std::pair<Addr, bool>> trace;
+            std::default_random_engine gen;
+            std::uniform_int_distribution<Addr> gather(0, 1 << 22);
+            for (Addr i = 0; i < 1000000; i++) {
+                switch (i % 3) {
+                case 0: trace.push_back({0x100000 + i * 4, false}); break;
+                case 1: trace.push_back({0x4000000 + gather(gen) * 4, i % 2 == 0}); break;
+                default: trace.push_back({0x8000000 + (i % 8192) * 64, true}); break;
+                }
+            }
+
+            for (auto kind : {BankHash::Kind::INTERLEAVED, BankHash::Kind::XOR}) {
+                auto serial = HammerBladeBankedCache(kind);
+                for (auto &a : trace) {
+                    if (a.second) serial->store_multi(a.first, 4);
+                    else          serial->load_multi(a.first, 4);
+                }
+
+                for (int threads : {1, 3, 8}) {
+                    auto banked = HammerBladeBankedCache(kind);
+                    {
+                        ShardedCache sharded(banked, threads);
+                        for (auto &a : trace) {
+                            if (a.second) sharded.store_multi(a.first, 4);
+                            else          sharded.load_multi(a.first, 4);
+                        }
+                        sharded.sync();
+                        assert(banked->stats_csv() == serial->stats_csv());
+                    }
+                    for (size_t b = 0; b < banked->banks(); b++)
+                        assert(banked->bank(b)->stats_csv() == serial->bank(b)->stats_csv());
+                }
+                std::cout << serial->stats_csv_header() << "\n" << serial->stats_csv() << std::endl;
+            }
+
+            // idle workers sleep instead of polling
+            {
+                ShardedCache sharded(HammerBladeBankedCache(), 8);
+                sharded.load(0);
+                sharded.sync();
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                std::clock_t c0 = std::clock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                double busy = static_cast<double>(std::clock() - c0) / CLOCKS_PER_SEC;
+                std::cout << "idle cpu: " << busy << "s over 0.2s" << std::endl;
+                assert(busy < 0.05);
+                sharded.load(64);
+                sharded.sync();
+            }
+            return 0;
+        }
+    }
+}
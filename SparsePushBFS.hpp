@@ -1,42 +1,50 @@
+#pragma once
 #include <vector>
 #include <set>
 #include <sstream>
 #include <fstream>
 #include <memory>
 #include "WGraph.hpp"
+#include "VertexArray.hpp"
+#include "Instrumentation.hpp"
 
 namespace graph_tools {
-    class SparsePushBFS {
+    /**
+     * G is WGraph or any graph with the same neighbors() view
+     * (e.g. InstrumentedWGraph); per-vertex state lives in
+     * VertexArray<G, int> storage. I is the instrumentation policy
+     * (see Instrumentation.hpp); one run() is one round.
+     */
+    template <typename G, typename I = Counters>
+    class BasicSparsePushBFS {
     public:
         using WGraph = graph_tools::WGraph;
-        SparsePushBFS() :
+        template <typename T>
+        using Array = typename VertexArray<G, T>::type;
+
+        BasicSparsePushBFS() :
             _wg(nullptr),
-            _traversed_edges(0),
-            _updates(0),
-            _frontier_reads(0) {}
+            _transient(0) {}
 
-        SparsePushBFS(const std::shared_ptr<WGraph> &wg,
+        BasicSparsePushBFS(const typename G::Ptr &wg,
                       const std::set<int> &frontier_in,
                       const std::set<int> &visited_in) :
             _wg(wg),
             _visited_in(visited_in),
             _frontier_in(frontier_in),
-            _traversed_edges(0),
-            _updates(0),
-            _frontier_reads(0) {}
+            _transient(0) {}
         
         void run() {
             // setup
-            std::vector<int> frontier;
-            std::vector<int> next(_wg->num_nodes(), 9);
-            std::vector<int> visited(_wg->num_nodes(), 0);
-            auto &neib = _wg->get_neighbors();
-            auto &offs = _wg->get_offsets();
-            auto &degs = _wg->get_degrees();
-            
-            frontier.reserve(_frontier_in.size());
+            Array<int> frontier = VertexArray<G, int>::Make(*_wg, _frontier_in.size(), 0);
+            Array<int> next = VertexArray<G, int>::Make(*_wg, _wg->num_nodes(), 9);
+            Array<int> visited = VertexArray<G, int>::Make(*_wg, _wg->num_nodes(), 0);
+            _transient = VertexArray<G, int>::Bytes(frontier) + VertexArray<G, int>::Bytes(next)
+                + VertexArray<G, int>::Bytes(visited);
+
+            int i = 0;
             for (int v : _frontier_in)
-                frontier.push_back(v);
+                frontier[i++] = v;
 
             for (int v : _visited_in)
                 visited[v] = 1;
@@ -44,13 +52,12 @@ namespace graph_tools {
             // run iteration
             for (int src_i = 0; src_i < frontier.size(); src_i++) {
                 int src = frontier[src_i];
-                _frontier_reads++;
+                _instr.add(Stat::FRONTIER_READS);
                 
-                for (int dst_i = 0; dst_i < degs[src]; dst_i++) {
-                    int dst = neib[offs[src]+dst_i];
-                    _traversed_edges++;
+                for (int dst : _wg->neighbors(src)) {
+                    _instr.add(Stat::TRAVERSED_EDGES);
                     if (visited[dst] == 0) {
-                        _updates++;
+                        _instr.add(Stat::UPDATES);
                         visited[dst] = 1;
                         next[dst] = 1;
                     }
@@ -66,6 +73,7 @@ namespace graph_tools {
                 if (visited[v] == 1)
                     _visited_out.insert(v);
             }
+            _instr.next_round();
         }
 
         const std::set<int>& frontier_in() const { return _frontier_in; }
@@ -96,20 +104,36 @@ namespace graph_tools {
             f << report();            
         }
         
-        int traversed_edges() const { return _traversed_edges; }
-        int updates() const { return _updates; }
+        int64_t traversed_edges() const { return _instr.get(Stat::TRAVERSED_EDGES); }
+        int64_t updates() const { return _instr.get(Stat::UPDATES); }
+        const I & instrumentation() const { return _instr; }
+
+        /* bytes this step owns; the graph is shared and reports its own */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("visited in", MemoryFootprint::Bytes(_visited_in));
+            f.add("visited out", MemoryFootprint::Bytes(_visited_out));
+            f.add("frontier in", MemoryFootprint::Bytes(_frontier_in));
+            f.add("frontier out", MemoryFootprint::Bytes(_frontier_out));
+            f.add_transient("vertex arrays", _transient);
+            return f;
+        }
 
-        static std::vector<SparsePushBFS> RunBFS(const WGraph &wg, int root, int iter, bool print = true)
+        static std::vector<BasicSparsePushBFS> RunBFS(const G &wg, int root, int iter, bool print = true)
+            {
+                return RunBFS(std::make_shared<const G>(wg), root, iter, print);
+            }
+
+        static std::vector<BasicSparsePushBFS> RunBFS(const typename G::Ptr &wgptr, int root, int iter, bool print = true)
             {
-                std::shared_ptr<WGraph> wgptr = std::shared_ptr<WGraph>(new WGraph(wg));
                 std::set<int> frontier = {root};
                 std::set<int> visited = {root};
                 std::cout << std::endl << "BFS on graph with " << wgptr->num_nodes() << " and " << wgptr->num_edges() << std::endl;
                 //std::cout << "graph " << std::endl << wg.to_string() << std::endl;
 
-                std::vector<SparsePushBFS> bfs_runs;
+                std::vector<BasicSparsePushBFS> bfs_runs;
                 for (int i = 0; i <= iter; i++) {
-                    SparsePushBFS bfs = SparsePushBFS(wgptr, frontier, visited);
+                    BasicSparsePushBFS bfs(wgptr, frontier, visited);
                     bfs.run();
 
                     if (print)
@@ -143,14 +167,15 @@ namespace graph_tools {
         }
         
     private:
-        std::shared_ptr<WGraph> _wg;
+        typename G::Ptr _wg;
         std::set<int> _visited_in;
         std::set<int> _visited_out;
         std::set<int> _frontier_in;
         std::set<int> _frontier_out;
+        int64_t _transient; // run()'s per-vertex arrays
 
-        int _traversed_edges;
-        int _updates;
-        int _frontier_reads;
+        I _instr;
     };
+
+    using SparsePushBFS = BasicSparsePushBFS<WGraph>;
 }
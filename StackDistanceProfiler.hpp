@@ -0,0 +1,260 @@
+#pragma once
+#include <Cache.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <cassert>
+
+namespace graph_tools {
+    namespace memory_modeling {
+
+        /**
+         * LRU stack distances for one access stream: the number of distinct
+         * blocks touched since the previous access to the same block.
+         * Keeps one marker per live block in a Fenwick tree indexed by time
+         * slot, so each access costs O(log N); slots are renumbered when
+         * the tree fills up.
+         */
+        class LRUStack {
+        public:
+            using Addr = Cache::Addr;
+            enum : int64_t { COLD = -1 };
+
+            LRUStack() : _now(0), _live(0) { reset(16); }
+
+            /* record an access to block whose last slot is *slot (-1 if new) */
+            int64_t access(Addr block, int64_t &slot) {
+                if (_now == static_cast<int64_t>(_owner.size())) compact();
+
+                int64_t d = COLD;
+                if (slot != COLD) {
+                    d = prefix(_now-1) - prefix(slot);
+                    add(slot, -1);
+                    _owner[slot] = -1;
+                } else {
+                    _live++;
+                }
+                slot = _now++;
+                add(slot, +1);
+                _owner[slot] = block;
+                return d;
+            }
+
+            /* slots were renumbered; callback(block, new slot) for each live block */
+            template <typename F>
+            void on_compact(F f) { _relocate = f; }
+
+        private:
+            void reset(int64_t capacity) {
+                _tree.assign(capacity+1, 0);
+                _owner.assign(capacity, -1);
+            }
+
+            void compact() {
+                std::vector<Addr> live;
+                live.reserve(_live);
+                for (Addr block : _owner)
+                    if (block != -1) live.push_back(block);
+
+                reset(std::max<int64_t>(16, 2 * live.size()));
+                _now = 0;
+                for (Addr block : live) {
+                    add(_now, +1);
+                    _owner[_now] = block;
+                    _relocate(block, _now);
+                    _now++;
+                }
+            }
+
+            void add(int64_t i, int delta) {
+                for (i++; i < static_cast<int64_t>(_tree.size()); i += i & -i)
+                    _tree[i] += delta;
+            }
+
+            /* markers in slots [0, i] */
+            int64_t prefix(int64_t i) const {
+                int64_t sum = 0;
+                for (i++; i > 0; i -= i & -i)
+                    sum += _tree[i];
+                return sum;
+            }
+
+            int64_t _now;
+            int64_t _live;
+            std::vector<int32_t> _tree;
+            std::vector<Addr> _owner; // block in each slot, -1 if dead
+            std::function<void(Addr, int64_t)> _relocate;
+        };
+
+        /**
+         * Single-pass LRU miss counts for many cache geometries (Mattson et al.).
+         * Takes the same load/store stream as Cache and, for each configured
+         * set count, keeps a per-set LRU stack distance histogram. Any
+         * (size, assoc) whose set count was configured can then be read back
+         * without re-running the kernel; sets = 1 gives fully associative
+         * miss ratios for every capacity. Flushes need dirty state per
+         * geometry and are not modeled.
+         */
+        class StackDistanceProfiler {
+        public:
+            using Addr = Cache::Addr;
+            using Ptr  = std::shared_ptr<StackDistanceProfiler>;
+
+            StackDistanceProfiler(Addr block_size, const std::vector<Addr> &set_counts = {1}) :
+                _block_size(block_size),
+                _accesses(0) {
+                for (Addr sets : set_counts)
+                    _configs.emplace_back(new Config(sets));
+            }
+
+            /* primary api, same as Cache */
+            void load(Addr addr) { access(addr); }
+            void load_multi(Addr addr, Addr sz) { access_multi(addr, sz); }
+            void store(Addr addr) { access(addr); }
+            void store_multi(Addr addr, Addr sz) { access_multi(addr, sz); }
+
+            Addr block_size() const { return _block_size; }
+            int64_t accesses() const { return _accesses; }
+            int64_t compulsory_misses() const { return _configs.empty() ? 0 : _configs[0]->cold; }
+
+            /* LRU misses of a cache with this geometry */
+            int64_t misses(Addr size, Addr assoc) const {
+                Addr sets = size / (_block_size * assoc);
+                const Config &c = config(sets);
+                int64_t hits = 0;
+                for (Addr d = 0; d < assoc && d < static_cast<Addr>(c.hist.size()); d++)
+                    hits += c.hist[d];
+                return _accesses - hits;
+            }
+
+            int64_t hits(Addr size, Addr assoc) const {
+                return _accesses - misses(size, assoc);
+            }
+
+            /* fully associative LRU miss ratio for a capacity in bytes */
+            double miss_ratio(Addr capacity) const {
+                return _accesses == 0 ? 0.0
+                    : static_cast<double>(misses(capacity, capacity / _block_size)) / _accesses;
+            }
+
+            /* per-set stack distance histogram for a configured set count */
+            const std::vector<int64_t> & histogram(Addr sets) const { return config(sets).hist; }
+
+            /**
+             * One row per configured set count and power-of-two associativity
+             * up to max_assoc, in Cache's csv column order.
+             */
+            std::string sweep_csv(Addr max_assoc = 16) const {
+                std::stringstream ss;
+                ss << "size,assoc,sets,block_size,hits,misses,cold_misses\n";
+                for (auto &c : _configs) {
+                    for (Addr assoc = 1; assoc <= max_assoc; assoc *= 2) {
+                        Addr size = c->sets * assoc * _block_size;
+                        ss << size << "," << assoc << "," << c->sets << "," << _block_size << ",";
+                        ss << hits(size, assoc) << "," << misses(size, assoc) << ",";
+                        ss << c->cold << "\n";
+                    }
+                }
+                return ss.str();
+            }
+
+            static int Test(int argc, char *argv[]) {
+                // a mix of streaming, gathers and a hot region
+                std::vector<Addr> trace;
+                std::default_random_engine gen;
+                std::uniform_int_distribution<Addr> gather(0, 1<<16), hot(0, 1<<10);
+                for (Addr i = 0; i < 200000; i++) {
+                    switch (i % 3) {
+                    case 0: trace.push_back(0x100000 + (i * 4) % (1 << 20)); break;
+                    case 1: trace.push_back(0x800000 + gather(gen) * 4); break;
+                    default: trace.push_back(0xC00000 + hot(gen) * 4); break;
+                    }
+                }
+
+                Addr block = 32;
+                std::vector<Addr> set_counts = {1, 16, 64, 256, 2048};
+                StackDistanceProfiler profiler(block, set_counts);
+                for (size_t i = 0; i < trace.size(); i++) {
+                    if (i % 4 == 0) profiler.store_multi(trace[i], 4);
+                    else            profiler.load_multi(trace[i], 4);
+                }
+                std::cout << profiler.sweep_csv(8) << std::endl;
+
+                // every geometry matches a separate LRUCache run
+                for (Addr sets : set_counts) {
+                    for (Addr assoc = 1; assoc <= 8; assoc *= 2) {
+                        LRUCache cache(sets * assoc * block, block, assoc);
+                        for (size_t i = 0; i < trace.size(); i++) {
+                            if (i % 4 == 0) cache.store_multi(trace[i], 4);
+                            else            cache.load_multi(trace[i], 4);
+                        }
+                        Addr size = cache.size();
+                        assert(profiler.hits(size, assoc) == cache.sum_hits());
+                        assert(profiler.misses(size, assoc) == cache.sum_misses());
+                        assert(profiler.compulsory_misses() == cache.compulsory_misses());
+                    }
+                }
+
+                bool thrown = false;
+                try { profiler.misses(32 * block * 4, 4); } catch (std::invalid_argument &) { thrown = true; }
+                assert(thrown);
+                return 0;
+            }
+
+        private:
+            struct Config {
+                Config(Addr sets) : sets(sets), cold(0), stacks(sets) {
+                    for (auto &stack : stacks)
+                        stack.on_compact([this](Addr block, int64_t slot) { last[block] = slot; });
+                }
+                Addr sets;
+                int64_t cold;
+                std::vector<LRUStack> stacks;
+                std::unordered_map<Addr, int64_t> last; // block -> slot in its set's stack
+                std::vector<int64_t> hist;              // per-set stack distance -> count
+            };
+
+            const Config & config(Addr sets) const {
+                for (auto &c : _configs)
+                    if (c->sets == sets) return *c;
+                throw std::invalid_argument("StackDistanceProfiler: set count "
+                                            + std::to_string(sets) + " was not profiled");
+            }
+
+            void access_multi(Addr addr, Addr sz) {
+                while (sz > 0) {
+                    access(addr);
+                    Addr step = _block_size - addr % _block_size;
+                    addr += step;
+                    sz   -= step;
+                }
+            }
+
+            void access(Addr addr) {
+                Addr block = addr / _block_size;
+                _accesses++;
+                for (auto &c : _configs) {
+                    auto ins = c->last.insert({block, static_cast<int64_t>(LRUStack::COLD)});
+                    int64_t d = c->stacks[block % c->sets].access(block, ins.first->second);
+                    if (d == LRUStack::COLD) {
+                        c->cold++;
+                        continue;
+                    }
+                    if (d >= static_cast<int64_t>(c->hist.size())) c->hist.resize(d+1, 0);
+                    c->hist[d]++;
+                }
+            }
+
+            Addr _block_size;
+            int64_t _accesses;
+            std::vector<std::unique_ptr<Config>> _configs;
+        };
+    }
+}
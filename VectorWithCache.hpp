@@ -1,10 +1,15 @@
 #pragma once
 #include <Cache.hpp>
+#include <MemoryPort.hpp>
+#include <MemoryTrace.hpp>
 #include <vector>
 #include <memory>
+#include <string>
 #include <cstdint>
 #include <iostream>
 #include <type_traits>
+#include <algorithm>
+#include <chrono>
 #include <assert.h>
 
 namespace graph_tools {
@@ -15,23 +20,123 @@ namespace graph_tools {
                           "T must be a scalar value");
 
         public:
-            VectorWithCache(std::shared_ptr<Cache> cache):
-                _cache(cache) {
+            /* element access through the model; reads convert, writes assign */
+            class Reference {
+            public:
+                Reference(VectorWithCache &v, size_t i) : _v(v), _i(i) {}
+                operator T() const { return _v.get(_i); }
+                Reference & operator=(T val) { _v.set(_i, val); return *this; }
+                Reference & operator=(const Reference &other) { return *this = static_cast<T>(other); }
+            private:
+                VectorWithCache &_v;
+                size_t _i;
+            };
+
+            /* either may be null; port takes a trace writer or a hierarchy */
+            VectorWithCache(std::shared_ptr<Cache> cache = nullptr,
+                            std::shared_ptr<MemoryPort> port = nullptr):
+                _cache(cache),
+                _port(port) {
+            }
+
+            VectorWithCache(size_t n, T val,
+                            std::shared_ptr<Cache> cache,
+                            std::shared_ptr<MemoryPort> port = nullptr):
+                VectorWithCache(cache, port) {
+                assign(n, val);
             }
 
             T get(size_t i) const {
-                _cache->load_multi(reinterpret_cast<Cache::Addr>(&_data[i]),
-                                   static_cast<Cache::Addr>(sizeof(T)));
+                auto addr = reinterpret_cast<Cache::Addr>(&_data[i]);
+                if (_cache) _cache->load_multi(addr, static_cast<Cache::Addr>(sizeof(T)));
+                if (_port) _port->load_multi(addr, static_cast<Cache::Addr>(sizeof(T)));
                 return _data[i];
             }
 
             void set(size_t i, T val) {
-                _cache->store_multi(reinterpret_cast<Cache::Addr>(&_data[i]),
-                                    static_cast<Cache::Addr>(sizeof(T)));
+                auto addr = reinterpret_cast<Cache::Addr>(&_data[i]);
+                if (_cache) _cache->store_multi(addr, static_cast<Cache::Addr>(sizeof(T)));
+                if (_port) _port->store_multi(addr, static_cast<Cache::Addr>(sizeof(T)));
                 _data[i] = val;
             }
 
+            /**
+             * Bulk access. Each element still counts as one access, but runs
+             * of elements within one block reach the model as a single
+             * load_repeat/store_repeat. get_range, gather and scatter give
+             * the same stats as the element-wise loop.
+             */
+
+            /* load elements [i, i+n) and return them */
+            const T * get_range(size_t i, size_t n) const {
+                load_runs(i, n, [](Cache::Addr) {});
+                return _data.data() + i;
+            }
+
+            /* f(value) for elements [i, i+n); each block's run is modeled as it
+               is entered, so accesses f makes can't split it */
+            template <typename F>
+            void for_each_in_range(size_t i, size_t n, F f) const {
+                const T *p = _data.data() + i;
+                load_runs(i, n, [&p, &f](Cache::Addr k) {
+                        for (Cache::Addr j = 0; j < k; j++) f(*p++);
+                    });
+            }
+
+            /* *out++ = v[idx] for each idx in [first, last) */
+            template <typename It, typename Out>
+            Out gather(It first, It last, Out out) const {
+                Coalescer c(*this, false);
+                for (; first != last; ++first) {
+                    c.add(&_data[*first]);
+                    *out++ = _data[*first];
+                }
+                return out;
+            }
+
+            /* v[idx] = *vals++ for each idx in [first, last) */
+            template <typename It, typename In>
+            void scatter(It first, It last, In vals) {
+                Coalescer c(*this, true);
+                for (; first != last; ++first, ++vals) {
+                    c.add(&_data[*first]);
+                    _data[*first] = *vals;
+                }
+            }
+
+            Reference operator[](size_t i) { return Reference(*this, i); }
+            T operator[](size_t i) const { return get(i); }
+
+            /* (re)initialize; counted as one store per block covered */
+            void assign(size_t n, T val) {
+                _data.assign(n, val);
+                update_region();
+                store_range(0, n);
+            }
+
+            /* new elements count as one store per block they cover */
+            void resize(size_t n, T val = T()) {
+                size_t old = _data.size();
+                _data.resize(n, val);
+                update_region();
+                if (n > old) store_range(old, n - old);
+            }
+
+            /**
+             * Name this vector's storage for per-region stats in the model.
+             * assign() and resize() keep the region current; call again after
+             * resizing through data().
+             */
+            void set_region(const std::string &name) {
+                _region = name;
+                update_region();
+            }
+
+            void clear() { _data.clear(); }
+
             std::vector<T> & data() { return _data; }
+            const std::vector<T> & data() const { return _data; }
+            operator const std::vector<T> & () const { return _data; }
 
             size_t size() const { return _data.size(); }
 
@@ -39,6 +144,22 @@ namespace graph_tools {
                 return static_cast<std::shared_ptr<const Cache>>(_cache);
             }
 
+            std::shared_ptr<MemoryPort> port() const { return _port; }
+
+            /* where accesses go; swapped out while pinned in a scratchpad */
+            struct Model {
+                std::shared_ptr<Cache> cache;
+                std::shared_ptr<MemoryPort> port;
+            };
+
+            Model model() const { return {_cache, _port}; }
+
+            void set_model(const Model &m) {
+                _cache = m.cache;
+                _port = m.port;
+                update_region();
+            }
+
             /* Unit Testing */
             static int Test(int argc, char *argv[]) {
                 // Make sure missing works
@@ -138,12 +259,275 @@ namespace graph_tools {
                     assert(dram.data()[3] == 3);
                 }
 
+                // Dirty evictions flush, repeat misses aren't cold
+                {
+                    // A cache that can hold a single element
+                    std::shared_ptr<LRUCache> cache
+                        = std::make_shared<LRUCache>(sizeof(T), sizeof(T), 1);
+                    cache->track_blocks();
+
+                    VectorWithCache<T> dram(cache);
+                    dram.data() = {0, 1, 2, 3};
+
+                    dram.set(0, 4);
+                    dram.get(1);
+                    dram.get(0);
+
+                    assert(cache->sum_hits() == 0);
+                    assert(cache->sum_misses() == 3);
+                    assert(cache->compulsory_misses() == 2);
+                    assert(cache->sum_flushes() == 1);
+                    auto addr = reinterpret_cast<Cache::Addr>(&dram.data()[0]);
+                    assert(cache->block_stats(addr).misses == 2);
+                    assert(cache->block_stats(addr).flushes == 1);
+                    assert(dram.data()[0] == 4);
+                }
+
+                // Record only, then replay into the same cache
+                {
+                    TemporaryFile file("vector_with_cache");
+                    const std::string &file_name = file.name();
+                    auto trace = std::make_shared<TraceWriter>(file_name, sizeof(T));
+                    VectorWithCache<T> dram(nullptr, trace);
+                    dram.data() = {0, 1, 2, 3};
+
+                    dram.set(0, 4);
+                    dram.get(1);
+                    dram.get(0);
+                    trace->close();
+                    assert(trace->records() == 3);
+
+                    std::shared_ptr<LRUCache> cache
+                        = std::make_shared<LRUCache>(sizeof(T), sizeof(T), 1);
+                    ReplayTrace(file_name, {cache}, 1);
+                    assert(cache->sum_misses() == 3);
+                    assert(cache->sum_flushes() == 1);
+                }
+
+                // Indexing goes through the model
+                {
+                    std::shared_ptr<LRUCache> cache
+                        = std::make_shared<LRUCache>(sizeof(T), sizeof(T), 1);
+                    VectorWithCache<T> dram(4, 0, cache);
+                    assert(cache->sum_misses() == 4);
+
+                    dram[1] = 5;
+                    dram[2] = dram[1];
+                    T x = dram[2] + 1;
+                    const VectorWithCache<T> &cdram = dram;
+                    assert(cdram[0] == 0);
+                    assert(x == 6);
+                    assert(cache->sum_hits() + cache->sum_misses() == 4 + 5);
+                    assert(dram.data()[2] == 5);
+                }
+
+                // Bulk access matches element-wise stats, blocks straddled or
+                // not, under lru and under rrip, which promotes only on a hit
+                auto make = [](int policy, Cache::Addr block) -> std::shared_ptr<Cache> {
+                    Cache::Addr size = block * 4 * 16;
+                    if (policy == 1) return std::make_shared<SRRIPCache>(size, block, 4);
+                    if (policy == 2) return std::make_shared<BRRIPCache>(size, block, 4);
+                    return std::make_shared<LRUCache>(size, block, 4);
+                };
+                for (int policy = 0; policy < 3; policy++)
+                for (Cache::Addr block : {64, 6}) {
+                    auto element = make(policy, block);
+                    auto bulk    = make(policy, block);
+                    element->track_blocks();
+                    bulk->track_blocks();
+
+                    std::vector<size_t> idx;
+                    for (size_t i = 0; i < 3000; i++)
+                        idx.push_back((i % 7 == 0) ? (i * 2654435761u) % 4096 : i);
+
+                    TemporaryFile efile("vector_with_cache_e"), bfile("vector_with_cache_b");
+                    auto etrace = std::make_shared<TraceWriter>(efile.name(), block);
+                    auto btrace = std::make_shared<TraceWriter>(bfile.name(), block);
+
+                    VectorWithCache<T> ev(element, etrace);
+                    ev.data().resize(4096);
+                    T sum = 0;
+                    for (size_t i = 100; i < 1100; i++) sum += ev.get(i);
+                    for (size_t i : idx) sum += ev.get(i);
+                    for (size_t i = 0; i < idx.size(); i++) ev.set(idx[i], T(i));
+                    for (size_t i = 5; i < 905; i++) sum += ev.get(i);
+                    std::vector<T> result = ev.data();
+
+                    // same buffer, so the same elements share blocks
+                    VectorWithCache<T> bv(bulk, btrace);
+                    bv.data().swap(ev.data());
+                    std::fill(bv.data().begin(), bv.data().end(), T(0));
+                    T bsum = 0;
+                    const T *r = bv.get_range(100, 1000);
+                    for (size_t i = 0; i < 1000; i++) bsum += r[i];
+                    std::vector<T> out;
+                    bv.gather(idx.begin(), idx.end(), std::back_inserter(out));
+                    for (T x : out) bsum += x;
+                    std::vector<T> vals;
+                    for (size_t i = 0; i < idx.size(); i++) vals.push_back(T(i));
+                    bv.scatter(idx.begin(), idx.end(), vals.begin());
+                    bv.for_each_in_range(5, 900, [&bsum](T x) { bsum += x; });
+
+                    assert(sum == bsum);
+                    assert(result == bv.data());
+                    assert(element->stats_csv() == bulk->stats_csv());
+                    assert(etrace->records() == btrace->records());
+                    auto base = reinterpret_cast<Cache::Addr>(bv.data().data());
+                    for (size_t i = 0; i < 4096; i++) {
+                        auto es = element->block_stats(base + i * sizeof(T));
+                        auto bs = bulk->block_stats(base + i * sizeof(T));
+                        assert(es.hits == bs.hits && es.misses == bs.misses && es.flushes == bs.flushes);
+                    }
+                }
+
+                // Ranged CSR scans simulate faster, streaming and cache-resident
+                for (size_t n : {size_t(1) << 22, size_t(1) << 12}) {
+                    size_t passes = (size_t(1) << 22) / n;
+                    auto element = std::make_shared<LRUCache>(32*1024, 64, 8);
+                    auto bulk    = std::make_shared<LRUCache>(32*1024, 64, 8);
+                    VectorWithCache<T> ev(element), bv(bulk);
+                    ev.data().assign(n, 1);
+
+                    using clock = std::chrono::steady_clock;
+                    T esum = 0, bsum = 0;
+                    // warm up; cold-miss bookkeeping would otherwise dominate
+                    for (size_t i = 0; i < n; i++) ev.get(i);
+                    auto t0 = clock::now();
+                    for (size_t p = 0; p < passes; p++)
+                        for (size_t v = 0; v + 24 <= n; v += 24)
+                            for (size_t i = v; i < v + 24; i++) esum += ev.get(i);
+                    auto t1 = clock::now();
+
+                    bv.data().swap(ev.data());
+                    for (size_t i = 0; i < n; i++) bv.get(i);
+                    auto t1b = clock::now();
+                    for (size_t p = 0; p < passes; p++)
+                        for (size_t v = 0; v + 24 <= n; v += 24) {
+                            const T *r = bv.get_range(v, 24);
+                            for (size_t i = 0; i < 24; i++) bsum += r[i];
+                        }
+                    auto t2 = clock::now();
+
+                    double element_s = std::chrono::duration<double>(t1 - t0).count();
+                    double bulk_s = std::chrono::duration<double>(t2 - t1b).count();
+                    std::cout << "csr scan (" << n * sizeof(T) / 1024 << "KB): element-wise " << element_s
+                              << "s, ranged " << bulk_s << "s (" << element_s / bulk_s << "x)" << std::endl;
+                    assert(esum == bsum);
+                    assert(element->stats_csv() == bulk->stats_csv());
+                }
+
                 return 0;
             }
 
         private:
+            /* runs merge at the finest block of the cache and port; 0 if unmodeled */
+            Cache::Addr block() const {
+                Cache::Addr a = _cache ? _cache->block_size() : 0;
+                Cache::Addr b = _port ? std::max<Cache::Addr>(1, _port->block_size()) : 0;
+                while (b != 0) { Cache::Addr t = a % b; a = b; b = t; }
+                return a;
+            }
+
+            /* k back-to-back references to the block holding addr */
+            void model(Cache::Addr addr, Cache::Addr k, bool store) const {
+                if (_cache) {
+                    if (store) _cache->store_repeat(addr, k);
+                    else       _cache->load_repeat(addr, k);
+                }
+                if (_port) {
+                    if (store) _port->store_repeat(addr, k);
+                    else       _port->load_repeat(addr, k);
+                }
+            }
+
+            /* one element that straddles blocks, as get/set would model it */
+            void model_element(Cache::Addr addr, bool store) const {
+                auto sz = static_cast<Cache::Addr>(sizeof(T));
+                if (_cache) {
+                    if (store) _cache->store_multi(addr, sz);
+                    else       _cache->load_multi(addr, sz);
+                }
+                if (_port) {
+                    if (store) _port->store_multi(addr, sz);
+                    else       _port->load_multi(addr, sz);
+                }
+            }
+
+            /* model loads of [i, i+n) a block at a time, calling f(k) after each run of k elements */
+            template <typename F>
+            void load_runs(size_t i, size_t n, F f) const {
+                Cache::Addr bs = block();
+                auto sz = static_cast<Cache::Addr>(sizeof(T));
+                auto addr = reinterpret_cast<Cache::Addr>(_data.data() + i);
+                auto end = addr + static_cast<Cache::Addr>(n) * sz;
+                while (addr < end) {
+                    Cache::Addr k;
+                    if (bs == 0) {
+                        k = (end - addr) / sz; // unmodeled
+                    } else if ((k = std::min(bs - addr % bs, end - addr) / sz) == 0) {
+                        model_element(addr, false); // straddles two blocks
+                        k = 1;
+                    } else {
+                        model(addr, k, false);
+                    }
+                    f(k);
+                    addr += k * sz;
+                }
+            }
+
+            /* merges back-to-back accesses to one block; flushes on destruction */
+            class Coalescer {
+            public:
+                Coalescer(const VectorWithCache &v, bool store) :
+                    _v(v), _store(store), _bs(v.block()), _block(-1), _addr(0), _n(0) {}
+                ~Coalescer() { flush(); }
+
+                void add(const T *p) {
+                    if (_bs == 0) return;
+                    auto addr = reinterpret_cast<Cache::Addr>(p);
+                    Cache::Addr first = addr / _bs;
+                    Cache::Addr last = (addr + static_cast<Cache::Addr>(sizeof(T)) - 1) / _bs;
+                    if (first == _block && first == last) { _n++; return; }
+                    flush();
+                    if (first == last) { _block = first; _addr = addr; _n = 1; }
+                    else _v.model_element(addr, _store);
+                }
+
+            private:
+                void flush() {
+                    if (_n) _v.model(_addr, _n, _store);
+                    _block = -1;
+                    _n = 0;
+                }
+
+                const VectorWithCache &_v;
+                bool _store;
+                Cache::Addr _bs;
+                Cache::Addr _block;
+                Cache::Addr _addr;
+                Cache::Addr _n;
+            };
+
+            void update_region() {
+                if (_region.empty()) return;
+                auto begin = reinterpret_cast<Cache::Addr>(_data.data());
+                auto end = begin + static_cast<Cache::Addr>(_data.size() * sizeof(T));
+                if (_cache) _cache->set_region(_region, begin, end);
+                if (_port) _port->set_region(_region, begin, end);
+            }
+
+            void store_range(size_t i, size_t n) {
+                if (n == 0) return;
+                auto addr = reinterpret_cast<Cache::Addr>(&_data[i]);
+                auto sz = static_cast<Cache::Addr>(n * sizeof(T));
+                if (_cache) _cache->store_multi(addr, sz);
+                if (_port) _port->store_multi(addr, sz);
+            }
+
             std::shared_ptr<Cache> _cache;
+            std::shared_ptr<MemoryPort> _port;
             std::vector<T> _data;
+            std::string _region;
         };
     }
 }
@@ -0,0 +1,19 @@
+#pragma once
+#include <MemoryFootprint.hpp>
+#include <vector>
+#include <cstddef>
+
+namespace graph_tools {
+
+    /**
+     * Storage for a per-vertex property of an algorithm running on graph
+     * type G. Plain graphs get a std::vector; instrumented graphs
+     * specialize this to route accesses through their memory model.
+     */
+    template <typename G, typename T>
+    struct VertexArray {
+        using type = std::vector<T>;
+        static type Make(const G &g, size_t n, T init) { return type(n, init); }
+        static int64_t Bytes(const type &a) { return MemoryFootprint::Bytes(a); }
+    };
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <Graph500Data.hpp>
+#include <PerfCounters.hpp>
+#include <MemoryFootprint.hpp>
 #include <cstdint>
 #include <string>
 #include <map>
@@ -18,9 +20,16 @@
 #include <random>
 namespace graph_tools {
 
+    /* one weighted arc, 8 bytes */
+    struct WEdge {
+        uint32_t dst;
+        float    weight;
+    };
+
     class WGraph {
     public:
         using NodeID = uint32_t;
+        using Ptr    = std::shared_ptr<const WGraph>;
         class Neighborhood {
         public:
             Neighborhood(const NodeID *begin = nullptr, const NodeID *end = nullptr) :
@@ -35,11 +44,44 @@ namespace graph_tools {
             const NodeID *_end;
         };
 
-        WGraph() {}
+        /* (dst, weight) view over the split neighbor and weight arrays */
+        class WNeighborhood {
+        public:
+            class iterator {
+            public:
+                iterator(const NodeID *dst, const float *weight) :
+                    _dst(dst), _weight(weight) {}
+
+                WEdge operator*() const { return {*_dst, *_weight}; }
+                iterator & operator++() { ++_dst; ++_weight; return *this; }
+                bool operator!=(const iterator &other) const { return _dst != other._dst; }
+            private:
+                const NodeID *_dst;
+                const float  *_weight;
+            };
+
+            WNeighborhood(const NodeID *dst = nullptr, const float *weight = nullptr, NodeID size = 0) :
+                _dst(dst), _weight(weight), _size(size) {}
+
+            WEdge operator[](size_t i) const { return {_dst[i], _weight[i]}; }
+            NodeID size() const { return _size; }
+            iterator begin() const { return iterator(_dst, _weight); }
+            iterator end()   const { return iterator(_dst+_size, _weight+_size); }
+        private:
+            const NodeID *_dst;
+            const float  *_weight;
+            NodeID _size;
+        };
+
+        WGraph() : _build_peak(0) {}
         Neighborhood neighbors(NodeID v) const {
             return Neighborhood(&_neighbors[_offsets[v]], &_neighbors[_offsets[v]]+_degrees[v]);
         }
 
+        WNeighborhood wedges(NodeID v) const {
+            return WNeighborhood(_neighbors.data()+_offsets[v], _weights.data()+_offsets[v], _degrees[v]);
+        }
+
         NodeID num_nodes() const { return _degrees.size(); }
         NodeID num_vertices() const { return num_nodes(); }
         NodeID num_edges() const { return _neighbors.size(); }
@@ -72,8 +114,12 @@ namespace graph_tools {
         }
 
         WGraph transpose() const {
-            std::vector<std::list<NodeID>> adjl(num_nodes());
-            std::vector<std::list<float>> wadjl(num_nodes());
+            PerfScope scope("wgraph transpose");
+            using List  = std::list<NodeID, TrackingAllocator<NodeID>>;
+            using WList = std::list<float, TrackingAllocator<float>>;
+            AllocationTracker tracker;
+            std::vector<List, TrackingAllocator<List>> adjl(num_nodes(), List(&tracker), &tracker);
+            std::vector<WList, TrackingAllocator<WList>> wadjl(num_nodes(), WList(&tracker), &tracker);
             WGraph t;
             for (NodeID src = 0; src < num_nodes(); src++) {
                 for (NodeID dst_i = 0; dst_i < degree(src); dst_i++) {
@@ -84,6 +130,10 @@ namespace graph_tools {
                 }
             }
 
+            t._offsets.reserve(num_nodes());
+            t._degrees.reserve(num_nodes());
+            t._neighbors.reserve(num_edges());
+            t._weights.reserve(num_edges());
             for (NodeID dst = 0; dst < num_nodes(); dst++) {
                 t._offsets.push_back(t._neighbors.size());
                 t._degrees.push_back(adjl[dst].size());
@@ -91,19 +141,88 @@ namespace graph_tools {
                 t._weights.insert(t._weights.end(), wadjl[dst].begin(), wadjl[dst].end());
             }
 
+            t._build_peak = tracker.peak();
             return t;
         }
 
+        /**
+         * Transpose of this graph, built on first use and shared thereafter
+         */
+        Ptr transposed() const {
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) return t;
+            Ptr built = std::make_shared<const WGraph>(transpose());
+            // another thread may have built it first; keep theirs
+            if (std::atomic_compare_exchange_strong(&_transposed, &t, built))
+                return built;
+            return t;
+        }
+
+        /**
+         * Bytes held by this graph, and by its cached transpose if built;
+         * the build peak is the transient adjacency lists of whichever
+         * builder (or transpose) made it.
+         */
+        MemoryFootprint footprint() const {
+            MemoryFootprint f;
+            f.add("offsets", MemoryFootprint::Bytes(_offsets));
+            f.add("neighbors", MemoryFootprint::Bytes(_neighbors));
+            f.add("degrees", MemoryFootprint::Bytes(_degrees));
+            f.add("weights", MemoryFootprint::Bytes(_weights));
+            f.add_transient("build", _build_peak);
+            Ptr t = std::atomic_load(&_transposed);
+            if (t) f.add("transposed", t->footprint());
+            return f;
+        }
+
+        /**
+         * What footprint() will report for a graph of this size built by
+         * FromGraph500Buffer (and transposed, if asked), without building
+         * it. The build peak is an upper bound: every vertex a source.
+         */
+        static MemoryFootprint EstimateFootprint(int64_t nodes, int64_t edges, bool transposed = false) {
+            using Edge  = std::pair<NodeID, float>;
+            using List  = std::list<Edge, TrackingAllocator<Edge>>;
+            using NList = std::list<NodeID, TrackingAllocator<NodeID>>;
+            using WList = std::list<float, TrackingAllocator<float>>;
+            const int64_t map_node = 4 * sizeof(void*) + sizeof(std::pair<const NodeID, List>);
+            MemoryFootprint f;
+            f.add("offsets", nodes * sizeof(NodeID));
+            f.add("neighbors", edges * sizeof(NodeID));
+            f.add("degrees", nodes * sizeof(NodeID));
+            f.add("weights", edges * sizeof(float));
+            f.add_transient("build", nodes * map_node + edges * MemoryFootprint::ListNode(sizeof(Edge)));
+            if (transposed) {
+                MemoryFootprint t;
+                t.add("offsets", nodes * sizeof(NodeID));
+                t.add("neighbors", edges * sizeof(NodeID));
+                t.add("degrees", nodes * sizeof(NodeID));
+                t.add("weights", edges * sizeof(float));
+                t.add_transient("build", nodes * static_cast<int64_t>(sizeof(NList) + sizeof(WList))
+                                + edges * (MemoryFootprint::ListNode(sizeof(NodeID)) + MemoryFootprint::ListNode(sizeof(float))));
+                f.add("transposed", t);
+            }
+            return f;
+        }
+
     private:
         std::vector<NodeID> _offsets;
         std::vector<NodeID> _neighbors;
         std::vector<NodeID> _degrees;
         std::vector<float>  _weights;
+        mutable Ptr _transposed;
+        int64_t _build_peak;
     public:
-        std::vector<NodeID>& get_offsets()   { return _offsets; }
-        std::vector<NodeID>& get_neighbors() { return _neighbors; }
-        std::vector<NodeID>& get_degrees()   { return _degrees; }
-        std::vector<float> & get_weights()   { return _weights; }
+        // non-const access may modify the graph; drop the cached transpose
+        std::vector<NodeID>& get_offsets()   { _transposed.reset(); return _offsets; }
+        std::vector<NodeID>& get_neighbors() { _transposed.reset(); return _neighbors; }
+        std::vector<NodeID>& get_degrees()   { _transposed.reset(); return _degrees; }
+        std::vector<float> & get_weights()   { _transposed.reset(); return _weights; }
+
+        const std::vector<NodeID>& get_offsets()   const { return _offsets; }
+        const std::vector<NodeID>& get_neighbors() const { return _neighbors; }
+        const std::vector<NodeID>& get_degrees()   const { return _degrees; }
+        const std::vector<float> & get_weights()   const { return _weights; }
 
         std::vector<std::pair<int,float>> wneighbors(NodeID v) const {
             std::vector<std::pair<int,float>> r;
@@ -154,8 +273,12 @@ namespace graph_tools {
 
         /* Builder functions */
         static WGraph FromGraph500Buffer(packed_edge *edges, float *edge_weights, int64_t nedges, bool transpose = false) {
+            PerfScope scope("wgraph build");
             // build an adjacency list
-            std::map<NodeID, std::list<std::pair<NodeID, float>>> neighbors;
+            using List = std::list<std::pair<NodeID, float>, TrackingAllocator<std::pair<NodeID, float>>>;
+            AllocationTracker tracker;
+            std::map<NodeID, List, std::less<NodeID>, TrackingAllocator<std::pair<const NodeID, List>>>
+                neighbors(std::less<NodeID>(), &tracker);
             for (int64_t i = 0; i < nedges; i++) {
                 packed_edge &e = edges[i];
                 float w = edge_weights[i];
@@ -170,7 +293,7 @@ namespace graph_tools {
 
                 auto rslt = neighbors.find(src);
                 if (rslt == neighbors.end()) {
-                    neighbors.insert({src, {{dst, w}}});
+                    neighbors.insert({src, List({{dst, w}}, &tracker)});
                 } else {
                     auto & adjl = rslt->second;
                     adjl.push_back({dst,w});
@@ -182,9 +305,11 @@ namespace graph_tools {
             std::vector<NodeID> offsets;
             std::vector<NodeID> arcs;
             std::vector<float>  weights;
+            arcs.reserve(nedges);
+            weights.reserve(nedges);
             NodeID maxv = 0;
 
-            for (auto pair : neighbors) {
+            for (auto &pair : neighbors) {
                 NodeID src = pair.first;
                 auto & adjl = pair.second;
 
@@ -222,11 +347,14 @@ namespace graph_tools {
 
             WGraph g;
 
+            offsets.shrink_to_fit();
+            degree.shrink_to_fit();
             g._neighbors = std::move(arcs);
             g._offsets   = std::move(offsets);
             g._degrees   = std::move(degree);
             g._weights   = std::move(weights);
-            
+            g._build_peak = tracker.peak();
+
             return g;
         }
 
@@ -370,6 +498,19 @@ namespace graph_tools {
                 std::cout << wg.to_string() << std::endl;
                 std::cout << wg.transpose().to_string() << std::endl;
             }            
+            {
+                // the estimate bounds what the builder and transpose actually hold
+                WGraph::Ptr wg = std::make_shared<const WGraph>(WGraph::Uniform(10*1000, 32*1000));
+                wg->transposed();
+                MemoryFootprint actual = wg->footprint();
+                MemoryFootprint estimate = WGraph::EstimateFootprint(10*1000, 32*1000, true);
+                std::cout << actual.stats_str() << std::endl;
+                std::cout << "estimated:" << std::endl << estimate.stats_str() << std::endl;
+                assert(actual.owned() <= estimate.owned());
+                assert(actual.owned() >= estimate.owned() * 9 / 10);
+                assert(actual.transient() > 0);
+                assert(actual.transient() <= estimate.transient());
+            }
             return 0;
         }
     };
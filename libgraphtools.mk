@@ -16,6 +16,7 @@ libgraphtools.so-objects := $(notdir $(libgraphtools.so-sources:.cpp=.o))
 libgraphtools-interface-ldflags += $(libgenerator-interface-ldflags)
 libgraphtools-interface-ldflags += -L$(graphtools-dir)
 libgraphtools-interface-ldflags += -lgraphtools #-lboost_serialization
+libgraphtools-interface-ldflags += -pthread
 ifeq ($(shell uname),Darwin)
 libgraphtools-interface-ldflags += -Wl,-rpath,$(graphtools-dir)
 else
@@ -32,6 +33,7 @@ libgraphtools-ldflags += -shared
 libgraphtools-interface-cxxflags += $(libgenerator-interface-cxxflags)
 libgraphtools-interface-cxxflags += -I$(graphtools-dir)
 libgraphtools-interface-cxxflags += -std=c++11
+libgraphtools-interface-cxxflags += -pthread
 
 # cxxflags for compiling libgraphtools.so
 libgraphtools-cxxflags += $(libgenerator-interface-cxxflags)